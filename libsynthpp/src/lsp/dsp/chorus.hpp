@@ -0,0 +1,105 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+#include <cmath>
+
+namespace lsp::dsp
+{
+
+// コーラス
+// 三角波LFOで遅延時間を揺らした遅延信号を出力します。L/RでLFOの位相を90度ずらし、広がりを持たせます。
+template<std::floating_point parameter_type = float>
+class Chorus final
+	: non_copy
+{
+public:
+	Chorus() = default;
+
+	// パラメータを設定します (内部状態はリセットされます)
+	// delaySec: 基準遅延時間(秒), depthSec: 遅延時間の変調幅(秒, delaySec未満), rate: LFO周波数(Hz), feedback: 帰還量 [0.0, 1.0)
+	void setParam(parameter_type sampleFreq, parameter_type delaySec, parameter_type depthSec, parameter_type rate, parameter_type feedback)
+	{
+		lsp_require(sampleFreq > 0);
+		lsp_require(delaySec > depthSec && depthSec >= 0);
+		lsp_require(feedback >= 0 && feedback < 1);
+
+		mBaseDelay = delaySec * sampleFreq;
+		mDepth = depthSec * sampleFreq;
+		mPhaseIncrement = rate / sampleFreq;
+		mFeedback = feedback;
+
+		// 補間用に前後1サンプル分の余裕を持たせる
+		mLength = static_cast<size_t>(std::ceil(mBaseDelay + mDepth)) + 2;
+		mBuffer.assign(mLength * 2, 0);
+		reset();
+	}
+
+	// 内部状態をリセットします
+	void reset()noexcept
+	{
+		std::fill(mBuffer.begin(), mBuffer.end(), static_cast<parameter_type>(0));
+		mWritePos = 0;
+		mPhase = 0;
+	}
+
+	// ステレオ信号を処理します
+	// in : 入力(インターリーブ 2ch), out : ウェット出力(インターリーブ 2ch, 上書き)
+	// 遅延線は setParam() で確保されるため、それ以前に呼び出すことはできません
+	void process(const parameter_type* in, parameter_type* out, size_t frames)noexcept
+	{
+		lsp_require(!mBuffer.empty());
+
+		const auto buffer = mBuffer.data();
+		const auto length = mLength;
+
+		for(size_t i = 0; i < frames; ++i) {
+			// 三角波LFO [-1, +1] : Rch は1/4周期ずらす
+			auto phaseR = mPhase + static_cast<parameter_type>(0.25);
+			if(phaseR >= 1) phaseR -= 1;
+			const parameter_type lfo[2] = { triangle(mPhase), triangle(phaseR) };
+			mPhase += mPhaseIncrement;
+			if(mPhase >= 1) mPhase -= 1;
+
+			for(size_t ch = 0; ch < 2; ++ch) {
+				// 線形補間による小数遅延の読み出し
+				const auto delay = mBaseDelay + mDepth * lfo[ch];
+				auto readPos = static_cast<parameter_type>(mWritePos) - delay;
+				if(readPos < 0) readPos += static_cast<parameter_type>(length);
+				const auto i0 = static_cast<size_t>(readPos);
+				const auto frac = readPos - static_cast<parameter_type>(i0);
+				const auto i1 = (i0 + 1 < length) ? i0 + 1 : 0;
+				const auto s0 = buffer[i0 * 2 + ch];
+				const auto s1 = buffer[i1 * 2 + ch];
+				const auto wet = s0 + (s1 - s0) * frac;
+
+				buffer[mWritePos * 2 + ch] = in[i * 2 + ch] + wet * mFeedback;
+				out[i * 2 + ch] = wet;
+			}
+			if(++mWritePos >= length) mWritePos = 0;
+		}
+	}
+
+private:
+	static parameter_type triangle(parameter_type phase)noexcept
+	{
+		// phase [0, 1) → [-1, +1]
+		return (phase < static_cast<parameter_type>(0.5)) ? (4 * phase - 1) : (3 - 4 * phase);
+	}
+
+private:
+	std::vector<parameter_type> mBuffer; // インターリーブ 2ch
+	size_t mLength = 0;
+	size_t mWritePos = 0;
+
+	parameter_type mBaseDelay = 0;	// サンプル数
+	parameter_type mDepth = 0;		// サンプル数
+	parameter_type mPhase = 0;		// LFO位相 [0, 1)
+	parameter_type mPhaseIncrement = 0;
+	parameter_type mFeedback = 0;
+};
+
+}
@@ -0,0 +1,155 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+#include <cmath>
+
+namespace lsp::dsp
+{
+
+// RMSコンプレッサ (ソフトニー付き, 全チャネル連動)
+// 検出は全チャネルの二乗平均をRMS時定数で平滑化した値を用い、ゲインはdB領域でアタック/リリースを適用します。
+template<std::floating_point parameter_type = float>
+class Compressor final
+	: non_copy
+{
+public:
+	// 一度に処理するフレーム数の上限 (これを超える場合は内部で分割処理する)
+	static constexpr size_t MAX_BLOCK_FRAMES = 256;
+
+	Compressor() = default;
+
+	// パラメータを設定します
+	// thresholdDb: スレッショルド(dBFS), ratio: レシオ(1以上), kneeDb: ニー幅(dB), makeupDb: メイクアップゲイン(dB)
+	// attackSec/releaseSec: ゲイン変化の時定数(秒), rmsSec: RMS検出の時定数(秒)
+	void setParam(parameter_type sampleFreq, uint32_t channels,
+		parameter_type thresholdDb, parameter_type ratio, parameter_type kneeDb,
+		parameter_type attackSec, parameter_type releaseSec, parameter_type rmsSec,
+		parameter_type makeupDb = 0)
+	{
+		lsp_require(sampleFreq > 0);
+		lsp_require(channels > 0);
+		lsp_require(ratio >= 1);
+
+		auto coef = [&](parameter_type sec) -> parameter_type {
+			return (sec > 0) ? static_cast<parameter_type>(1.0 - std::exp(-1.0 / (sec * sampleFreq))) : 1;
+		};
+		mChannels = channels;
+		mThresholdDb = thresholdDb;
+		mSlope = 1 - 1 / ratio;
+		mKneeDb = std::max<parameter_type>(kneeDb, 0);
+		mAttackCoef = coef(attackSec);
+		mReleaseCoef = coef(releaseSec);
+		mRmsCoef = coef(rmsSec);
+		mMakeupDb = makeupDb;
+		mPowers.resize(MAX_BLOCK_FRAMES);
+		mGains.resize(MAX_BLOCK_FRAMES);
+	}
+
+	// 内部状態をリセットします
+	void reset()noexcept
+	{
+		mMeanSquare = 0;
+		mGainReductionDb = 0;
+	}
+
+	// 現在のゲインリダクション量(dB, 0以上)を取得します
+	parameter_type gainReductionDb()const noexcept { return mGainReductionDb; }
+
+	// インターリーブ形式の信号を処理します (in-place)
+	// 作業領域は setParam() で確保されるため、それ以前に呼び出すことはできません
+	// 戻り値 : 処理区間内の最大ゲインリダクション量(dB, 0以上)
+	parameter_type process(parameter_type* data, size_t frames)noexcept
+	{
+		lsp_require(!mGains.empty());
+
+		parameter_type maxReduction = 0;
+		while(frames > 0) {
+			const size_t n = std::min(frames, MAX_BLOCK_FRAMES);
+			maxReduction = std::max(maxReduction, processBlock(data, n));
+			data += n * mChannels;
+			frames -= n;
+		}
+		return maxReduction;
+	}
+
+private:
+	// 入力レベル(dB)に対するゲインリダクション量(dB, 0以上)を求めます
+	parameter_type computeReduction(parameter_type levelDb)const noexcept
+	{
+		const auto over = levelDb - mThresholdDb;
+		if(2 * over <= -mKneeDb) {
+			return 0;
+		}
+		if(2 * over < mKneeDb) {
+			// ソフトニー区間 : 二次曲線で滑らかに繋ぐ
+			const auto x = over + mKneeDb / 2;
+			return mSlope * x * x / (2 * mKneeDb);
+		}
+		return mSlope * over;
+	}
+
+	parameter_type processBlock(parameter_type* data, size_t frames)noexcept
+	{
+		const uint32_t channels = mChannels;
+		const auto powers = mPowers.data();
+		const auto gains = mGains.data();
+		const auto invChannels = 1 / static_cast<parameter_type>(channels);
+
+		// フレーム毎の二乗平均 (ベクトル化可能)
+		for(size_t i = 0; i < frames; ++i) {
+			parameter_type sum = 0;
+			const auto frame = data + i * channels;
+			for(uint32_t ch = 0; ch < channels; ++ch) {
+				sum += frame[ch] * frame[ch];
+			}
+			powers[i] = sum * invChannels;
+		}
+
+		// ゲイン計算 (フレーム間に依存関係があるためスカラ処理)
+		constexpr parameter_type MIN_POWER = static_cast<parameter_type>(1e-12); // -120dB
+		parameter_type maxReduction = 0;
+		for(size_t i = 0; i < frames; ++i) {
+			mMeanSquare += (powers[i] - mMeanSquare) * mRmsCoef;
+			const auto levelDb = 10 * std::log10(std::max(mMeanSquare, MIN_POWER));
+			const auto target = computeReduction(levelDb);
+			const auto c = (target > mGainReductionDb) ? mAttackCoef : mReleaseCoef;
+			mGainReductionDb += (target - mGainReductionDb) * c;
+			maxReduction = std::max(maxReduction, mGainReductionDb);
+			gains[i] = mMakeupDb - mGainReductionDb;
+		}
+
+		// dB → リニア変換 + ゲイン適用
+		constexpr auto DB_TO_LOG2 = static_cast<parameter_type>(0.16609640474436813); // log2(10) / 20
+		for(size_t i = 0; i < frames; ++i) {
+			const auto g = std::exp2(gains[i] * DB_TO_LOG2);
+			auto frame = data + i * channels;
+			for(uint32_t ch = 0; ch < channels; ++ch) {
+				frame[ch] *= g;
+			}
+		}
+		return maxReduction;
+	}
+
+private:
+	uint32_t mChannels = 1;
+	parameter_type mThresholdDb = 0;
+	parameter_type mSlope = 0;
+	parameter_type mKneeDb = 0;
+	parameter_type mAttackCoef = 1;
+	parameter_type mReleaseCoef = 1;
+	parameter_type mRmsCoef = 1;
+	parameter_type mMakeupDb = 0;
+
+	parameter_type mMeanSquare = 0;
+	parameter_type mGainReductionDb = 0;
+
+	// 作業領域
+	std::vector<parameter_type> mPowers;
+	std::vector<parameter_type> mGains;
+};
+
+}
@@ -0,0 +1,354 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/dsp/fft.hpp>
+#include <lsp/util/thread_priority.hpp>
+
+#include <semaphore>
+#include <thread>
+
+namespace lsp::dsp
+{
+
+// 分割畳み込み (ステレオ)
+// インパルス応答(IR)を区間に分割し、周波数領域で畳み込みを行います。
+//   - 先頭区間(head) : ブロック長 headBlockSize の均一分割 overlap-save + 周波数領域遅延線(FDL)。呼び出し元スレッドで処理します
+//   - 後続区間(tail) : ブロック長 tailBlockSize の均一分割 overlap-save。専用のワーカースレッドで処理します
+// tail は IR の 2*tailBlockSize サンプル目以降を担当するため、ワーカースレッドには tailBlockSize サンプル分の処理時間が与えられます。
+// ステレオ信号は L + iR の複素信号として1回の複素FFTで処理します。
+// (IRがL/Rで異なる場合も、共役対称性を用いてスペクトルを分離するため、FFT回数は増えません)
+// 出力は入力に対して headBlockSize フレーム遅延します。
+template<std::floating_point sample_type = float>
+class PartitionedConvolver final
+	: non_copy_move
+{
+public:
+	// ir : インパルス応答 (1ch : L/R共通, 2ch : L/R個別)
+	explicit PartitionedConvolver(const SignalView<sample_type>& ir, size_t headBlockSize = 128, size_t tailBlockSize = 4096)
+		: mHeadBlockSize(headBlockSize)
+		, mTailBlockSize(tailBlockSize)
+	{
+		lsp_require(ir.channels() == 1 || ir.channels() == 2);
+		lsp_require(std::has_single_bit(headBlockSize));
+		lsp_require(std::has_single_bit(tailBlockSize));
+		lsp_require(tailBlockSize >= headBlockSize);
+
+		const size_t tailOffset = 2 * tailBlockSize;
+		mHead.initialize(ir, 0, std::min(ir.frames(), tailOffset), headBlockSize);
+		if(ir.frames() > tailOffset) {
+			mTail = std::make_unique<Stage>();
+			mTail->initialize(ir, tailOffset, ir.frames() - tailOffset, tailBlockSize);
+			for(auto& buf : mTailOutput) buf.assign(2 * tailBlockSize, 0);
+			mTailAccum.assign(2 * tailBlockSize, 0);
+			mTailJobInput.assign(2 * tailBlockSize, 0);
+		}
+
+		mInput.assign(2 * headBlockSize, 0);
+		mOutput.assign(2 * headBlockSize, 0);
+
+		if(mTail) {
+			mTailThread = std::thread([this] { tailThreadMain(); });
+		}
+	}
+	~PartitionedConvolver()
+	{
+		if(mTailThread.joinable()) {
+			mTailAborted = true;
+			mTailRequest.release();
+			mTailThread.join();
+		}
+	}
+
+	// 入力に対する出力の遅延(フレーム数)を取得します
+	size_t latency()const noexcept { return mHeadBlockSize; }
+
+	// tail の処理が期限に間に合わず、呼び出し元スレッドが待機した回数を取得します
+	uint64_t lateTailJobs()const noexcept { return mLateTailJobs; }
+
+	// 内部状態をリセットします
+	void reset()
+	{
+		waitTailJob();
+		mHead.reset();
+		if(mTail) {
+			mTail->reset();
+			for(auto& buf : mTailOutput) std::ranges::fill(buf, static_cast<sample_type>(0));
+			std::ranges::fill(mTailAccum, static_cast<sample_type>(0));
+		}
+		std::ranges::fill(mInput, static_cast<sample_type>(0));
+		std::ranges::fill(mOutput, static_cast<sample_type>(0));
+		mFill = 0;
+		mBlockCount = 0;
+	}
+
+	// ステレオ信号を処理します
+	// in : 入力(インターリーブ 2ch), out : ウェット出力(インターリーブ 2ch, 上書き)
+	void process(const sample_type* in, sample_type* out, size_t frames)
+	{
+		const size_t block = mHeadBlockSize;
+		auto inL = mInput.data();
+		auto inR = inL + block;
+		const auto outL = mOutput.data();
+		const auto outR = outL + block;
+
+		size_t pos = 0;
+		while(pos < frames) {
+			const size_t n = std::min(frames - pos, block - mFill);
+			for(size_t i = 0; i < n; ++i) {
+				inL[mFill + i] = in[(pos + i) * 2 + 0];
+				inR[mFill + i] = in[(pos + i) * 2 + 1];
+				out[(pos + i) * 2 + 0] = outL[mFill + i];
+				out[(pos + i) * 2 + 1] = outR[mFill + i];
+			}
+			pos += n;
+			mFill += n;
+			if(mFill == block) {
+				processBlock();
+				mFill = 0;
+			}
+		}
+	}
+
+private:
+	// 均一分割 overlap-save 畳み込み 1段分
+	struct Stage
+	{
+		size_t block = 0;		// ブロック長 B
+		size_t fftSize = 0;		// FFT長 2B
+		size_t partitions = 0;	// 分割数
+		bool stereoIR = false;	// L/Rで異なるIRか否か
+		fft::FftPlan<sample_type> plan;
+
+		// IRスペクトル (分割数 x FFT長) : Z = X・A + conj(X[N-k])・B
+		//   A = (H_L + H_R) / 2, B = (H_L - H_R) / 2  (1/N のスケーリング込み)
+		std::vector<sample_type> irARe, irAIm, irBRe, irBIm;
+
+		// 周波数領域遅延線 (分割数 x FFT長)
+		std::vector<sample_type> fdlRe, fdlIm, fdlMirrorRe, fdlMirrorIm;
+		size_t fdlPos = 0;
+
+		// 作業領域
+		std::vector<sample_type> inRe, inIm;	// 直前ブロック + 現在ブロック
+		std::vector<sample_type> accRe, accIm;
+
+		void initialize(const SignalView<sample_type>& ir, size_t offset, size_t length, size_t blockSize)
+		{
+			block = blockSize;
+			fftSize = 2 * blockSize;
+			partitions = std::max<size_t>(1, (length + block - 1) / block);
+			stereoIR = (ir.channels() == 2);
+			plan = fft::FftPlan<sample_type>(fftSize);
+
+			const size_t total = partitions * fftSize;
+			irARe.assign(total, 0);
+			irAIm.assign(total, 0);
+			if(stereoIR) {
+				irBRe.assign(total, 0);
+				irBIm.assign(total, 0);
+				fdlMirrorRe.assign(total, 0);
+				fdlMirrorIm.assign(total, 0);
+			}
+			fdlRe.assign(total, 0);
+			fdlIm.assign(total, 0);
+			inRe.assign(fftSize, 0);
+			inIm.assign(fftSize, 0);
+			accRe.assign(fftSize, 0);
+			accIm.assign(fftSize, 0);
+
+			// 各区間のIRスペクトルを求める : L を実部、R を虚部に詰めて1回のFFTで変換し、共役対称性で分離する
+			const auto scale = static_cast<sample_type>(1.0 / static_cast<double>(fftSize));
+			std::vector<sample_type> re(fftSize), im(fftSize);
+			for(size_t p = 0; p < partitions; ++p) {
+				std::ranges::fill(re, static_cast<sample_type>(0));
+				std::ranges::fill(im, static_cast<sample_type>(0));
+				for(size_t i = 0; i < block; ++i) {
+					const size_t pos = offset + p * block + i;
+					if(pos >= offset + length) break;
+					const auto frame = ir.frame(pos);
+					re[i] = frame[0];
+					im[i] = stereoIR ? frame[1] : frame[0];
+				}
+				plan.forward(re.data(), im.data());
+
+				const size_t base = p * fftSize;
+				for(size_t k = 0; k < fftSize; ++k) {
+					const size_t m = (fftSize - k) % fftSize;
+					// H_L = (Z[k] + conj(Z[N-k])) / 2, H_R = (Z[k] - conj(Z[N-k])) / 2i
+					const auto hlRe = (re[k] + re[m]) / 2, hlIm = (im[k] - im[m]) / 2;
+					const auto hrRe = (im[k] + im[m]) / 2, hrIm = (re[m] - re[k]) / 2;
+					irARe[base + k] = (hlRe + hrRe) / 2 * scale;
+					irAIm[base + k] = (hlIm + hrIm) / 2 * scale;
+					if(stereoIR) {
+						irBRe[base + k] = (hlRe - hrRe) / 2 * scale;
+						irBIm[base + k] = (hlIm - hrIm) / 2 * scale;
+					}
+				}
+			}
+		}
+
+		void reset()noexcept
+		{
+			std::ranges::fill(fdlRe, static_cast<sample_type>(0));
+			std::ranges::fill(fdlIm, static_cast<sample_type>(0));
+			std::ranges::fill(fdlMirrorRe, static_cast<sample_type>(0));
+			std::ranges::fill(fdlMirrorIm, static_cast<sample_type>(0));
+			std::ranges::fill(inRe, static_cast<sample_type>(0));
+			std::ranges::fill(inIm, static_cast<sample_type>(0));
+			fdlPos = 0;
+		}
+
+		// 1ブロック分の畳み込みを行います (入出力はそれぞれ block フレーム)
+		void process(const sample_type* inL, const sample_type* inR, sample_type* outL, sample_type* outR)noexcept
+		{
+			const size_t n = fftSize;
+
+			// 入力 : 直前ブロックを前半へ移し、現在ブロックを後半に置く
+			std::copy_n(inRe.data() + block, block, inRe.data());
+			std::copy_n(inIm.data() + block, block, inIm.data());
+			std::copy_n(inL, block, inRe.data() + block);
+			std::copy_n(inR, block, inIm.data() + block);
+
+			// FDLの最新スロットへ変換結果を格納する
+			fdlPos = (fdlPos + partitions - 1) % partitions;
+			const auto slotRe = fdlRe.data() + fdlPos * n;
+			const auto slotIm = fdlIm.data() + fdlPos * n;
+			std::copy_n(inRe.data(), n, slotRe);
+			std::copy_n(inIm.data(), n, slotIm);
+			plan.forward(slotRe, slotIm);
+			if(stereoIR) {
+				// conj(X[N-k]) を事前に求めておき、積和ループを連続アクセスにする
+				const auto mirRe = fdlMirrorRe.data() + fdlPos * n;
+				const auto mirIm = fdlMirrorIm.data() + fdlPos * n;
+				for(size_t k = 0; k < n; ++k) {
+					const size_t m = (n - k) & (n - 1);
+					mirRe[k] = slotRe[m];
+					mirIm[k] = -slotIm[m];
+				}
+			}
+
+			// 複素積和 (ベクトル化可能)
+			const auto aRe = accRe.data();
+			const auto aIm = accIm.data();
+			std::fill_n(aRe, n, static_cast<sample_type>(0));
+			std::fill_n(aIm, n, static_cast<sample_type>(0));
+			for(size_t p = 0; p < partitions; ++p) {
+				const size_t slot = (fdlPos + p) % partitions;
+				const auto xRe = fdlRe.data() + slot * n;
+				const auto xIm = fdlIm.data() + slot * n;
+				const auto hRe = irARe.data() + p * n;
+				const auto hIm = irAIm.data() + p * n;
+				for(size_t k = 0; k < n; ++k) {
+					aRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+					aIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+				}
+				if(stereoIR) {
+					const auto mRe = fdlMirrorRe.data() + slot * n;
+					const auto mIm = fdlMirrorIm.data() + slot * n;
+					const auto bRe = irBRe.data() + p * n;
+					const auto bIm = irBIm.data() + p * n;
+					for(size_t k = 0; k < n; ++k) {
+						aRe[k] += mRe[k] * bRe[k] - mIm[k] * bIm[k];
+						aIm[k] += mRe[k] * bIm[k] + mIm[k] * bRe[k];
+					}
+				}
+			}
+
+			// 逆変換し、後半(巡回畳み込みの影響を受けない区間)を出力とする
+			plan.inverse(aRe, aIm);
+			std::copy_n(aRe + block, block, outL);
+			std::copy_n(aIm + block, block, outR);
+		}
+	};
+
+	void processBlock()
+	{
+		const size_t block = mHeadBlockSize;
+		const auto inL = mInput.data();
+		const auto inR = inL + block;
+		const auto outL = mOutput.data();
+		const auto outR = outL + block;
+
+		const size_t tailPhase = mTail ? (mBlockCount * block) % mTailBlockSize : 0;
+		if(mTail && tailPhase == 0 && mBlockCount > 0) {
+			// tail ブロック境界 : 前回のジョブの完了を待って出力を入れ替え、蓄積した入力で次のジョブを発行する
+			waitTailJob();
+			mTailFront ^= 1;
+			std::ranges::copy(mTailAccum, mTailJobInput.begin());
+			mTailJobPending = true;
+			mTailRequest.release();
+		}
+
+		// head
+		mHead.process(inL, inR, outL, outR);
+
+		if(mTail) {
+			// tail の出力を加算する
+			const auto tailL = mTailOutput[mTailFront].data() + tailPhase;
+			const auto tailR = tailL + mTailBlockSize;
+			for(size_t i = 0; i < block; ++i) {
+				outL[i] += tailL[i];
+				outR[i] += tailR[i];
+			}
+			// tail 用の入力を蓄積する
+			std::copy_n(inL, block, mTailAccum.data() + tailPhase);
+			std::copy_n(inR, block, mTailAccum.data() + mTailBlockSize + tailPhase);
+		}
+		++mBlockCount;
+	}
+
+	void waitTailJob()
+	{
+		if(!mTailJobPending) return;
+		if(!mTailDone.try_acquire()) {
+			++mLateTailJobs;
+			mTailDone.acquire();
+		}
+		mTailJobPending = false;
+	}
+
+	void tailThreadMain()
+	{
+		this_thread::set_priority(ThreadPriority::AboveNormal);
+		while(true) {
+			mTailRequest.acquire();
+			if(mTailAborted) break;
+
+			// 出力先は現在参照されていない側のバッファ
+			auto& output = mTailOutput[mTailFront ^ 1];
+			const auto inL = mTailJobInput.data();
+			const auto inR = inL + mTailBlockSize;
+			mTail->process(inL, inR, output.data(), output.data() + mTailBlockSize);
+			mTailDone.release();
+		}
+	}
+
+private:
+	const size_t mHeadBlockSize;
+	const size_t mTailBlockSize;
+
+	// head : 呼び出し元スレッドで処理
+	Stage mHead;
+	std::vector<sample_type> mInput;	// L[block] + R[block]
+	std::vector<sample_type> mOutput;	// L[block] + R[block]
+	size_t mFill = 0;
+	uint64_t mBlockCount = 0;
+
+	// tail : ワーカースレッドで処理
+	std::unique_ptr<Stage> mTail;
+	std::vector<sample_type> mTailAccum;		// 蓄積中の入力 L[tailBlock] + R[tailBlock]
+	std::vector<sample_type> mTailJobInput;		// ジョブに渡す入力 L[tailBlock] + R[tailBlock]
+	std::array<std::vector<sample_type>, 2> mTailOutput; // ダブルバッファ L[tailBlock] + R[tailBlock]
+	size_t mTailFront = 0;
+	bool mTailJobPending = false;
+	uint64_t mLateTailJobs = 0;
+
+	std::binary_semaphore mTailRequest{0};
+	std::binary_semaphore mTailDone{0};
+	std::atomic_bool mTailAborted = false;
+	std::thread mTailThread;
+};
+
+}
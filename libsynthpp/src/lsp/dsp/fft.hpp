@@ -142,4 +142,89 @@ bool fft1d(sample_type* ar, sample_type* ai, int n, int iter, bool isIFFT)
 	return true;
 }
 
+// FFT 実行計画
+// 同一サイズのFFTを繰り返し実行する用途向けに、回転因子とビット反転テーブルを事前に計算しておきます。
+// fft1d() と異なり、実行時に三角関数の計算を行いません。
+template<std::floating_point sample_type>
+class FftPlan final
+{
+public:
+	FftPlan() = default;
+	explicit FftPlan(size_t n)
+		: mSize(n)
+	{
+		lsp_require(n >= 2 && std::has_single_bit(n));
+
+		const auto bits = std::countr_zero(n);
+		mBitReverse.resize(n);
+		for(size_t i = 0; i < n; ++i) {
+			size_t r = 0;
+			for(int b = 0; b < bits; ++b) {
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			}
+			mBitReverse[i] = static_cast<uint32_t>(r);
+		}
+
+		mCos.resize(n / 2);
+		mSin.resize(n / 2);
+		for(size_t k = 0; k < n / 2; ++k) {
+			const double arg = 2.0 * math::PI<double> * static_cast<double>(k) / static_cast<double>(n);
+			mCos[k] = static_cast<sample_type>(std::cos(arg));
+			mSin[k] = static_cast<sample_type>(std::sin(arg));
+		}
+	}
+
+	// FFTサイズを取得します
+	size_t size()const noexcept { return mSize; }
+
+	// 順変換を行います (in-place, 実部/虚部 分割形式)
+	void forward(sample_type* ar, sample_type* ai)const noexcept { transform(ar, ai, false); }
+
+	// 逆変換を行います (in-place, 実部/虚部 分割形式)
+	// ※ 1/N のスケーリングは行いません
+	void inverse(sample_type* ar, sample_type* ai)const noexcept { transform(ar, ai, true); }
+
+private:
+	void transform(sample_type* ar, sample_type* ai, bool isInverse)const noexcept
+	{
+		const size_t n = mSize;
+
+		// ビット反転並べ替え
+		for(size_t i = 0; i < n; ++i) {
+			const size_t j = mBitReverse[i];
+			if(i < j) {
+				std::swap(ar[i], ar[j]);
+				std::swap(ai[i], ai[j]);
+			}
+		}
+
+		// バタフライ演算 (時間間引き)
+		const sample_type sign = isInverse ? 1 : -1;
+		for(size_t len = 2; len <= n; len <<= 1) {
+			const size_t half = len / 2;
+			const size_t step = n / len;
+			for(size_t i = 0; i < n; i += len) {
+				for(size_t k = 0; k < half; ++k) {
+					const auto wr = mCos[k * step];
+					const auto wi = sign * mSin[k * step];
+					const size_t a = i + k;
+					const size_t b = a + half;
+					const auto tr = ar[b] * wr - ai[b] * wi;
+					const auto ti = ar[b] * wi + ai[b] * wr;
+					ar[b] = ar[a] - tr;
+					ai[b] = ai[a] - ti;
+					ar[a] += tr;
+					ai[a] += ti;
+				}
+			}
+		}
+	}
+
+private:
+	size_t mSize = 0;
+	std::vector<uint32_t> mBitReverse;
+	std::vector<sample_type> mCos;
+	std::vector<sample_type> mSin;
+};
+
 }
\ No newline at end of file
@@ -4,8 +4,7 @@
 #pragma once
 
 #include <lsp/core/core.hpp>
-
-#include <random>
+#include <lsp/dsp/noise_generator.hpp>
 
 namespace lsp::dsp {
 
@@ -18,6 +17,8 @@ enum class WaveFormType
 	Triangle,		// 三角波
 	Square,			// 矩形波
 	WhiteNoise,		// ホワイトノイズ
+	PinkNoise,		// ピンクノイズ
+	BrownNoise,		// ブラウンノイズ
 };
 
 // ファンクションジェネレータ : 複数種類の波形生成
@@ -28,13 +29,13 @@ template<
 class FunctionGenerator final
 {
 public:
-	explicit FunctionGenerator(std::optional<uint32_t> seed = std::nullopt)
+	// seed : ノイズのシード (NoiseGenerator と同様、同一シードであれば同一のノイズ列となる)
+	explicit FunctionGenerator(uint64_t seed = 0)
 		: mType(WaveFormType::Ground)
 		, mPhase(0)
 		, mDutyRate(0)
 		, mPhasePerSample(0)
-		, mRandomEngine(seed.value_or(std::random_device()()))
-		, mUniDist(sample_traits<parameter_type>::min, sample_traits<parameter_type>::max)
+		, mNoiseGenerator(seed)
 	{
 	}
 
@@ -76,6 +77,19 @@ public:
 	{
 		mType = WaveFormType::WhiteNoise;
 		mPhasePerSample = 0;
+		mNoiseGenerator.setColor(NoiseColor::White);
+	}
+	void setPinkNoise()noexcept
+	{
+		mType = WaveFormType::PinkNoise;
+		mPhasePerSample = 0;
+		mNoiseGenerator.setColor(NoiseColor::Pink);
+	}
+	void setBrownNoise()noexcept
+	{
+		mType = WaveFormType::BrownNoise;
+		mPhasePerSample = 0;
+		mNoiseGenerator.setColor(NoiseColor::Brown);
 	}
 
 
@@ -115,8 +129,10 @@ public:
 			}
 			break;
 		case WaveFormType::WhiteNoise:
-			// ホワイトノイズ
-			s = requantize<sample_type>(mUniDist(mRandomEngine));
+		case WaveFormType::PinkNoise:
+		case WaveFormType::BrownNoise:
+			// ノイズ
+			s = requantize<sample_type>(mNoiseGenerator.update());
 			break;
 		}
 
@@ -124,16 +140,34 @@ public:
 		return s;
 	}
 
+	// 指定バッファを現在の波形で埋めます
+	void generate(std::span<sample_type> dest)
+	{
+		switch(mType) {
+		case WaveFormType::WhiteNoise:
+		case WaveFormType::PinkNoise:
+		case WaveFormType::BrownNoise:
+			if constexpr(std::is_same_v<sample_type, parameter_type>) {
+				// ノイズはサンプル毎の分岐無しで一括生成する
+				mNoiseGenerator.generate(dest);
+				return;
+			}
+			break;
+		default:
+			break;
+		}
+		for(auto& s : dest) {
+			s = update();
+		}
+	}
+
 private:
 	WaveFormType mType;
 	parameter_type mPhase; // 現在の位相 [0, 1)
 	parameter_type mDutyRate;	// デューティー比
 	parameter_type mPhasePerSample; // 1サンプル当たりの位相角(rad)
 
-	std::mt19937 mRandomEngine;
-	std::uniform_real_distribution<parameter_type> mUniDist; // 一様分布
-	parameter_type mBrownNoisePrevLevel;
-	
+	NoiseGenerator<parameter_type> mNoiseGenerator;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,216 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+#include <cmath>
+
+namespace lsp::dsp
+{
+
+// 先読み型ブリックウォールリミッタ
+// 信号を先読み時間分だけ遅延させ、その間に必要なゲインを求めることで、出力が上限値を超えないことを保証します。
+//   1. フレーム毎に必要ゲイン(上限値 / ピーク値)を求める
+//   2. 先読み時間幅のスライディング最小値を取る
+//   3. リリースを適用する (ゲインの回復のみ緩やかにする)
+//   4. 先読み時間幅の移動平均で平滑化する
+// 移動平均の窓に含まれる値は全て遅延後のサンプルに対する必要ゲイン以下であるため、平滑化後もオーバーシュートしません。
+template<std::floating_point parameter_type = float>
+class LookaheadLimiter final
+	: non_copy
+{
+public:
+	// 一度に処理するフレーム数の上限 (これを超える場合は内部で分割処理する)
+	static constexpr size_t MAX_BLOCK_FRAMES = 256;
+
+	LookaheadLimiter() = default;
+
+	// パラメータを設定します (内部状態はリセットされます)
+	// ceiling: 出力上限値(リニア), lookaheadSec: 先読み時間(秒), releaseSec: リリース時間(秒)
+	void setParam(parameter_type sampleFreq, uint32_t channels, parameter_type ceiling, parameter_type lookaheadSec, parameter_type releaseSec)
+	{
+		lsp_require(sampleFreq > 0);
+		lsp_require(channels > 0);
+		lsp_require(ceiling > 0);
+
+		mChannels = channels;
+		mCeiling = ceiling;
+		mLookahead = std::max<size_t>(1, static_cast<size_t>(lookaheadSec * sampleFreq));
+		mReleaseCoef = (releaseSec > 0) ? static_cast<parameter_type>(1.0 - std::exp(-1.0 / (releaseSec * sampleFreq))) : 1;
+
+		mDelayLine.assign(std::max<size_t>(1, mLookahead - 1) * mChannels, 0);
+		mMinValues.assign(mLookahead, 1);
+		mMinIndices.assign(mLookahead, 0);
+		mBoxValues.assign(mLookahead, 1);
+		mPeaks.resize(MAX_BLOCK_FRAMES);
+		mGains.resize(MAX_BLOCK_FRAMES);
+		reset();
+	}
+
+	// 内部状態をリセットします
+	void reset()noexcept
+	{
+		std::fill(mDelayLine.begin(), mDelayLine.end(), static_cast<parameter_type>(0));
+		std::fill(mBoxValues.begin(), mBoxValues.end(), static_cast<parameter_type>(1));
+		mDelayPos = 0;
+		mMinHead = mMinTail = 0;
+		mMinCount = 0;
+		mFrameIndex = 0;
+		mReleaseGain = 1;
+		mBoxSum = static_cast<double>(mLookahead);
+		mBoxPos = 0;
+		mCurrentGain = 1;
+	}
+
+	// 先読みによる遅延(フレーム数)を取得します
+	size_t latency()const noexcept { return mLookahead - 1; }
+
+	// 直近に適用したゲインを取得します (リニア)
+	parameter_type currentGain()const noexcept { return mCurrentGain; }
+
+	// インターリーブ形式の信号を処理します (in-place)
+	// 作業領域は setParam() で確保されるため、それ以前に呼び出すことはできません
+	// 戻り値 : 処理区間内で適用した最小ゲイン(リニア)
+	parameter_type process(parameter_type* data, size_t frames)noexcept
+	{
+		lsp_require(!mGains.empty());
+
+		parameter_type minGain = 1;
+		while(frames > 0) {
+			const size_t n = std::min(frames, MAX_BLOCK_FRAMES);
+			minGain = std::min(minGain, processBlock(data, n));
+			data += n * mChannels;
+			frames -= n;
+		}
+		return minGain;
+	}
+
+private:
+	parameter_type processBlock(parameter_type* data, size_t frames)noexcept
+	{
+		const uint32_t channels = mChannels;
+		const auto peaks = mPeaks.data();
+		const auto gains = mGains.data();
+
+		// 1. フレーム毎のピーク値 (ベクトル化可能)
+		for(size_t i = 0; i < frames; ++i) {
+			parameter_type peak = 0;
+			const auto frame = data + i * channels;
+			for(uint32_t ch = 0; ch < channels; ++ch) {
+				peak = std::max(peak, std::abs(frame[ch]));
+			}
+			peaks[i] = peak;
+		}
+
+		// 2-4. ゲイン計算 (フレーム間に依存関係があるためスカラ処理)
+		parameter_type minGain = 1;
+		const auto invLookahead = 1.0 / static_cast<double>(mLookahead);
+		for(size_t i = 0; i < frames; ++i) {
+			const parameter_type required = (peaks[i] > mCeiling) ? mCeiling / peaks[i] : 1;
+			const auto held = pushSlidingMin(required);
+
+			// リリース : ゲインの減少は即座に、回復は緩やかに追従する
+			if(held < mReleaseGain) {
+				mReleaseGain = held;
+			} else {
+				mReleaseGain += (held - mReleaseGain) * mReleaseCoef;
+			}
+
+			// 移動平均
+			mBoxSum += static_cast<double>(mReleaseGain) - static_cast<double>(mBoxValues[mBoxPos]);
+			mBoxValues[mBoxPos] = mReleaseGain;
+			if(++mBoxPos >= mLookahead) mBoxPos = 0;
+			const auto g = std::min(static_cast<parameter_type>(mBoxSum * invLookahead), static_cast<parameter_type>(1));
+			gains[i] = g;
+			minGain = std::min(minGain, g);
+		}
+		// 累積誤差の除去 : 区間毎に移動平均の和を再計算する
+		mBoxSum = 0;
+		for(auto v : mBoxValues) mBoxSum += v;
+
+		// 遅延 + ゲイン適用
+		const size_t delayFrames = mLookahead - 1;
+		if(delayFrames == 0) {
+			for(size_t i = 0; i < frames; ++i) {
+				auto frame = data + i * channels;
+				for(uint32_t ch = 0; ch < channels; ++ch) frame[ch] *= gains[i];
+			}
+		} else {
+			for(size_t i = 0; i < frames; ++i) {
+				auto frame = data + i * channels;
+				auto delayed = mDelayLine.data() + mDelayPos * channels;
+				const auto g = gains[i];
+				for(uint32_t ch = 0; ch < channels; ++ch) {
+					const auto in = frame[ch];
+					frame[ch] = delayed[ch] * g;
+					delayed[ch] = in;
+				}
+				if(++mDelayPos >= delayFrames) mDelayPos = 0;
+			}
+		}
+		if(frames > 0) mCurrentGain = gains[frames - 1];
+		return minGain;
+	}
+
+	// 先読み時間幅のスライディング最小値 (単調キュー) を更新して、現在の最小値を返します
+	parameter_type pushSlidingMin(parameter_type value)noexcept
+	{
+		const size_t cap = mLookahead;
+		const uint64_t index = mFrameIndex++;
+
+		// 窓から外れた要素を先頭から除く
+		if(mMinCount > 0 && mMinIndices[mMinHead] + cap <= index) {
+			mMinHead = (mMinHead + 1) % cap;
+			--mMinCount;
+		}
+		// 新しい値以上の要素を末尾から除く
+		while(mMinCount > 0) {
+			const size_t last = (mMinTail + cap - 1) % cap;
+			if(mMinValues[last] < value) break;
+			mMinTail = last;
+			--mMinCount;
+		}
+		mMinValues[mMinTail] = value;
+		mMinIndices[mMinTail] = index;
+		mMinTail = (mMinTail + 1) % cap;
+		++mMinCount;
+
+		return mMinValues[mMinHead];
+	}
+
+private:
+	uint32_t mChannels = 1;
+	parameter_type mCeiling = 1;
+	size_t mLookahead = 1;
+	parameter_type mReleaseCoef = 1;
+
+	// 遅延線 (先読み時間 - 1 フレーム分)
+	std::vector<parameter_type> mDelayLine;
+	size_t mDelayPos = 0;
+
+	// スライディング最小値用 単調キュー(リングバッファ)
+	std::vector<parameter_type> mMinValues;
+	std::vector<uint64_t> mMinIndices;
+	size_t mMinHead = 0;
+	size_t mMinTail = 0;
+	size_t mMinCount = 0;
+	uint64_t mFrameIndex = 0;
+
+	// リリース
+	parameter_type mReleaseGain = 1;
+
+	// 移動平均
+	std::vector<parameter_type> mBoxValues;
+	double mBoxSum = 0;
+	size_t mBoxPos = 0;
+
+	// 作業領域
+	std::vector<parameter_type> mPeaks;
+	std::vector<parameter_type> mGains;
+
+	parameter_type mCurrentGain = 1;
+};
+
+}
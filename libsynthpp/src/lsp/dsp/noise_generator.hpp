@@ -0,0 +1,208 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+namespace lsp::dsp {
+
+// 疑似乱数生成器 : PCG32 (XSH-RR, 64bit状態 / 32bit出力)
+//   参考URL : https://www.pcg-random.org/
+// 整数演算のみで構成されるため、処理系や標準ライブラリの実装に依らず同一の系列を生成します。
+// (std::mt19937 + std::uniform_real_distribution は分布側の実装が処理系依存となる)
+class Pcg32 final
+{
+public:
+	using result_type = uint32_t;
+
+	static constexpr result_type min()noexcept { return 0; }
+	static constexpr result_type max()noexcept { return std::numeric_limits<result_type>::max(); }
+
+	constexpr Pcg32()noexcept : Pcg32(0x853c49e6748fea9bull) {}
+	constexpr explicit Pcg32(uint64_t seed, uint64_t sequence = 0xda3e39cb94b95bdbull)noexcept
+	{
+		this->seed(seed, sequence);
+	}
+
+	// 内部状態を初期化します
+	constexpr void seed(uint64_t seed, uint64_t sequence = 0xda3e39cb94b95bdbull)noexcept
+	{
+		mState = 0;
+		mIncrement = (sequence << 1u) | 1u;
+		next();
+		mState += seed;
+		next();
+	}
+
+	// 32bitの一様乱数を返します
+	constexpr result_type next()noexcept
+	{
+		const uint64_t old = mState;
+		mState = old * MULTIPLIER + mIncrement;
+		const auto xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+		const auto rot = static_cast<uint32_t>(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31u));
+	}
+	constexpr result_type operator()()noexcept { return next(); }
+
+	// [0, bound) の一様な整数乱数を返します (偏りなし)
+	constexpr result_type nextBounded(result_type bound)noexcept
+	{
+		if(bound == 0) return 0;
+		const result_type threshold = (0u - bound) % bound;
+		while(true) {
+			const result_type r = next();
+			if(r >= threshold) return r % bound;
+		}
+	}
+
+private:
+	static constexpr uint64_t MULTIPLIER = 6364136223846793005ull;
+
+	uint64_t mState = 0;
+	uint64_t mIncrement = 0;
+};
+
+// ノイズ種別
+enum class NoiseColor
+{
+	White,	// ホワイトノイズ : 全帯域で均一なパワー
+	Pink,	// ピンクノイズ : -3dB/oct (Voss-McCartney法)
+	Brown,	// ブラウンノイズ : -6dB/oct (リーク付き積分)
+};
+
+// ノイズジェネレータ
+// 内部状態は全て整数で保持し、出力時のみ2のべき乗でスケーリングして浮動小数に変換します。
+// そのため同一シードであれば、処理系を問わずビット単位で同一の出力が得られます。
+template<std::floating_point parameter_type = float>
+class NoiseGenerator final
+{
+public:
+	explicit NoiseGenerator(uint64_t seed = 0, NoiseColor color = NoiseColor::White)noexcept
+		: mRandomEngine(seed)
+		, mColor(color)
+	{
+		resetState();
+	}
+
+	// 乱数系列を初期化します
+	void seed(uint64_t seed)noexcept
+	{
+		mRandomEngine.seed(seed);
+		resetState();
+	}
+
+	// ノイズ種別を設定します
+	void setColor(NoiseColor color)noexcept
+	{
+		if(mColor != color) {
+			mColor = color;
+			resetState();
+		}
+	}
+	NoiseColor color()const noexcept { return mColor; }
+
+	// 1サンプル生成します [-1.0, +1.0)
+	parameter_type update()noexcept
+	{
+		switch(mColor) {
+		case NoiseColor::White: return nextWhite();
+		case NoiseColor::Pink:  return nextPink();
+		case NoiseColor::Brown: return nextBrown();
+		}
+		std::unreachable();
+	}
+
+	// 指定バッファをノイズで埋めます
+	// ノイズ種別による分岐をループ外に出しているため、サンプル単位のupdate()より高速です
+	void generate(parameter_type* dest, size_t len)noexcept
+	{
+		switch(mColor) {
+		case NoiseColor::White:
+			for(size_t i = 0; i < len; ++i) dest[i] = nextWhite();
+			break;
+		case NoiseColor::Pink:
+			for(size_t i = 0; i < len; ++i) dest[i] = nextPink();
+			break;
+		case NoiseColor::Brown:
+			for(size_t i = 0; i < len; ++i) dest[i] = nextBrown();
+			break;
+		}
+	}
+	void generate(std::span<parameter_type> dest)noexcept
+	{
+		generate(dest.data(), dest.size());
+	}
+
+private:
+	// 上位24bitを [-1.0, +1.0) に変換する : 24bit以内の整数と2のべき乗の積のため、丸め誤差は発生しない
+	static constexpr parameter_type WHITE_SCALE = static_cast<parameter_type>(1.0 / (1 << 23));
+	// ピンクノイズ : 各行は20bit符号付き, (行数+1)個の和を正規化する
+	static constexpr size_t PINK_ROWS = 15;
+	static constexpr int32_t PINK_ROW_HALF_RANGE = 1 << 19;
+	static constexpr parameter_type PINK_SCALE = static_cast<parameter_type>(1.0 / (PINK_ROW_HALF_RANGE * (PINK_ROWS + 1)));
+	// ブラウンノイズ : 24bit符号付きの範囲で積分し、リークにより直流成分の蓄積を防ぐ
+	static constexpr int32_t BROWN_LIMIT = 1 << 23;
+	static constexpr int BROWN_LEAK_SHIFT = 10; // 時定数 : 1024サンプル
+	static constexpr int BROWN_STEP_SHIFT = 14; // 1サンプル当たりの変化幅 : ±2^17
+
+	void resetState()noexcept
+	{
+		mPinkRows.fill(0);
+		mPinkRunningSum = 0;
+		mPinkCounter = 0;
+		mBrownNoisePrevLevel = 0;
+	}
+
+	// 32bit乱数の上位bitを符号付き整数として取り出します
+	int32_t nextSigned(int bits)noexcept
+	{
+		return static_cast<int32_t>(mRandomEngine.next()) >> (32 - bits);
+	}
+
+	parameter_type nextWhite()noexcept
+	{
+		return static_cast<parameter_type>(nextSigned(24)) * WHITE_SCALE;
+	}
+
+	parameter_type nextPink()noexcept
+	{
+		// Voss-McCartney法 : カウンタの末尾の0の数に応じた行を更新することで、
+		// 行kは2^(k+1)サンプル毎に更新され、全行の和が近似的に1/f特性を持つ
+		mPinkCounter = (mPinkCounter + 1) & ((1u << PINK_ROWS) - 1);
+		if(mPinkCounter != 0) {
+			const auto row = static_cast<size_t>(std::countr_zero(mPinkCounter));
+			const int32_t v = nextSigned(20);
+			mPinkRunningSum += v - mPinkRows[row];
+			mPinkRows[row] = v;
+		}
+		const int32_t white = nextSigned(20);
+		return static_cast<parameter_type>(mPinkRunningSum + white) * PINK_SCALE;
+	}
+
+	parameter_type nextBrown()noexcept
+	{
+		// リーク付き積分 : C++20以降、負数の右シフトは算術シフトであることが保証される
+		int32_t level = mBrownNoisePrevLevel;
+		level -= level >> BROWN_LEAK_SHIFT;
+		level += nextSigned(32) >> BROWN_STEP_SHIFT;
+		// 範囲外に出た場合は反射させる
+		if(level >= BROWN_LIMIT) level = 2 * BROWN_LIMIT - 1 - level;
+		else if(level < -BROWN_LIMIT) level = -2 * BROWN_LIMIT - level;
+		mBrownNoisePrevLevel = level;
+		return static_cast<parameter_type>(level) * WHITE_SCALE;
+	}
+
+private:
+	Pcg32 mRandomEngine;
+	NoiseColor mColor;
+
+	std::array<int32_t, PINK_ROWS> mPinkRows;
+	int32_t mPinkRunningSum;
+	uint32_t mPinkCounter;
+
+	int32_t mBrownNoisePrevLevel;
+};
+
+}
@@ -0,0 +1,247 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/dsp/fft.hpp>
+
+#include <cmath>
+#include <numeric>
+
+namespace lsp::dsp
+{
+
+// リサンプラ品質
+enum class ResamplerQuality
+{
+	Low,	// タップ数16 : 低負荷。プレビュー用途向け
+	Medium,	// タップ数32 : 標準
+	High,	// タップ数64 : 高品質。通過帯域を最大限確保する
+};
+
+// リサンプラ (ストリーミング対応 ポリフェーズ窓付きsinc補間)
+// 任意の入出力サンプリング周波数比に対応します。
+//   - 入出力周波数の比は最大公約数で約分した整数比として保持するため、長時間処理しても位相ずれが蓄積しません
+//   - フィルタ係数はフェーズ数+1行のテーブルとして事前計算し、隣接フェーズ間を線形補間して用います
+//   - 履歴はチャネル毎に非インターリーブで保持し、内積計算がSIMD化されやすい連続メモリ上で行われるようにしています
+// 出力の0フレーム目は入力の0フレーム目と時刻が一致します。(群遅延は内部で補償済み)
+// ただし出力にはタップ数の半分の入力フレーム分の先読みが必要となります。
+template<std::floating_point sample_type = float>
+class Resampler final
+	: non_copy
+{
+public:
+	Resampler(uint32_t inputFreq, uint32_t outputFreq, uint32_t channels, ResamplerQuality quality = ResamplerQuality::Medium)
+		: mInputFreq(inputFreq)
+		, mOutputFreq(outputFreq)
+		, mChannels(channels)
+		, mQuality(quality)
+	{
+		lsp_require(inputFreq > 0);
+		lsp_require(outputFreq > 0);
+		lsp_require(channels > 0);
+
+		const auto g = std::gcd(inputFreq, outputFreq);
+		mInStep = inputFreq / g;
+		mOutStep = outputFreq / g;
+
+		switch(quality) {
+		case ResamplerQuality::Low:		mTaps = 16; mPhases = 64;  mRolloff = 0.85; break;
+		case ResamplerQuality::Medium:	mTaps = 32; mPhases = 128; mRolloff = 0.91; break;
+		case ResamplerQuality::High:	mTaps = 64; mPhases = 256; mRolloff = 0.95; break;
+		}
+
+		buildCoefficients();
+		mKernel.resize(mTaps);
+		mHistory.resize(mChannels);
+		reset();
+	}
+
+	uint32_t inputFreq()const noexcept { return mInputFreq; }
+	uint32_t outputFreq()const noexcept { return mOutputFreq; }
+	uint32_t channels()const noexcept { return mChannels; }
+	ResamplerQuality quality()const noexcept { return mQuality; }
+
+	// 入力信号に対する遅延(入力フレーム数)を取得します
+	size_t latency()const noexcept { return mTaps / 2; }
+
+	// 内部状態をリセットします
+	void reset()noexcept
+	{
+		// 群遅延補償のため、窓の中心より前の分だけ無音を先頭に詰めておく
+		mHistoryFrames = mTaps / 2 - 1;
+		for(auto& h : mHistory) {
+			if(h.size() < mHistoryFrames) h.resize(mHistoryFrames);
+			std::fill_n(h.begin(), mHistoryFrames, static_cast<sample_type>(0));
+		}
+		mPosInt = 0;
+		mPosFrac = 0;
+	}
+
+	// 指定入力フレーム数を与えた場合の最大出力フレーム数を取得します
+	size_t maxOutputFrames(size_t inputFrames)const noexcept
+	{
+		return static_cast<size_t>((static_cast<uint64_t>(inputFrames) * mOutStep + mInStep - 1) / mInStep) + 1;
+	}
+
+	// 信号を変換します
+	// 入力のチャネル数はコンストラクタで指定したチャネル数と一致している必要があります
+	Signal<sample_type> process(const SignalView<sample_type>& in, std::pmr::memory_resource* mem = std::pmr::get_default_resource())
+	{
+		lsp_require(in.channels() == mChannels);
+
+		push(in.data(), in.frames());
+		auto out = Signal<sample_type>::allocate(mem, mChannels, pendingOutputFrames());
+		render(out.data(), out.frames());
+		compact();
+		return out;
+	}
+
+	// 信号を変換します (インターリーブ形式のバッファ版)
+	// 出力バッファに収まらなかった分は内部に保持され、次回の呼び出し時に出力されます
+	// 戻り値 : 出力したフレーム数
+	size_t process(const sample_type* in, size_t inFrames, sample_type* out, size_t outCapacityFrames)
+	{
+		push(in, inFrames);
+		const auto frames = std::min(pendingOutputFrames(), outCapacityFrames);
+		render(out, frames);
+		compact();
+		return frames;
+	}
+
+private:
+	void buildCoefficients()
+	{
+		// ダウンサンプリング時は出力側ナイキスト周波数以下に帯域制限する
+		const double cutoff = mRolloff * std::min(1.0, static_cast<double>(mOutputFreq) / static_cast<double>(mInputFreq));
+		const double halfTaps = static_cast<double>(mTaps) / 2.0;
+
+		mCoefs.resize((mPhases + 1) * mTaps);
+		std::vector<double> tmp(mTaps);
+		for(size_t p = 0; p <= mPhases; ++p) {
+			auto row = mCoefs.data() + p * mTaps;
+			const double frac = static_cast<double>(p) / static_cast<double>(mPhases);
+			double sum = 0;
+			for(size_t j = 0; j < mTaps; ++j) {
+				// 窓中心からの距離
+				const double x = static_cast<double>(j) - (halfTaps - 1.0) - frac;
+				const double sx = math::PI<double> * cutoff * x;
+				const double sinc = (x == 0) ? 1.0 : std::sin(sx) / sx;
+				const double window = fft::BlackmanWf<double>((x + halfTaps) / static_cast<double>(mTaps));
+				tmp[j] = cutoff * sinc * window;
+				sum += tmp[j];
+			}
+			// 直流ゲインをフェーズ毎に1へ正規化し、フェーズに依存したリップルを抑える
+			for(size_t j = 0; j < mTaps; ++j) {
+				row[j] = static_cast<sample_type>(tmp[j] / sum);
+			}
+		}
+	}
+
+	// 入力をチャネル毎の履歴に追加します
+	void push(const sample_type* in, size_t frames)
+	{
+		const size_t required = mHistoryFrames + frames;
+		for(uint32_t ch = 0; ch < mChannels; ++ch) {
+			auto& h = mHistory[ch];
+			if(h.size() < required) h.resize(required);
+			auto dest = h.data() + mHistoryFrames;
+			const auto src = in + ch;
+			for(size_t i = 0; i < frames; ++i) {
+				dest[i] = src[i * mChannels];
+			}
+		}
+		mHistoryFrames = required;
+	}
+
+	// 現在の履歴から出力可能なフレーム数を取得します
+	size_t pendingOutputFrames()const noexcept
+	{
+		if(mHistoryFrames < mTaps) return 0;
+		// 位置は 1/mOutStep 入力フレーム単位で扱う
+		const uint64_t limit = static_cast<uint64_t>(mHistoryFrames - mTaps + 1) * mOutStep;
+		const uint64_t current = static_cast<uint64_t>(mPosInt) * mOutStep + mPosFrac;
+		if(current >= limit) return 0;
+		return static_cast<size_t>((limit - current + mInStep - 1) / mInStep);
+	}
+
+	void render(sample_type* out, size_t frames)noexcept
+	{
+		const auto kernel = mKernel.data();
+		for(size_t i = 0; i < frames; ++i) {
+			// 隣接フェーズの係数を線形補間して、この出力時刻用のカーネルを求める
+			const uint64_t phasePos = static_cast<uint64_t>(mPosFrac) * mPhases;
+			const auto phase = static_cast<size_t>(phasePos / mOutStep);
+			const auto alpha = static_cast<sample_type>(static_cast<double>(phasePos % mOutStep) / static_cast<double>(mOutStep));
+			const auto c0 = mCoefs.data() + phase * mTaps;
+			const auto c1 = c0 + mTaps;
+			for(size_t j = 0; j < mTaps; ++j) {
+				kernel[j] = c0[j] + alpha * (c1[j] - c0[j]);
+			}
+
+			auto frame = out + i * mChannels;
+			for(uint32_t ch = 0; ch < mChannels; ++ch) {
+				frame[ch] = dot(mHistory[ch].data() + mPosInt, kernel, mTaps);
+			}
+
+			// 次の出力時刻へ
+			mPosFrac += mInStep;
+			mPosInt += mPosFrac / mOutStep;
+			mPosFrac %= mOutStep;
+		}
+	}
+
+	// 消費済みの履歴を破棄します
+	void compact()noexcept
+	{
+		const size_t consumed = std::min(mPosInt, mHistoryFrames);
+		if(consumed == 0) return;
+		for(auto& h : mHistory) {
+			std::copy(h.begin() + consumed, h.begin() + mHistoryFrames, h.begin());
+		}
+		mHistoryFrames -= consumed;
+		mPosInt -= consumed;
+	}
+
+	// 内積 : 独立した4系統のアキュムレータに分けることで、コンパイラの自動ベクトル化を促す
+	// (タップ数は常に4の倍数)
+	static sample_type dot(const sample_type* x, const sample_type* h, size_t n)noexcept
+	{
+		sample_type acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+		for(size_t j = 0; j < n; j += 4) {
+			acc0 += x[j + 0] * h[j + 0];
+			acc1 += x[j + 1] * h[j + 1];
+			acc2 += x[j + 2] * h[j + 2];
+			acc3 += x[j + 3] * h[j + 3];
+		}
+		return (acc0 + acc1) + (acc2 + acc3);
+	}
+
+private:
+	const uint32_t mInputFreq;
+	const uint32_t mOutputFreq;
+	const uint32_t mChannels;
+	const ResamplerQuality mQuality;
+
+	// 約分済みの入出力周波数比
+	uint32_t mInStep;
+	uint32_t mOutStep;
+
+	// フィルタ係数 : (フェーズ数+1) x タップ数
+	size_t mTaps = 0;
+	size_t mPhases = 0;
+	double mRolloff = 0;
+	std::vector<sample_type> mCoefs;
+	std::vector<sample_type> mKernel;
+
+	// チャネル毎の入力履歴
+	std::vector<std::vector<sample_type>> mHistory;
+	size_t mHistoryFrames = 0;
+
+	// 現在の出力時刻 (履歴先頭からの入力フレーム位置 : 整数部 + mPosFrac/mOutStep)
+	size_t mPosInt = 0;
+	uint32_t mPosFrac = 0;
+};
+
+}
@@ -0,0 +1,130 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+#include <cmath>
+
+namespace lsp::dsp
+{
+
+// FDNリバーブ (Feedback Delay Network)
+// 8本の遅延線をハウスホルダー行列で相互に帰還させ、各遅延線内の1次ローパスで高域の減衰を表現します。
+//   - 入力はステレオ(インターリーブ)を受け付け、モノラルに混合してからプリディレイを経てネットワークへ入力します
+//   - 出力は偶数番/奇数番の遅延線をそれぞれL/Rへ振り分けることで、相関の低いステレオ出力を得ます
+template<std::floating_point parameter_type = float>
+class FdnReverb final
+	: non_copy
+{
+public:
+	static constexpr size_t LINES = 8;
+
+	FdnReverb() = default;
+
+	// パラメータを設定します (内部状態はリセットされます)
+	// decaySec: 残響時間(RT60, 秒), damping: 高域減衰 [0.0, 1.0), preDelaySec: プリディレイ(秒)
+	void setParam(parameter_type sampleFreq, parameter_type decaySec, parameter_type damping, parameter_type preDelaySec)
+	{
+		lsp_require(sampleFreq > 0);
+		lsp_require(decaySec > 0);
+		lsp_require(damping >= 0 && damping < 1);
+
+		// 互いに素に近い遅延長(ミリ秒) : 残響の周期性(金属的な響き)を避ける
+		static constexpr std::array<double, LINES> DELAY_MS = { 29.7, 37.1, 41.1, 43.7, 47.9, 53.3, 59.9, 67.1 };
+
+		size_t total = 0;
+		for(size_t i = 0; i < LINES; ++i) {
+			const auto len = std::max<size_t>(1, static_cast<size_t>(DELAY_MS[i] * 1e-3 * sampleFreq));
+			mLineOffsets[i] = total;
+			mLineLengths[i] = len;
+			// RT60 : 遅延長あたり -60dB * (遅延長 / 残響時間) 減衰させる
+			mLineGains[i] = static_cast<parameter_type>(std::pow(10.0, -3.0 * static_cast<double>(len) / (static_cast<double>(decaySec) * sampleFreq)));
+			total += len;
+		}
+		mLines.assign(total, 0);
+		mDamping = damping;
+
+		mPreDelayLength = std::max<size_t>(1, static_cast<size_t>(preDelaySec * sampleFreq));
+		mPreDelay.assign(mPreDelayLength, 0);
+
+		reset();
+	}
+
+	// 内部状態をリセットします
+	void reset()noexcept
+	{
+		std::fill(mLines.begin(), mLines.end(), static_cast<parameter_type>(0));
+		std::fill(mPreDelay.begin(), mPreDelay.end(), static_cast<parameter_type>(0));
+		mLinePositions.fill(0);
+		mLowpassStates.fill(0);
+		mPreDelayPos = 0;
+	}
+
+	// ステレオ信号を処理します
+	// in : 入力(インターリーブ 2ch), out : ウェット出力(インターリーブ 2ch, 上書き)
+	// 遅延線は setParam() で確保されるため、それ以前に呼び出すことはできません
+	void process(const parameter_type* in, parameter_type* out, size_t frames)noexcept
+	{
+		lsp_require(!mLines.empty());
+
+		constexpr auto HOUSEHOLDER = static_cast<parameter_type>(2.0 / LINES);
+		constexpr auto OUTPUT_GAIN = static_cast<parameter_type>(1.0 / (LINES / 2));
+		const auto damping = mDamping;
+		const auto lines = mLines.data();
+
+		std::array<parameter_type, LINES> taps;
+		for(size_t i = 0; i < frames; ++i) {
+			// プリディレイ
+			const auto mono = (in[i * 2 + 0] + in[i * 2 + 1]) * static_cast<parameter_type>(0.5);
+			const auto input = mPreDelay[mPreDelayPos];
+			mPreDelay[mPreDelayPos] = mono;
+			if(++mPreDelayPos >= mPreDelayLength) mPreDelayPos = 0;
+
+			// 各遅延線の出力 + ダンピング
+			parameter_type sum = 0;
+			for(size_t l = 0; l < LINES; ++l) {
+				const auto v = lines[mLineOffsets[l] + mLinePositions[l]] * mLineGains[l];
+				mLowpassStates[l] = v + (mLowpassStates[l] - v) * damping;
+				taps[l] = mLowpassStates[l];
+				sum += taps[l];
+			}
+
+			// 出力 : 偶数番→L, 奇数番→R
+			parameter_type left = 0, right = 0;
+			for(size_t l = 0; l < LINES; l += 2) {
+				left += taps[l];
+				right += taps[l + 1];
+			}
+			out[i * 2 + 0] = left * OUTPUT_GAIN;
+			out[i * 2 + 1] = right * OUTPUT_GAIN;
+
+			// ハウスホルダー行列による帰還 : y = x - (2/N)Σx (無損失)
+			// 入力は符号を交互に変えて注入し、遅延線間の相関を下げる
+			const auto feedback = sum * HOUSEHOLDER;
+			for(size_t l = 0; l < LINES; ++l) {
+				const auto injected = (l & 1) ? -input : input;
+				lines[mLineOffsets[l] + mLinePositions[l]] = taps[l] - feedback + injected;
+				if(++mLinePositions[l] >= mLineLengths[l]) mLinePositions[l] = 0;
+			}
+		}
+	}
+
+private:
+	// 遅延線 : 全遅延線を1つの連続領域に配置する
+	std::vector<parameter_type> mLines;
+	std::array<size_t, LINES> mLineOffsets = {};
+	std::array<size_t, LINES> mLineLengths = {};
+	std::array<size_t, LINES> mLinePositions = {};
+	std::array<parameter_type, LINES> mLineGains = {};
+	std::array<parameter_type, LINES> mLowpassStates = {};
+	parameter_type mDamping = 0;
+
+	// プリディレイ
+	std::vector<parameter_type> mPreDelay;
+	size_t mPreDelayLength = 1;
+	size_t mPreDelayPos = 0;
+};
+
+}
@@ -0,0 +1,109 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+namespace lsp::dsp {
+
+// サンプル再生時のループ種別 (SoundFont 2 の sampleModes に準拠)
+enum class SampleLoopMode : uint8_t
+{
+	None = 0,			// ループしない (末尾で停止)
+	Continuous = 1,		// 常にループする
+	UntilRelease = 3,	// ノートオフまでループし、以降は末尾まで再生する
+};
+
+// PCMサンプル プレーヤー
+// 外部が所有する16bit PCM (メモリマップ領域等) をコピーせずに参照し、任意の速度で線形補間再生します。
+// ステレオサンプルの場合は linked に対となるチャネルを指定すると、モノラルへミックスダウンして再生します。
+template<
+	std::floating_point sample_type
+>
+class SamplePlayer final
+{
+public:
+	SamplePlayer() = default;
+	SamplePlayer(std::span<const int16_t> data, std::span<const int16_t> linked, size_t loopStart, size_t loopEnd, SampleLoopMode loopMode)
+		: mData(data)
+		, mLinked(linked)
+		, mLoopStart(loopStart)
+		, mLoopEnd(loopEnd)
+		, mLoopMode(loopMode)
+		, mFinished(data.empty())
+	{
+		lsp_require(linked.empty() || linked.size() == data.size());
+		// ループ区間が不正な場合はループしない
+		if(mLoopMode == SampleLoopMode::None || !(loopStart < loopEnd && loopEnd <= data.size())) {
+			mLoopMode = SampleLoopMode::None;
+			mLoopStart = mLoopEnd = data.size();
+		}
+	}
+
+	// 1サンプル再生し、再生位置を step (元サンプル単位) だけ進めます
+	sample_type update(double step)noexcept
+	{
+		if(mFinished) return 0;
+
+		const size_t i0 = static_cast<size_t>(mPos);
+		const sample_type frac = static_cast<sample_type>(mPos - static_cast<double>(i0));
+		// 補間対象の次サンプル : ループ中はループ先頭へ戻る
+		size_t i1 = i0 + 1;
+		if(looping() && i1 >= mLoopEnd) i1 = mLoopStart;
+
+		const sample_type v0 = peek(i0);
+		const sample_type v1 = peek(i1);
+		const sample_type v = v0 + (v1 - v0) * frac;
+
+		mPos += step;
+		if(looping() && mPos >= static_cast<double>(mLoopEnd)) {
+			const double length = static_cast<double>(mLoopEnd - mLoopStart);
+			mPos = static_cast<double>(mLoopStart) + std::fmod(mPos - static_cast<double>(mLoopStart), length);
+		} else if(mPos >= static_cast<double>(mData.size())) {
+			mFinished = true;
+		}
+		return v;
+	}
+
+	// ノートオフを通知します (UntilRelease の場合、以降はループを抜けて末尾まで再生します)
+	void noteOff()noexcept { mReleased = true; }
+
+	// 末尾まで再生し終えたか否かを取得します
+	bool isFinished()const noexcept { return mFinished; }
+
+	// 16bit PCM の指定位置のサンプルを正規化して取得します (linked が空でない場合はモノラルへミックスダウン)
+	static sample_type sampleAt(std::span<const int16_t> data, std::span<const int16_t> linked, size_t i)noexcept
+	{
+		constexpr sample_type scale = sample_type(1) / sample_type(32768);
+		if(linked.empty()) {
+			return static_cast<sample_type>(data[i]) * scale;
+		}
+		return (static_cast<sample_type>(data[i]) + static_cast<sample_type>(linked[i])) * (scale / 2);
+	}
+
+private:
+	bool looping()const noexcept
+	{
+		return mLoopMode == SampleLoopMode::Continuous
+			|| (mLoopMode == SampleLoopMode::UntilRelease && !mReleased);
+	}
+	sample_type peek(size_t i)const noexcept
+	{
+		if(i >= mData.size()) return 0;
+		return sampleAt(mData, mLinked, i);
+	}
+
+private:
+	std::span<const int16_t> mData;
+	std::span<const int16_t> mLinked;
+	size_t mLoopStart = 0;
+	size_t mLoopEnd = 0;
+	SampleLoopMode mLoopMode = SampleLoopMode::None;
+
+	double mPos = 0;
+	bool mReleased = false;
+	bool mFinished = true;
+};
+
+}
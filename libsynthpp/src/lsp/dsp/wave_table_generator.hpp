@@ -32,6 +32,16 @@ public:
 		lsp_require(table.frames() > 0);
 		lsp_require(table.channels() == 1);
 	}
+	// 知覚音量正規化係数を算出済みの場合に使用します (perceptualNorm : 同じ table, volume, cycles に対する computePerceptualNorm の結果)
+	WaveTableGenerator(const Signal<sample_type>& table, parameter_type volume, parameter_type cycles, parameter_type perceptualNorm)
+		: mTable(&table)
+		, mVolume(volume)
+		, mCycles(cycles)
+		, mPerceptualNorm(perceptualNorm)
+	{
+		lsp_require(table.frames() > 0);
+		lsp_require(table.channels() == 1);
+	}
 
 	// 人間の聴覚上の音量を均一化するための係数を返します
 	// 正弦波を基準(1.0)として、波形のRMSに基づいて算出されます
@@ -45,7 +55,6 @@ public:
 		return v;
 	}
 
-private:
 	// 1周期分の波形データからRMSベースの知覚音量正規化係数を算出します
 	// 正弦波(RMS = 1/√2)を基準とし、実効出力(テーブル値 × volume)のRMSとの比を返します
 	static parameter_type computePerceptualNorm(const Signal<sample_type>& table, parameter_type volume, parameter_type cycles)
@@ -68,6 +77,13 @@ private:
 
 		return (rms > parameter_type(0)) ? (refRms / rms) : parameter_type(1);
 	}
+	// volume = 1 で算出した正規化係数を、指定の volume 用に換算します (テーブルを再走査しない)
+	static parameter_type scalePerceptualNorm(parameter_type unitNorm, parameter_type volume) noexcept
+	{
+		return (volume != parameter_type(0)) ? (unitNorm / std::abs(volume)) : parameter_type(1);
+	}
+
+private:
 
 	sample_type peek()const 
 	{
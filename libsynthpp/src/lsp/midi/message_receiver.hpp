@@ -2,6 +2,7 @@
 
 #include <lsp/core/core.hpp>
 #include <lsp/midi/message.hpp>
+#include <lsp/midi/ump.hpp>
 
 namespace lsp::midi
 {
@@ -14,6 +15,9 @@ public:
 
 	// MIDIメッセージ受信コールバック : メッセージ類は蓄積される
 	virtual void onMidiMessageReceived(clock::time_point msg_time, const std::shared_ptr<const Message>& msg) = 0;
+
+	// Universal MIDI Packet 受信コールバック : メッセージ類は蓄積される
+	virtual void onUmpReceived(clock::time_point msg_time, const Ump& packet) = 0;
 };
 
 }
\ No newline at end of file
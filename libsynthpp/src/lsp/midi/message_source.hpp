@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message.hpp>
+#include <lsp/midi/ump.hpp>
+
+namespace lsp::midi
+{
+// MIDIメッセージ ソース (プル型)
+// レンダリングスレッドからブロック毎に呼び出され、そのブロックの区間に含まれるメッセージを区間先頭からのフレーム位置と共に返します。
+// 時刻はレンダリングしたフレーム数のみで進むため、レンダリングスレッドの遅延による影響を受けません。
+class MessageSource
+	: non_copy_move
+{
+public:
+	// メッセージの受け取り先
+	class Receiver
+	{
+	public:
+		// frameOffset : ブロック先頭からのフレーム位置 (時系列順に呼び出される)
+		// メッセージとパケットは同一の時系列として扱われる
+		virtual void onMessage(size_t frameOffset, const std::shared_ptr<const Message>& msg) = 0;
+		virtual void onPacket(size_t frameOffset, const Ump& packet) = 0;
+		// SysEx : data はステータスバイト(F0/F7)を含まない SysExMessage::data() 相当のバイト列 (呼び出し中のみ有効)
+		virtual void onSysEx(size_t frameOffset, std::span<const uint8_t> data) = 0;
+
+	protected:
+		~Receiver() = default;
+	};
+
+	virtual ~MessageSource() {}
+
+	// 再生位置を frames だけ進め、その区間に含まれるメッセージを receiver へ渡します
+	virtual void advance(uint32_t sampleFreq, size_t frames, Receiver& receiver) = 0;
+};
+
+}
@@ -0,0 +1,138 @@
+﻿#include <lsp/midi/smf/batch_parser.hpp>
+#include <lsp/util/mapped_file.hpp>
+
+#include <bitset>
+#include <cctype>
+
+using namespace lsp;
+using namespace lsp::midi::smf;
+
+BatchParser::Result BatchParser::parse(ThreadPool& pool, std::span<const std::filesystem::path> paths, bool keepBodies)
+{
+	Result result;
+	result.files.resize(paths.size());
+
+	// ファイル毎に1タスクとして投入する (結果は入力と同じ位置へ格納する)
+	std::vector<std::future<void>> futures;
+	futures.reserve(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) {
+		futures.emplace_back(pool.enqueue([&result, &paths, i, keepBodies] {
+			result.files[i] = parseFile(paths[i], keepBodies);
+		}));
+	}
+	// MEMO タスクは result/paths を参照するため、例外を再送出する前に全タスクの完了を待つ
+	for (auto& f : futures) {
+		f.wait();
+	}
+	for (auto& f : futures) {
+		f.get();
+	}
+
+	// 集計
+	auto& stat = result.statistics;
+	for (const auto& file : result.files) {
+		++stat.files;
+		if (!file.succeeded()) {
+			++stat.failed;
+			continue;
+		}
+		++stat.succeeded;
+		stat.events += file.statistics.events;
+		stat.notes += file.statistics.notes;
+		stat.maxPolyphony = std::max(stat.maxPolyphony, file.statistics.maxPolyphony);
+		stat.tempoChanges += file.statistics.tempoChanges;
+		stat.totalDuration += file.statistics.duration;
+		stat.maxDuration = std::max(stat.maxDuration, file.statistics.duration);
+	}
+	return result;
+}
+
+BatchParser::Result BatchParser::parseDirectory(ThreadPool& pool, const std::filesystem::path& directory, bool recursive, bool keepBodies)
+{
+	auto isSmf = [](const std::filesystem::path& path) {
+		auto ext = path.extension().string();
+		std::ranges::transform(ext, ext.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		return ext == ".mid" || ext == ".midi" || ext == ".smf";
+	};
+
+	std::vector<std::filesystem::path> paths;
+	auto collect = [&](const auto& iterator) {
+		for (const auto& entry : iterator) {
+			if (entry.is_regular_file() && isSmf(entry.path())) {
+				paths.push_back(entry.path());
+			}
+		}
+	};
+	if (recursive) {
+		collect(std::filesystem::recursive_directory_iterator(directory));
+	} else {
+		collect(std::filesystem::directory_iterator(directory));
+	}
+	// 結果の順序を安定させる
+	std::ranges::sort(paths);
+
+	return parse(pool, paths, keepBodies);
+}
+
+BatchParser::FileResult BatchParser::parseFile(const std::filesystem::path& path, bool keepBodies)
+{
+	FileResult result;
+	result.path = path;
+
+	try {
+		MappedFile file;
+		try {
+			file = MappedFile(path, MappedFile::AccessPattern::Sequential);
+		} catch (const std::system_error&) {
+			throw decoding_exception("invalid input");
+		}
+		Parser parser(file.data());
+
+		// Parser::parse と同様に全トラックをマージしながら、統計情報を集める
+		auto& stat = result.statistics;
+		std::array<std::bitset<128>, 16> sounding; // 発音中のノート (チャネル毎)
+		uint32_t polyphony = 0;
+
+		Body body;
+		MergedCursor cursor(parser);
+		while (auto ev = cursor.next()) {
+			const auto& event = ev->event;
+			if (event.isMeta()) {
+				if (event.isTempo()) ++stat.tempoChanges;
+				continue;
+			}
+			++stat.events;
+			stat.duration = ev->time;
+
+			// 同時発音数の推定 : 同じノート番号の再発音は 発音数を増やさない
+			const auto kind = event.status & 0xF0;
+			const auto ch = event.status & 0x0F;
+			const auto note = event.data[0] & 0x7F;
+			if (kind == 0x90 && event.data[1] > 0) {
+				++stat.notes;
+				if (!sounding[ch].test(note)) {
+					sounding[ch].set(note);
+					stat.maxPolyphony = std::max(stat.maxPolyphony, ++polyphony);
+				}
+			} else if (kind == 0x80 || kind == 0x90) {
+				if (sounding[ch].test(note)) {
+					sounding[ch].reset(note);
+					--polyphony;
+				}
+			}
+
+			if (keepBodies) {
+				body.emplace_back(ev->time, event.toMessage());
+			}
+		}
+
+		result.header = parser.header();
+		result.body = std::move(body);
+	} catch (const decoding_exception& e) {
+		result.header.reset();
+		result.body.clear();
+		result.statistics = {};
+		result.error = e.what();
+	}
+	return result;
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/smf/parser.hpp>
+#include <lsp/util/thread_pool.hpp>
+
+namespace lsp::midi::smf
+{
+
+// SMFファイル 一括パーサ
+// 複数のSMFファイルをスレッドプール上で並列に解析し、ファイル毎の結果(またはエラー)と全体の統計情報を返します。
+class BatchParser final
+{
+public:
+	// ファイル毎の統計情報
+	struct FileStatistics
+	{
+		size_t events = 0;			// メッセージ数 (メタイベントを除く)
+		size_t notes = 0;			// ノートオン数
+		uint32_t maxPolyphony = 0;	// 最大同時発音数の推定値 (ホールドペダル等は考慮しない)
+		size_t tempoChanges = 0;	// テンポ設定メタイベント数
+		std::chrono::microseconds duration{0}; // 演奏時間 (最後のメッセージの時間)
+	};
+
+	// ファイル毎の解析結果
+	struct FileResult
+	{
+		std::filesystem::path path;
+		std::optional<Header> header; // 解析に失敗した場合は無効値
+		Body body;					// keepBodies=false の場合は空
+		FileStatistics statistics;
+		std::string error;			// 解析に失敗した場合のエラー内容
+
+		bool succeeded()const noexcept { return header.has_value(); }
+	};
+
+	// 全体の統計情報
+	struct CorpusStatistics
+	{
+		size_t files = 0;
+		size_t succeeded = 0;
+		size_t failed = 0;
+		size_t events = 0;
+		size_t notes = 0;
+		uint32_t maxPolyphony = 0;
+		size_t tempoChanges = 0;
+		std::chrono::microseconds totalDuration{0};
+		std::chrono::microseconds maxDuration{0};
+	};
+
+	struct Result
+	{
+		std::vector<FileResult> files; // 入力と同じ順序
+		CorpusStatistics statistics;
+	};
+
+	// 指定されたファイルを並列に解析します
+	// keepBodies : 解析結果のメッセージ列を保持するか否か (検証のみが目的の場合はfalseとしてメモリ使用量を抑える)
+	// 解析エラーはファイル毎の結果として記録します。それ以外の例外(std::bad_alloc等)は全タスクの完了後に再送出します
+	static Result parse(ThreadPool& pool, std::span<const std::filesystem::path> paths, bool keepBodies = true);
+
+	// 指定されたディレクトリ内のSMFファイル(.mid, .midi, .smf)を並列に解析します
+	static Result parseDirectory(ThreadPool& pool, const std::filesystem::path& directory, bool recursive = true, bool keepBodies = true); // throws std::filesystem::filesystem_error
+
+private:
+	static FileResult parseFile(const std::filesystem::path& path, bool keepBodies);
+};
+
+}
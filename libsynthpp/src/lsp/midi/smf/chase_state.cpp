@@ -0,0 +1,238 @@
+﻿#include <lsp/midi/smf/chase_state.hpp>
+#include <lsp/midi/messages/basic_message.hpp>
+#include <lsp/midi/messages/sysex_message.hpp>
+#include <lsp/midi/sysex_pattern.hpp>
+
+using namespace lsp;
+using namespace lsp::midi;
+using namespace lsp::midi::smf;
+
+ChaseState::ChaseState()
+{
+	for (auto& ch : mChannels) {
+		ch.reset();
+	}
+}
+
+void ChaseState::Channel::reset()noexcept
+{
+	program = UNSET;
+	pitchBend = UNSET;
+	channelPressure = UNSET;
+	monoMode.reset();
+	controls.fill(UNSET);
+	parameters.clear();
+	resetParameterNumber();
+}
+void ChaseState::Channel::resetParameterNumber()noexcept
+{
+	rpnMSB = rpnLSB = UNSET;
+	nrpnMSB = nrpnLSB = UNSET;
+}
+// CC#121 リセットオールコントローラ : MidiChannel::resetAllControllers と同じ範囲を初期状態に戻す
+void ChaseState::Channel::resetAllControllers()noexcept
+{
+	for (uint8_t ctrlNo : { 1, 11, 64, 66, 71, 72, 73, 74, 75 }) {
+		controls[ctrlNo] = UNSET;
+	}
+	pitchBend = UNSET;
+	channelPressure = UNSET;
+	resetParameterNumber();
+}
+void ChaseState::Channel::dataEntry(bool isLSB, uint8_t value)
+{
+	auto update = [&](bool isNRPN, int16_t msb, int16_t lsb) {
+		if (msb == UNSET || lsb == UNSET) return;
+		auto found = std::ranges::find_if(parameters, [&](const ParameterValue& p) {
+			return p.isNRPN == isNRPN && p.msb == msb && p.lsb == lsb;
+		});
+		if (found == parameters.end()) {
+			found = parameters.insert(parameters.end(), { isNRPN, static_cast<uint8_t>(msb), static_cast<uint8_t>(lsb), UNSET, UNSET });
+		}
+		if (isLSB) {
+			found->valueLSB = value;
+		} else {
+			// Data Entry(MSB) は LSB をクリアする
+			found->valueMSB = value;
+			found->valueLSB = UNSET;
+		}
+	};
+	update(false, rpnMSB, rpnLSB);
+	update(true, nrpnMSB, nrpnLSB);
+}
+
+void ChaseState::apply(const std::shared_ptr<const Message>& msg)
+{
+	if (auto sysex = dynamic_cast<const messages::SysExMessage*>(msg.get())) {
+		if (isSystemReset(sysex->data())) {
+			// システムリセット : それ以前の状態は全て破棄される
+			mSystemReset = msg;
+			mSysExMessages.clear();
+			for (auto& ch : mChannels) {
+				ch.reset();
+			}
+		} else {
+			mSysExMessages.push_back(msg);
+		}
+		return;
+	}
+
+	const auto channel = msg->channel();
+	if (channel >= CHANNELS) return;
+	auto& ch = mChannels[channel];
+
+	// MEMO 大した数ではないので、ベタで分岐する
+	if (auto cc = dynamic_cast<const messages::ControlChange*>(msg.get())) {
+		controlChange(ch, cc->ctrlNo(), cc->value());
+	} else if (auto pc = dynamic_cast<const messages::ProgramChange*>(msg.get())) {
+		ch.program = pc->progId();
+	} else if (auto pb = dynamic_cast<const messages::PitchBend*>(msg.get())) {
+		ch.pitchBend = pb->pitch();
+	} else if (auto cp = dynamic_cast<const messages::ChannelPressure*>(msg.get())) {
+		ch.channelPressure = cp->value();
+	}
+}
+
+void ChaseState::controlChange(Channel& ch, uint8_t ctrlNo, uint8_t value)
+{
+	switch (ctrlNo) {
+	case 6: // Data Entry(MSB)
+		ch.dataEntry(false, value);
+		break;
+	case 38: // Data Entry(LSB)
+		ch.dataEntry(true, value);
+		break;
+	case 98: // NRPN(LSB)
+		ch.nrpnLSB = value;
+		break;
+	case 99: // NRPN(MSB)
+		ch.resetParameterNumber();
+		ch.nrpnMSB = value;
+		break;
+	case 100: // RPN(LSB)
+		ch.rpnLSB = value;
+		if (ch.rpnMSB == 0x7F && ch.rpnLSB == 0x7F) {
+			// RPNヌル
+			ch.resetParameterNumber();
+		}
+		break;
+	case 101: // RPN(MSB)
+		ch.resetParameterNumber();
+		ch.rpnMSB = value;
+		break;
+	case 120: // オールサウンドオフ
+	case 123: // オールノートオフ
+		// 発音に関するものは追跡しない
+		break;
+	case 121: // リセットオールコントローラ
+		ch.resetAllControllers();
+		break;
+	case 126: // モノモード
+		ch.monoMode = true;
+		break;
+	case 127: // ポリモード
+		ch.monoMode = false;
+		break;
+	default:
+		if (ctrlNo < 120) {
+			ch.controls[ctrlNo] = value;
+		}
+		break;
+	}
+}
+
+std::vector<std::shared_ptr<const Message>> ChaseState::toMessages(SystemType defaultSystemType)const
+{
+	std::vector<std::shared_ptr<const Message>> ret;
+
+	// 発音中のボイスを止めてからシステムリセットを行う
+	for (uint8_t ch = 0; ch < CHANNELS; ++ch) {
+		ret.push_back(std::make_shared<messages::ControlChange>(ch, 120, 0));
+	}
+	ret.push_back(mSystemReset ? mSystemReset : makeSystemReset(defaultSystemType));
+	ret.insert(ret.end(), mSysExMessages.begin(), mSysExMessages.end());
+
+	for (uint8_t channel = 0; channel < CHANNELS; ++channel) {
+		const auto& ch = mChannels[channel];
+		auto cc = [&](uint8_t ctrlNo, int16_t value) {
+			if (value == UNSET) return;
+			ret.push_back(std::make_shared<messages::ControlChange>(channel, ctrlNo, static_cast<uint8_t>(value)));
+		};
+
+		if (ch.monoMode.has_value()) {
+			cc(*ch.monoMode ? 126 : 127, 0);
+		}
+
+		// バンクセレクト + プログラムチェンジ
+		cc(0, ch.controls[0]);
+		cc(32, ch.controls[32]);
+		if (ch.program != UNSET) {
+			ret.push_back(std::make_shared<messages::ProgramChange>(channel, static_cast<uint8_t>(ch.program)));
+		}
+
+		// コントロールチェンジ
+		for (uint8_t ctrlNo = 1; ctrlNo < 120; ++ctrlNo) {
+			switch (ctrlNo) {
+			case 32: // バンクセレクト (適用済み)
+			case 6: case 38: case 96: case 97: case 98: case 99: case 100: case 101: // RPN/NRPN (後述)
+				continue;
+			default:
+				cc(ctrlNo, ch.controls[ctrlNo]);
+				break;
+			}
+		}
+
+		// RPN/NRPN : パラメータ毎に番号を選択して値を書き込む
+		for (const auto& p : ch.parameters) {
+			cc(p.isNRPN ? 99 : 101, p.msb);
+			cc(p.isNRPN ? 98 : 100, p.lsb);
+			cc(6, p.valueMSB);
+			cc(38, p.valueLSB);
+		}
+		// 選択中のパラメータ番号を復元する (未選択の場合はRPNヌル)
+		if (ch.nrpnMSB != UNSET) {
+			cc(99, ch.nrpnMSB);
+			cc(98, ch.nrpnLSB);
+		} else if (ch.rpnMSB != UNSET) {
+			cc(101, ch.rpnMSB);
+			cc(100, ch.rpnLSB);
+		} else if (!ch.parameters.empty()) {
+			cc(101, 0x7F);
+			cc(100, 0x7F);
+		}
+
+		if (ch.pitchBend != UNSET) {
+			ret.push_back(std::make_shared<messages::PitchBend>(channel, ch.pitchBend));
+		}
+		if (ch.channelPressure != UNSET) {
+			ret.push_back(std::make_shared<messages::ChannelPressure>(channel, static_cast<uint8_t>(ch.channelPressure)));
+		}
+	}
+	return ret;
+}
+
+std::shared_ptr<const Message> ChaseState::makeSystemReset(SystemType type)
+{
+	// TODO System Mode Set 1/2には非対応
+	if(type.isOnlyGM1()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x7E, 0x7F, 0x09, 0x01 });
+	} else if (type.isGM2()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x7E, 0x7F, 0x09, 0x03 });
+	} else if (type.isOnlyGS()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41 });
+	} else if (type.isSystemModeSet1()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x41, 0x10, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x00, 0x01 });
+	} else if (type.isSystemModeSet2()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x41, 0x10, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x01, 0x00 });
+	} else if (type.isXG()) {
+		return std::make_shared<messages::SysExMessage>(std::vector<uint8_t>{ 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00 });
+	}
+	lsp_check(false); // Unsupported SystemType
+	return {};
+}
+
+bool ChaseState::isSystemReset(std::span<const uint8_t> data)noexcept
+{
+	// Synthesizer::sysExMessage でシステムリセットとして扱われるもの
+	return midi::findSystemReset(data).has_value();
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message.hpp>
+#include <lsp/midi/system_type.hpp>
+
+namespace lsp::midi::smf
+{
+
+// 追跡(チェイス)状態
+// シーケンスの途中から再生を開始する際に、その時点までのメッセージが作り出す音源の状態を再現するための情報を保持します。
+//   - システムリセット(GM/GS/XG) と、それ以降の SysEx
+//   - チャネル毎の プログラム, バンクセレクト, コントロールチェンジ, RPN/NRPN, ピッチベンド, チャネルプレッシャー
+// ノートオン/オフ 等の発音に関するメッセージは追跡しません。
+class ChaseState
+{
+public:
+	static constexpr size_t CHANNELS = 16;
+
+	ChaseState();
+
+	// メッセージを適用します
+	void apply(const std::shared_ptr<const Message>& msg);
+
+	// 状態を再現するメッセージ列を取得します
+	// システムリセットが1度も適用されていない場合は、defaultSystemType のシステムリセットから開始します
+	std::vector<std::shared_ptr<const Message>> toMessages(SystemType defaultSystemType)const;
+
+	// システムリセット(SysEx)メッセージを作成します
+	static std::shared_ptr<const Message> makeSystemReset(SystemType type);
+
+	// システムリセット(SysEx)メッセージか否かを判定します
+	static bool isSystemReset(std::span<const uint8_t> data)noexcept;
+
+private:
+	static constexpr int16_t UNSET = -1;
+
+	// RPN/NRPN パラメータ値
+	struct ParameterValue
+	{
+		bool isNRPN;
+		uint8_t msb;
+		uint8_t lsb;
+		int16_t valueMSB;
+		int16_t valueLSB;
+	};
+
+	struct Channel
+	{
+		int16_t program;
+		int16_t pitchBend;
+		int16_t channelPressure;
+		std::optional<bool> monoMode;
+		std::array<int16_t, 128> controls; // UNSET : 未設定
+
+		// 選択中のRPN/NRPNパラメータ番号
+		int16_t rpnMSB, rpnLSB;
+		int16_t nrpnMSB, nrpnLSB;
+		std::vector<ParameterValue> parameters;
+
+		void reset()noexcept;
+		void resetParameterNumber()noexcept;
+		void resetAllControllers()noexcept;
+		void dataEntry(bool isLSB, uint8_t value);
+	};
+
+	void controlChange(Channel& ch, uint8_t ctrlNo, uint8_t value);
+
+private:
+	std::shared_ptr<const Message> mSystemReset;
+	std::vector<std::shared_ptr<const Message>> mSysExMessages; // システムリセット以降のSysEx
+	std::array<Channel, CHANNELS> mChannels;
+};
+
+}
@@ -0,0 +1,182 @@
+﻿#include <lsp/midi/smf/compiled_sequence.hpp>
+#include <lsp/util/checksum.hpp>
+
+#include <cstring>
+#include <fstream>
+
+using namespace lsp;
+using namespace lsp::midi::smf;
+
+// TODO リトルエンディアンでの実行前提
+static_assert(std::endian::native == std::endian::little);
+
+namespace
+{
+
+constexpr size_t align8(size_t n) noexcept { return (n + 7) & ~size_t(7); }
+
+// 値をバイト列の末尾に追加します
+template<class T>
+void append(std::vector<std::byte>& buff, const T& value)
+{
+	static_assert(std::is_trivially_copyable_v<T>);
+	const auto bytes = std::as_bytes(std::span(&value, 1));
+	buff.insert(buff.end(), bytes.begin(), bytes.end());
+}
+
+}
+
+void CompiledSequence::compile(const Parser& parser, const std::filesystem::path& path)
+{
+	std::vector<CompiledEvent> events;
+	std::vector<CompiledTempo> tempos;
+	std::vector<std::byte> sysex;
+
+	// 全トラックを時系列順に走査して各ブロックを構築する
+	MergedCursor cursor(parser);
+	while (auto ev = cursor.next()) {
+		const auto& event = ev->event;
+		if (event.isMeta()) {
+			// メタイベントはテンポ設定のみ保持する
+			if (event.isTempo()) {
+				tempos.push_back({ ev->time.count(), event.tick, static_cast<uint32_t>(event.tempo().count()), 0 });
+			}
+			continue;
+		}
+		CompiledEvent rec = { ev->time.count(), event.status, event.data, 0, 0 };
+		if (rec.isSysEx()) {
+			if (sysex.size() + sizeof(uint32_t) + event.payload.size() > std::numeric_limits<uint32_t>::max()) {
+				throw decoding_exception("too large sysex area");
+			}
+			rec.sysex = static_cast<uint32_t>(sysex.size());
+			append(sysex, static_cast<uint32_t>(event.payload.size()));
+			sysex.insert(sysex.end(), event.payload.begin(), event.payload.end());
+		}
+		events.push_back(rec);
+	}
+
+	// ヘッダ以降の領域を構築
+	std::vector<std::byte> body;
+	body.reserve(events.size() * sizeof(CompiledEvent) + tempos.size() * sizeof(CompiledTempo) + align8(sysex.size()));
+	const auto events_bytes = std::as_bytes(std::span(events));
+	const auto tempos_bytes = std::as_bytes(std::span(tempos));
+	body.insert(body.end(), events_bytes.begin(), events_bytes.end());
+	body.insert(body.end(), tempos_bytes.begin(), tempos_bytes.end());
+	body.insert(body.end(), sysex.begin(), sysex.end());
+	body.resize(align8(body.size()));
+
+	FileHeader fh = {};
+	fh.magic = MAGIC;
+	fh.version = VERSION;
+	fh.headerSize = sizeof(FileHeader);
+	fh.format = parser.header().format;
+	fh.trackNum = parser.header().trackNum;
+	fh.ticksPerQuarterNote = parser.header().ticksPerQuarterNote;
+	fh.eventOffset = sizeof(FileHeader);
+	fh.eventCount = events.size();
+	fh.tempoOffset = fh.eventOffset + events_bytes.size();
+	fh.tempoCount = tempos.size();
+	fh.sysexOffset = fh.tempoOffset + tempos_bytes.size();
+	fh.sysexSize = sysex.size();
+	fh.checksum = xxh64(body);
+
+	std::ofstream s;
+	s.exceptions(std::ios::failbit | std::ios::badbit);
+	s.open(path, std::ios::binary | std::ios::trunc);
+	s.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+	s.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+	s.close();
+}
+
+void CompiledSequence::compile(const std::filesystem::path& smfPath, const std::filesystem::path& path)
+{
+	MappedFile file;
+	try {
+		file = MappedFile(smfPath, MappedFile::AccessPattern::Sequential);
+	} catch (const std::system_error&) {
+		throw decoding_exception("invalid input");
+	}
+	compile(Parser(file.data()), path);
+}
+
+CompiledSequence::CompiledSequence(const std::filesystem::path& path)
+{
+	try {
+		mFile = MappedFile(path, MappedFile::AccessPattern::Sequential);
+	} catch (const std::system_error&) {
+		throw decoding_exception("invalid input");
+	}
+	const auto data = mFile.data();
+
+	// ヘッダ
+	FileHeader fh;
+	if (data.size() < sizeof(fh)) throw decoding_exception("invalid compiled sequence : truncated");
+	std::memcpy(&fh, data.data(), sizeof(fh));
+	if (fh.magic != MAGIC) throw decoding_exception("invalid compiled sequence");
+	if (fh.version != VERSION) throw decoding_exception("invalid compiled sequence : unsupported version");
+	if (fh.headerSize != sizeof(FileHeader)) throw decoding_exception("invalid compiled sequence");
+
+	// 各ブロックの境界 : 乗算のオーバーフローを避けるため、要素数は残りの領域から求めた上限と比較する
+	auto block = [&](uint64_t offset, uint64_t count, size_t elem) {
+		if (offset % alignof(uint64_t) != 0 || offset > data.size() || count > (data.size() - offset) / elem) {
+			throw decoding_exception("invalid compiled sequence : broken layout");
+		}
+		return data.subspan(static_cast<size_t>(offset), static_cast<size_t>(count * elem));
+	};
+	const auto events = block(fh.eventOffset, fh.eventCount, sizeof(CompiledEvent));
+	const auto tempos = block(fh.tempoOffset, fh.tempoCount, sizeof(CompiledTempo));
+	mSysEx = block(fh.sysexOffset, fh.sysexSize, 1);
+
+	// チェックサム
+	if (xxh64(data.subspan(sizeof(FileHeader))) != fh.checksum) {
+		throw decoding_exception("invalid compiled sequence : checksum mismatch");
+	}
+
+	// マップ領域はページ境界に配置され、各ブロックは8バイト境界に配置されているため、直接参照できる
+	mEvents = { reinterpret_cast<const CompiledEvent*>(events.data()), static_cast<size_t>(fh.eventCount) };
+	mTempoMap = { reinterpret_cast<const CompiledTempo*>(tempos.data()), static_cast<size_t>(fh.tempoCount) };
+
+	// SysExの参照先 : 再生時(レンダリングスレッド上)に失敗しないよう、読み込み時に検証する
+	for (const auto& ev : mEvents) {
+		if (ev.isSysEx()) sysex(ev);
+	}
+
+	mHeader.format = fh.format;
+	mHeader.trackNum = fh.trackNum;
+	mHeader.ticksPerQuarterNote = fh.ticksPerQuarterNote;
+}
+
+std::span<const std::byte> CompiledSequence::sysex(const CompiledEvent& ev)const
+{
+	// (uint32_t 長さ, データ)
+	ByteReader r(mSysEx);
+	auto head = r.read_span(ev.sysex);
+	auto raw_length = r.read_span(sizeof(uint32_t));
+	if (!head || !raw_length) throw decoding_exception("invalid compiled sequence : broken sysex");
+	uint32_t length;
+	std::memcpy(&length, raw_length->data(), sizeof(length));
+	auto payload = r.read_span(length);
+	if (!payload) throw decoding_exception("invalid compiled sequence : broken sysex");
+	return *payload;
+}
+
+std::unique_ptr<midi::Message> CompiledSequence::toMessage(const CompiledEvent& ev)const
+{
+	TrackEvent event;
+	event.status = ev.status;
+	event.data = ev.data;
+	if (ev.isSysEx()) {
+		event.payload = sysex(ev);
+	}
+	return event.toMessage();
+}
+
+Body CompiledSequence::toBody()const
+{
+	Body body;
+	body.reserve(mEvents.size());
+	for (const auto& ev : mEvents) {
+		body.emplace_back(std::chrono::microseconds(ev.time), toMessage(ev));
+	}
+	return body;
+}
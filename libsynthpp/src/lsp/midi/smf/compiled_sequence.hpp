@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message.hpp>
+#include <lsp/midi/smf/parser.hpp>
+#include <lsp/midi/smf/sequence.hpp>
+#include <lsp/util/mapped_file.hpp>
+
+namespace lsp::midi::smf
+{
+
+// コンパイル済みシーケンス : イベントレコード (16バイト)
+struct CompiledEvent
+{
+	// 曲先頭からの時間 (マイクロ秒)
+	int64_t time;
+
+	// ステータスバイト
+	uint8_t status;
+
+	// データバイト
+	std::array<uint8_t, 2> data;
+
+	uint8_t reserved;
+
+	// SysEx領域内のオフセット (SysExの場合のみ有効)
+	uint32_t sysex;
+
+	// SysExイベントか否かを取得します
+	constexpr bool isSysEx()const noexcept { return status == 0xF0 || status == 0xF7; }
+};
+static_assert(sizeof(CompiledEvent) == 16 && std::is_trivially_copyable_v<CompiledEvent>);
+
+// コンパイル済みシーケンス : テンポマップレコード (24バイト)
+struct CompiledTempo
+{
+	// 曲先頭からの時間 (マイクロ秒)
+	int64_t time;
+
+	// 曲先頭からの時刻(tick)
+	uint64_t tick;
+
+	// 4分音符あたりの時間 (マイクロ秒)
+	uint32_t timePerQuarterNote;
+
+	uint32_t reserved;
+};
+static_assert(sizeof(CompiledTempo) == 24 && std::is_trivially_copyable_v<CompiledTempo>);
+
+// コンパイル済みシーケンス
+// SMFを解析・実時間変換した結果を固定長レコードの平坦な形式で保存し、メモリマップにより読み込みます。
+// 読み込み時にはイベント毎のメモリ確保を行いません。
+// 再生は CompiledSequencer によりイベントレコードから直接行い、toBody()/toSequence() は既存のシーケンサで再生する場合にのみ使用します。
+//
+// ファイル形式 (リトルエンディアン, 各ブロックは8バイト境界に配置) :
+//   FileHeader | CompiledEvent[eventCount] | CompiledTempo[tempoCount] | SysEx領域
+//   SysEx領域  : (uint32_t 長さ, データ) の並び
+//   checksum  : FileHeader以降の全バイトに対する XXH64
+class CompiledSequence final
+	: non_copy
+{
+public:
+	static constexpr uint32_t MAGIC = 0x51534C4C; // "LLSQ"
+	static constexpr uint16_t VERSION = 3;
+
+	// SMFをコンパイルして保存します
+	static void compile(const Parser& parser, const std::filesystem::path& path); // throws decoding_exception, std::ios_base::failure
+	static void compile(const std::filesystem::path& smfPath, const std::filesystem::path& path); // throws decoding_exception, std::ios_base::failure
+
+	// コンパイル済みシーケンスを読み込みます
+	explicit CompiledSequence(const std::filesystem::path& path); // throws decoding_exception
+
+	// ヘッダを取得します
+	const Header& header()const noexcept { return mHeader; }
+
+	// イベントを取得します (時系列順)
+	std::span<const CompiledEvent> events()const noexcept { return mEvents; }
+
+	// テンポマップを取得します (時系列順)
+	std::span<const CompiledTempo> tempoMap()const noexcept { return mTempoMap; }
+
+	// SysExイベントのデータを取得します
+	// 読み込み時に全てのSysExイベントの参照先を検証するため、events() のイベントに対しては例外を送出しません
+	std::span<const std::byte> sysex(const CompiledEvent& ev)const; // throws decoding_exception
+
+	// イベントをMIDIメッセージへ変換します
+	std::unique_ptr<Message> toMessage(const CompiledEvent& ev)const; // throws decoding_exception
+
+	// 全てのイベントをMIDIメッセージへ変換します
+	Body toBody()const; // throws decoding_exception
+
+	// 全てのイベントを共有可能なシーケンスへ変換します
+	std::shared_ptr<const Sequence> toSequence()const { return Sequence::create(toBody()); } // throws decoding_exception
+
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+
+		uint16_t format;
+		uint16_t trackNum;
+		uint16_t ticksPerQuarterNote;
+		uint16_t reserved;
+
+		uint64_t eventOffset;
+		uint64_t eventCount;
+		uint64_t tempoOffset;
+		uint64_t tempoCount;
+		uint64_t sysexOffset;
+		uint64_t sysexSize;
+
+		uint64_t checksum;
+	};
+	static_assert(sizeof(FileHeader) == 72 && std::is_trivially_copyable_v<FileHeader>);
+
+
+private:
+	MappedFile mFile;
+	Header mHeader;
+	std::span<const CompiledEvent> mEvents;
+	std::span<const CompiledTempo> mTempoMap;
+	std::span<const std::byte> mSysEx;
+};
+
+}
@@ -0,0 +1,132 @@
+﻿#include <lsp/midi/smf/compiled_sequencer.hpp>
+
+using namespace lsp;
+using namespace lsp::midi::smf;
+
+namespace
+{
+// 時間 → フレーム位置 (切り捨て)
+uint64_t to_frames(int64_t time, uint32_t sampleFreq)
+{
+	return static_cast<uint64_t>(time) * sampleFreq / 1000000ull;
+}
+}
+
+void CompiledSequencer::load(std::shared_ptr<const CompiledSequence> sequence)
+{
+	// 旧シーケンス(マップ領域)の解放は advance() を待たせないよう、ロック外で行う
+	std::shared_ptr<const CompiledSequence> retired;
+	std::shared_ptr<const CompiledSequence> garbage;
+	{
+		std::lock_guard lock(mMutex);
+		garbage = collectGarbage();
+		retired = std::exchange(mSequence, std::move(sequence));
+		if (mDelivering && retired.get() == mDeliveringSequence) {
+			// 配送中のシーケンスは配送後に回収する
+			std::swap(retired, mRetiredSequence);
+		}
+		mPlaying = false;
+		++mSerial;
+		mNextIndex = 0;
+		mRestart = false;
+		mFramePosition = 0;
+		mPosition.store(0, std::memory_order_relaxed);
+	}
+}
+void CompiledSequencer::start()
+{
+	std::shared_ptr<const CompiledSequence> garbage;
+	std::lock_guard lock(mMutex);
+	if (!mSequence) return; // 未ロード
+	garbage = collectGarbage();
+	mPlaying = true;
+	++mSerial;
+	mNextIndex = 0;
+	mRestart = true;
+	mPosition.store(0, std::memory_order_relaxed);
+}
+void CompiledSequencer::stop()
+{
+	std::shared_ptr<const CompiledSequence> garbage;
+	std::lock_guard lock(mMutex);
+	garbage = collectGarbage();
+	mPlaying = false;
+	++mSerial;
+}
+bool CompiledSequencer::isPlaying()const
+{
+	std::lock_guard lock(mMutex);
+	return mPlaying;
+}
+std::chrono::microseconds CompiledSequencer::position()const
+{
+	return std::chrono::microseconds(mPosition.load(std::memory_order_relaxed));
+}
+std::shared_ptr<const CompiledSequence> CompiledSequencer::collectGarbage()
+{
+	// mMutex を保持した状態で呼び出すこと
+	if (mDelivering) return nullptr;
+	return std::move(mRetiredSequence);
+}
+
+void CompiledSequencer::advance(uint32_t sampleFreq, size_t frames, Receiver& receiver)
+{
+	// 共有状態の複製 : 配送はロック外で行う
+	const CompiledSequence* sequence;
+	uint64_t serial;
+	size_t index;
+	uint64_t position;
+	{
+		std::lock_guard lock(mMutex);
+		if (!mPlaying || !mSequence) return;
+		sequence = mSequence.get();
+		serial = mSerial;
+		index = mNextIndex;
+
+		// 再生位置の反映 : サンプリング周波数の変更にも追従する
+		if (mRestart) {
+			position = 0;
+		} else if (mSampleFreq != sampleFreq && mSampleFreq != 0) {
+			position = mFramePosition * sampleFreq / mSampleFreq;
+		} else {
+			position = mFramePosition;
+		}
+
+		mDelivering = true;
+		mDeliveringSequence = sequence;
+	}
+
+	// 区間 [position, end) に含まれるイベントを配送する
+	const auto events = sequence->events();
+	const uint64_t end = position + frames;
+	while (index < events.size()) {
+		const auto& ev = events[index];
+		const auto frame = to_frames(ev.time, sampleFreq);
+		if (frame >= end) break;
+		const auto offset = frame > position ? static_cast<size_t>(frame - position) : 0;
+		if (ev.isSysEx()) {
+			const auto data = sequence->sysex(ev); // 読み込み時に検証済み
+			receiver.onSysEx(offset, { reinterpret_cast<const uint8_t*>(data.data()), data.size() });
+		} else if (auto packet = Ump::upConvert(ev.status, ev.data[0], ev.data[1])) {
+			receiver.onPacket(offset, *packet);
+		}
+		++index;
+	}
+
+	// 再生状態の書き戻し : 配送中に再生状態が変更された場合は変更後の状態を優先する
+	std::lock_guard lock(mMutex);
+	mDelivering = false;
+	mDeliveringSequence = nullptr;
+	if (serial != mSerial) return;
+
+	mNextIndex = index;
+	mRestart = false;
+	mFramePosition = end;
+	mSampleFreq = sampleFreq;
+	mPosition.store(static_cast<int64_t>(end * 1000000ull / sampleFreq), std::memory_order_relaxed);
+
+	// 全て配送し終えた場合、停止
+	if (mNextIndex >= events.size()) {
+		mPlaying = false;
+	}
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message_source.hpp>
+#include <lsp/midi/smf/compiled_sequence.hpp>
+
+namespace lsp::midi::smf
+{
+// コンパイル済みシーケンス シーケンサ (レンダリングスレッド駆動)
+// CompiledSequence のメモリマップ上のイベントレコードを、メッセージオブジェクトへ変換せずに直接配送します。
+//   - チャネルボイスメッセージ : ステータス/データバイトから Universal MIDI Packet を作成して配送する
+//   - SysEx : マップ領域を参照する span として配送する
+// 読み込み・再生のいずれもイベント毎のメモリ確保を行わないため、同じファイルを繰り返し再生する用途に向きます。
+class CompiledSequencer final
+	: public MessageSource
+{
+public:
+	CompiledSequencer() = default;
+
+	// コンパイル済みシーケンスを開きます (シーケンスは他のシーケンサと共有されます)
+	void load(std::shared_ptr<const CompiledSequence> sequence);
+
+	// 先頭から再生を開始/再開します
+	void start();
+
+	// 再生を停止します
+	void stop();
+
+	// 再生中か否かを取得します
+	bool isPlaying()const;
+
+	// 再生位置を取得します
+	std::chrono::microseconds position()const;
+
+	// MessageSource : 再生位置を進め、区間内のイベントを配送します
+	void advance(uint32_t sampleFreq, size_t frames, Receiver& receiver)override;
+
+private:
+	[[nodiscard]] std::shared_ptr<const CompiledSequence> collectGarbage();
+
+private:
+	// MEMO advance() は mMutex を配送前後の状態の受け渡しの間のみ保持し、受け取り先への配送はロック外で行う (RenderSequencer と同様)
+	mutable std::mutex mMutex;
+	std::shared_ptr<const CompiledSequence> mSequence;
+	std::shared_ptr<const CompiledSequence> mRetiredSequence; // 配送中に差し替えたシーケンス
+
+	// 配送中の状態
+	bool mDelivering = false;
+	const CompiledSequence* mDeliveringSequence = nullptr;
+
+	bool mPlaying = false;
+	uint64_t mSerial = 0; // 再生状態の変更回数 : 配送中に変更された場合、advance() は再生位置を書き戻さない
+	size_t mNextIndex = 0; // 次に配送するイベント
+	bool mRestart = false; // 次のブロックで再生位置を先頭へ戻す
+	uint64_t mFramePosition = 0; // 再生位置 (フレーム数)
+	uint32_t mSampleFreq = 0; // 直近のブロックのサンプリング周波数
+	std::atomic<int64_t> mPosition = 0; // 再生位置 (マイクロ秒, position() 用)
+};
+
+}
@@ -4,9 +4,7 @@
 #include <lsp/midi/messages/extra_message.hpp>
 #include <lsp/midi/messages/sysex_message.hpp>
 #include <lsp/midi/messages/meta_events.hpp>
-
-#include <array>
-#include <fstream>
+#include <lsp/util/mapped_file.hpp>
 
 using namespace lsp;
 using namespace lsp::midi::smf;
@@ -16,118 +14,40 @@ using namespace lsp::midi::smf;
 //  https://www.g200kg.com/jp/docs/dic/midi.html
 //  https://www.cs.cmu.edu/~music/cmsip/readings/Standard-MIDI-file-format-updated.pdf
 
-namespace 
-{
-
-// ビッグエンディアンの値を読み出します
-template<
-	std::integral T
->
-std::optional<T> read_big(std::istream& s, size_t bytes = sizeof(T)) 
-{
-	// TODO リトルエンディアンでの実行前提
-	// TODO アラインメントが適切ではない可能性あり
-	lsp_require(bytes <= sizeof(T));
-	std::array<uint8_t, sizeof(T)> buff = {0};
-	for (size_t i = 0; i < bytes; ++i) {
-		int b = s.get();
-		if(b < 0) return {};
-		buff[bytes-i-1] = static_cast<uint8_t>(b);
-	}
-	return std::bit_cast<T>(buff);
-}
-
-// 1バイトを読み出します
-std::optional<uint8_t> read_byte(std::istream& s) 
-{
-	// TODO リトルエンディアンでの実行前提
-	// TODO アラインメントが適切ではない可能性あり
-
-	int b = s.get();
-	if(b < 0) return {};
-	return static_cast<uint8_t>(b);
-}
-
-// デルタタイム(可変長数値)を読み出します
-std::optional<uint32_t> read_variable(std::istream& s) 
-{
-	uint32_t ret = 0;
-	int read_bytes = 0;
-	while (true) {
-		// 最大でも4バイトで構成される
-		if(read_bytes >= 4) return {}; 
-
-		int b = s.get();
-		++read_bytes;
-		if(b < 0) return {}; // EOF or error
-
-		// 数値として使う値は7bit単位で格納されている
-		ret <<= 7;
-		ret += static_cast<uint8_t>(b & 0x7F);
-
-		// 最上位桁が0ならば、この桁で終わり
-		if((b & 0x80) == 0) break;
-	}
-	return ret;
-}
-
-}
-
-
 std::pair<Header, Body> Parser::parse(const std::filesystem::path& path)
 {
-
-	std::ifstream s(path, std::ios::binary);
-
-	if(s.fail()) {
+	MappedFile file;
+	try {
+		file = MappedFile(path, MappedFile::AccessPattern::Sequential);
+	} catch(const std::system_error&) {
 		throw decoding_exception("invalid input");
 	}
-	Parser parser(s);
-
-	// ヘッダ解析
-	Header header;
-	parser.stageHeader(header);
+	return parse(file.data());
+}
 
-	// トラックチャンク
-	std::vector<std::pair<uint64_t, std::unique_ptr<Message>>> raw_messages;
-	for (uint16_t i = 0; i < header.trackNum; ++i) {
-		parser.stageTrack(raw_messages);
-	}
-	// 時系列順にソート
-	std::stable_sort(raw_messages.begin(), raw_messages.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first;});
+std::pair<Header, Body> Parser::parse(std::span<const std::byte> data)
+{
+	Parser parser(data);
 
-	// 実時間に変換(マイクロ秒単位)
+	// 全トラックを時系列順にマージしながら実時間に変換する(マイクロ秒単位)
 	Body body;
-	std::chrono::microseconds pos(0); // 曲先頭からの相対時間
-	std::chrono::microseconds time_per_tick(0); // 1tickあたりの時間
-	
-	uint64_t prev_tick = 0;
-	for (auto&& [tick, msg] : raw_messages) {
-		uint64_t delta = tick - prev_tick; 
-		pos += time_per_tick * delta;
+	MergedCursor cursor(parser);
+	while (auto ev = cursor.next()) {
+		// メタイベントは再生時には使用しない (テンポ設定はカーソル内で処理済み)
+		if (ev->event.isMeta()) continue;
 
-		if (auto meta_event = dynamic_cast<const messages::MetaEvent*>(msg.get())) {
-			// メタイベントは再生時には使用しない。 このタイミングで全て処理する
-			
-			// MEMO 対した数ではないので、ベタで分岐する
-			if (auto ev = dynamic_cast<const messages::SetTempo*>(meta_event)) {
-				time_per_tick = ev->timePerQuarterNote() / header.ticksPerQuarterNote; 
-			}
-
-		} else {
-			// その他のメッセージは実行時に処理対象とする
-			body.emplace_back(pos, std::move(msg));
-		}
-		prev_tick = tick;
+		// その他のメッセージは実行時に処理対象とする
+		body.emplace_back(ev->time, ev->event.toMessage());
 	}
 
 	// OK
-	s.close();
-	return std::make_pair<Header, Body>(std::move(header), std::move(body));
+	return std::make_pair(parser.header(), std::move(body));
 }
 
-void Parser::stageHeader(Header& header)
+Parser::Parser(std::span<const std::byte> data)
 {
+	ByteReader r(data);
+
 	auto require = [](const auto& optional_value) {
 		if(!optional_value.has_value()) {
 			throw decoding_exception("invalid header chunk");
@@ -135,206 +55,248 @@ void Parser::stageHeader(Header& header)
 		return optional_value.value();
 	};
 
+	// --- ヘッダチャンク ---
+
 	// チャンクタイプ
-	auto chunk_type = require(read_big<uint32_t>(s));
+	auto chunk_type = require(r.read_big<uint32_t>());
 	if(chunk_type != 0x4D546864) throw decoding_exception("invalid header chunk");
 
 	// データ長
-	auto data_length = require(read_big<uint32_t>(s));
+	auto data_length = require(r.read_big<uint32_t>());
 	if(data_length < 6) throw decoding_exception("invalid header chunk : invalid length");
-	std::istream::pos_type next_chunk_pos = s.tellg();
-	next_chunk_pos += data_length;
+	ByteReader hr(require(r.read_span(data_length))); // 残りの不明なヘッダは読み飛ばされる
 
 	// フォーマット (フォーマット0または1のみに対応)
-	auto format = require(read_big<uint16_t>(s));
+	auto format = require(hr.read_big<uint16_t>());
 	if(format >= 2) throw decoding_exception("invalid header chunk : unsupported format");
 
 	// トラック数
-	auto track_num = require(read_big<uint16_t>(s));
+	auto track_num = require(hr.read_big<uint16_t>());
 	
 	// 時間単位
-	auto time_division = require(read_big<int16_t>(s));
+	auto time_division = require(hr.read_big<int16_t>());
 	if(time_division < 0) throw decoding_exception("invalid header chunk : unsupported time division - SMPTE format");
 	auto ticks_per_quarter_note = static_cast<uint16_t>(time_division);
-
-	// ---
-
-	// 読み終わった残りの不明なヘッダを読み飛ばす
-	s.seekg(next_chunk_pos);
-
-	// --- 
-
-	header.format = format;
-	header.trackNum = track_num;
-	header.ticksPerQuarterNote = ticks_per_quarter_note;
+	if(ticks_per_quarter_note == 0) throw decoding_exception("invalid header chunk : invalid time division");
+
+	mHeader.format = format;
+	mHeader.trackNum = track_num;
+	mHeader.ticksPerQuarterNote = ticks_per_quarter_note;
+
+	// --- トラックチャンク ---
+	// ここではチャンクの境界のみを確認し、内容はカーソルにより遅延解析する
+	mTracks.reserve(track_num);
+	while(mTracks.size() < track_num) {
+		auto type = r.read_big<uint32_t>();
+		auto length = r.read_big<uint32_t>();
+		if(!type || !length) throw decoding_exception("invalid track chunk");
+		auto chunk = r.read_span(*length);
+		if(!chunk) throw decoding_exception("invalid track chunk : truncated");
+
+		// 未知のチャンクは読み飛ばす
+		if(*type != 0x4D54726b) continue;
+		mTracks.push_back(*chunk);
+	}
 }
-void Parser::stageTrack(std::vector<std::pair<uint64_t, std::unique_ptr<Message>>>& messages)
+
+std::optional<TrackEvent> TrackCursor::next()
 {
 	// 参考資料 : 
 	//   https://www.cs.cmu.edu/~music/cmsip/readings/Standard-MIDI-file-format-updated.pdf
 
+	if(mReader.empty()) return {};
+
 	auto require = [](const auto& optional_value) {
 		if(!optional_value.has_value()) {
 			throw decoding_exception("invalid track chunk");
 		}
 		return optional_value.value();
 	};
-	auto expect = [](auto value, auto expected) {
-		if(value != expected) {
-			throw decoding_exception("invalid track chunk");
-		}
+	auto data_byte = [&] {
+		auto b = require(mReader.read_byte());
+		if(b & 0x80) throw decoding_exception("invalid track chunk");
+		return b;
 	};
 
-	// チャンクタイプ
-	auto chunk_type = require(read_big<uint32_t>(s));
-	if(chunk_type != 0x4D54726b) throw decoding_exception("invalid track chunk");
+	TrackEvent ev;
 
-	// データ長
-	auto data_length = require(read_big<uint32_t>(s));
-	std::istream::pos_type next_chunk_pos = s.tellg();
-	next_chunk_pos += data_length;
+	// デルタタイム
+	mTick += require(mReader.read_variable());
+	ev.tick = mTick;
 
-	// データ
-	uint8_t prev_event_state = 0x00;
-	uint64_t tick_count = 0; // 現在時刻
-	while (true) {
-		// デルタタイム
-		auto delta = require(read_variable(s));
-		tick_count += delta;
-		
-		// イベント
-		auto event_state = require(read_byte(s)); // ステータスバイト
-		if ((event_state & 0x80) == 0) {
-			// ランニングステータス
-			event_state = prev_event_state;
-			s.seekg(-1, std::ios::cur);
-		}
-		switch ((event_state & 0xF0) >> 4) {
-		case 0x8: {	// ノートオフ
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t note = require(read_byte(s));
-			const uint8_t vel  = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::NoteOff>(ch, note, vel));
-		}	break;
-		case 0x9: {	// ノートオン
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t note = require(read_byte(s));
-			const uint8_t vel  = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::NoteOn>(ch, note, vel));
-		}	break;
-		case 0xA: {	// ポリフォニックキープレッシャー (アフタータッチ)
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t note = require(read_byte(s));
-			const uint8_t value  = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::PolyphonicKeyPressure>(ch, note, value));
-		}	break;
-		case 0xB: {	// コントロールチェンジ
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t ctrl = require(read_byte(s));
-			const uint8_t value  = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::ControlChange>(ch, ctrl, value));
-		}	break;
-		case 0xC: {	// プログラムチェンジ
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t prog = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::ProgramChange>(ch, prog));
-		}	break;
-		case 0xD: {	// チャネルプレッシャー (アフタータッチ)
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t value = require(read_byte(s));
-			messages.emplace_back(tick_count, std::make_unique<messages::ChannelPressure>(ch, value));
+	// ステータスバイト
+	uint8_t status = require(mReader.peek());
+	if (status & 0x80) {
+		mReader.read_byte();
+	} else {
+		// ランニングステータス : 先行するチャネルメッセージのステータスを引き継ぐ (データバイトは読み進めない)
+		if(mRunningStatus == 0x00) throw decoding_exception("invalid track chunk : unexpected data byte");
+		status = mRunningStatus;
+	}
+	ev.status = status;
+
+	switch ((status & 0xF0) >> 4) {
+	case 0x8:	// ノートオフ
+	case 0x9:	// ノートオン
+	case 0xA:	// ポリフォニックキープレッシャー (アフタータッチ)
+	case 0xB:	// コントロールチェンジ
+	case 0xE:	// ピッチベンド
+		ev.data[0] = data_byte();
+		ev.data[1] = data_byte();
+		mRunningStatus = status;
+		break;
+	case 0xC:	// プログラムチェンジ
+	case 0xD:	// チャネルプレッシャー (アフタータッチ)
+		ev.data[0] = data_byte();
+		mRunningStatus = status;
+		break;
+	case 0xF:
+		// システムメッセージはランニングステータスを解除する
+		mRunningStatus = 0x00;
+		switch (status & 0x0F) {
+		case 0x0:	// システムエクスクルーシブ (F0 <len> <data...> 形式, data末尾はF7)
+		case 0x7: {	// システムエクスクルーシブ	(F7 <len> <data...> 形式)
+			auto len = require(mReader.read_variable());
+			ev.payload = require(mReader.read_span(len));
 		}	break;
-		case 0xE: {	// ピッチベンド
-			const uint8_t ch = event_state & 0x0F;
-			const uint8_t lsb = require(read_byte(s)); // 7bit
-			const uint8_t msb = require(read_byte(s)); // 7bit
-			const int16_t pitch = ((uint16_t(lsb)&0x7F) | ((uint16_t(msb)&0x7F) << 7)) - 8192; // 0x0000 => -8192
-			messages.emplace_back(tick_count, std::make_unique<messages::PitchBend>(ch, pitch));
-		}	break;
-		case 0xF: {
-			switch (event_state & 0x0F) {
-			case 0x0:	// システムエクスクルーシブ (F0 <len> <data...> 形式, data末尾はF7)
-			case 0x7:{	// システムエクスクルーシブ	(F7 <len> <data...> 形式)
-				auto sysex_event_len = require(read_variable(s));
-				std::vector<uint8_t> sysex_event_data;
-				for(uint32_t i=0; i< sysex_event_len; ++i) {
-					auto b = require(read_byte(s));
-					sysex_event_data.push_back(b);
-				}
-				messages.emplace_back(tick_count, std::make_unique<messages::SysExMessage>(std::move(sysex_event_data)));
-			}	break;
-			case 0x2: {	// ソングポジション
-				const uint8_t lsb = require(read_byte(s)); // 7bit
-				const uint8_t msb = require(read_byte(s)); // 7bit
-				const int16_t pos = ((uint16_t(lsb)&0x7F) | ((uint16_t(msb)&0x7F) << 7));
-				messages.emplace_back(tick_count, std::make_unique<messages::SongPosition>(pos));
-			}	break;
-			case 0x3: {	// ソングセレクト
-				const uint8_t song = require(read_byte(s)); 
-				messages.emplace_back(tick_count, std::make_unique<messages::SongSelect>(song));
-			}	break;
-			case 0x1: // 未定義(MIDIタイムコードクォーターフレーム)
-			case 0x4: // 未定義
-			case 0x5: // 未定義
-			case 0x9: // 未定義
-			case 0xD: // 未定義
-				throw decoding_exception("invalid track chunk");
-				break;
-			case 0x6: {	// チューンリクエスト
-				messages.emplace_back(tick_count, std::make_unique<messages::TuneRequest>());
-			}	break;
-			case 0x8: {	// タイミングクロック
-				messages.emplace_back(tick_count, std::make_unique<messages::TimingClock>());
-			}	break;
-			case 0xA: {	// スタート
-				messages.emplace_back(tick_count, std::make_unique<messages::Start>());
-			}	break;
-			case 0xB: {	// コンティニュー
-				messages.emplace_back(tick_count, std::make_unique<messages::Continue>());
-			}	break;
-			case 0xC: {	// ストップ
-				messages.emplace_back(tick_count, std::make_unique<messages::Stop>());
-			}	break;
-			case 0xE: {	// アクティブセンシング
-				messages.emplace_back(tick_count, std::make_unique<messages::ActiveSensing>());
-			}	break;
-			case 0xF: {	// メタイベント
-				auto meta_event_type = require(read_variable(s));
-				auto meta_event_len = require(read_variable(s));
-				switch (meta_event_type) {
-				case 0x51:{ // Set Tempo (03 tt tt tt)
-					expect(meta_event_len, 3);
-					auto microseconds_per_quarter_note = std::chrono::microseconds(require(read_big<uint32_t>(s, 3)));
-					messages.emplace_back(tick_count, std::make_unique<messages::SetTempo>(microseconds_per_quarter_note));
-				}	break;
-				default: {
-					for(uint32_t i=0; i< meta_event_len; ++i) {
-						require(read_byte(s)); // skip
-					}
-					messages.emplace_back(tick_count, std::make_unique<messages::GeneralMetaEvent>(meta_event_type));
-				}	break;
-				}
-				
-			}	break;
-			default:
-				throw decoding_exception("invalid track chunk");
-			}
+		case 0x2:	// ソングポジション
+			ev.data[0] = data_byte();
+			ev.data[1] = data_byte();
+			break;
+		case 0x3:	// ソングセレクト
+			ev.data[0] = data_byte();
+			break;
+		case 0x6:	// チューンリクエスト
+		case 0x8:	// タイミングクロック
+		case 0xA:	// スタート
+		case 0xB:	// コンティニュー
+		case 0xC:	// ストップ
+		case 0xE:	// アクティブセンシング
+			break;
+		case 0xF: {	// メタイベント
+			ev.metaType = data_byte();
+			auto len = require(mReader.read_variable());
+			ev.payload = require(mReader.read_span(len));
+			if(ev.metaType == 0x51 && len != 3) throw decoding_exception("invalid track chunk"); // Set Tempo (03 tt tt tt)
 		}	break;
+		case 0x1: // 未定義(MIDIタイムコードクォーターフレーム)
+		case 0x4: // 未定義
+		case 0x5: // 未定義
+		case 0x9: // 未定義
+		case 0xD: // 未定義
 		default:
 			throw decoding_exception("invalid track chunk");
 		}
+		break;
+	default:
+		throw decoding_exception("invalid track chunk");
+	}
+	return ev;
+}
 
-		// ---
-		auto pos = s.tellg();
-		if(pos == next_chunk_pos) break;
-		if(pos > next_chunk_pos) throw decoding_exception("invalid track chunk");
-		prev_event_state = event_state;
+MergedCursor::MergedCursor(const Parser& parser)
+	: mTicksPerQuarterNote(parser.header().ticksPerQuarterNote)
+{
+	const size_t track_num = parser.header().trackNum;
+	mCursors.reserve(track_num);
+	mHeap.reserve(track_num);
+	for (size_t i = 0; i < track_num; ++i) {
+		auto& cursor = mCursors.emplace_back(parser.cursor(i));
+		if (auto ev = cursor.next()) {
+			mHeap.push_back({*ev, i});
+		}
 	}
+	std::make_heap(mHeap.begin(), mHeap.end(), &MergedCursor::later);
+}
 
-	// ---
+std::optional<TimedEvent> MergedCursor::next()
+{
+	if (mHeap.empty()) return {};
+
+	// (tick, トラック番号) が最小のイベントを取り出し、同じトラックの次のイベントを補充する
+	std::pop_heap(mHeap.begin(), mHeap.end(), &MergedCursor::later);
+	auto [event, track] = mHeap.back();
+	if (auto ev = mCursors[track].next()) {
+		mHeap.back().event = *ev;
+		std::push_heap(mHeap.begin(), mHeap.end(), &MergedCursor::later);
+	} else {
+		mHeap.pop_back();
+	}
 
-	// 次のヘッダの先頭に戻っておく
-	s.seekg(next_chunk_pos);
+	// 実時間に変換
+	mPos += mTimePerTick * (event.tick - mPrevTick);
+	mPrevTick = event.tick;
+	if (event.isTempo()) {
+		mTimePerTick = event.tempo() / mTicksPerQuarterNote;
+	}
+	return TimedEvent{ mPos, track, event };
+}
+
+std::chrono::microseconds TrackEvent::tempo()const noexcept
+{
+	lsp_require(isTempo());
+	return std::chrono::microseconds(
+		(uint32_t(payload[0]) << 16) | (uint32_t(payload[1]) << 8) | uint32_t(payload[2])
+	);
+}
 
-	// --- 
-}
\ No newline at end of file
+std::unique_ptr<midi::Message> TrackEvent::toMessage()const
+{
+	const uint8_t ch = status & 0x0F;
+	switch ((status & 0xF0) >> 4) {
+	case 0x8:	// ノートオフ
+		return std::make_unique<messages::NoteOff>(ch, data[0], data[1]);
+	case 0x9:	// ノートオン
+		return std::make_unique<messages::NoteOn>(ch, data[0], data[1]);
+	case 0xA:	// ポリフォニックキープレッシャー (アフタータッチ)
+		return std::make_unique<messages::PolyphonicKeyPressure>(ch, data[0], data[1]);
+	case 0xB:	// コントロールチェンジ
+		return std::make_unique<messages::ControlChange>(ch, data[0], data[1]);
+	case 0xC:	// プログラムチェンジ
+		return std::make_unique<messages::ProgramChange>(ch, data[0]);
+	case 0xD:	// チャネルプレッシャー (アフタータッチ)
+		return std::make_unique<messages::ChannelPressure>(ch, data[0]);
+	case 0xE: {	// ピッチベンド
+		const int16_t pitch = (uint16_t(data[0]) | (uint16_t(data[1]) << 7)) - 8192; // 0x0000 => -8192
+		return std::make_unique<messages::PitchBend>(ch, pitch);
+	}
+	case 0xF:
+		switch (status & 0x0F) {
+		case 0x0:	// システムエクスクルーシブ
+		case 0x7: {
+			std::vector<uint8_t> sysex_event_data(payload.size());
+			std::ranges::transform(payload, sysex_event_data.begin(), [](std::byte b) { return static_cast<uint8_t>(b); });
+			return std::make_unique<messages::SysExMessage>(std::move(sysex_event_data));
+		}
+		case 0x2: {	// ソングポジション
+			const int16_t pos = (uint16_t(data[0]) | (uint16_t(data[1]) << 7));
+			return std::make_unique<messages::SongPosition>(pos);
+		}
+		case 0x3:	// ソングセレクト
+			return std::make_unique<messages::SongSelect>(data[0]);
+		case 0x6:	// チューンリクエスト
+			return std::make_unique<messages::TuneRequest>();
+		case 0x8:	// タイミングクロック
+			return std::make_unique<messages::TimingClock>();
+		case 0xA:	// スタート
+			return std::make_unique<messages::Start>();
+		case 0xB:	// コンティニュー
+			return std::make_unique<messages::Continue>();
+		case 0xC:	// ストップ
+			return std::make_unique<messages::Stop>();
+		case 0xE:	// アクティブセンシング
+			return std::make_unique<messages::ActiveSensing>();
+		case 0xF:	// メタイベント
+			if (isTempo()) {
+				return std::make_unique<messages::SetTempo>(tempo());
+			}
+			return std::make_unique<messages::GeneralMetaEvent>(metaType);
+		default:
+			break;
+		}
+		break;
+	default:
+		break;
+	}
+	throw decoding_exception("invalid track event");
+}
@@ -33,22 +33,203 @@ class decoding_exception
 	using runtime_error::runtime_error;
 };
 
+// 境界チェック付き バイト列リーダ
+// 入力領域を指すポインタを進めながら読み出します。領域を超える読み出しは失敗(無効値)となり、ポインタは進みません。
+class ByteReader final
+{
+public:
+	constexpr ByteReader() noexcept = default;
+	constexpr explicit ByteReader(std::span<const std::byte> data) noexcept
+		: mPos(data.data()), mEnd(data.data() + data.size()) {}
+
+	// 残りのバイト数を取得します
+	constexpr size_t remaining()const noexcept { return static_cast<size_t>(mEnd - mPos); }
+
+	// 全て読み終えたか否かを取得します
+	constexpr bool empty()const noexcept { return mPos == mEnd; }
+
+	// 次の1バイトを読み進めずに取得します
+	constexpr std::optional<uint8_t> peek()const noexcept
+	{
+		if(mPos == mEnd) return {};
+		return static_cast<uint8_t>(*mPos);
+	}
+
+	// 1バイトを読み出します
+	constexpr std::optional<uint8_t> read_byte()noexcept
+	{
+		if(mPos == mEnd) return {};
+		return static_cast<uint8_t>(*mPos++);
+	}
+
+	// ビッグエンディアンの値を読み出します
+	template<std::integral T>
+	constexpr std::optional<T> read_big(size_t bytes = sizeof(T))noexcept
+	{
+		if(bytes > sizeof(T) || remaining() < bytes) return {};
+		std::make_unsigned_t<T> ret = 0;
+		for(size_t i = 0; i < bytes; ++i) {
+			ret = static_cast<std::make_unsigned_t<T>>((ret << 8) | static_cast<uint8_t>(mPos[i]));
+		}
+		mPos += bytes;
+		return static_cast<T>(ret);
+	}
+
+	// 可変長数値を読み出します (最大4バイト)
+	constexpr std::optional<uint32_t> read_variable()noexcept
+	{
+		uint32_t ret = 0;
+		for(size_t i = 0; i < 4 && i < remaining(); ++i) {
+			const auto b = static_cast<uint8_t>(mPos[i]);
+			// 数値として使う値は7bit単位で格納されている
+			ret = (ret << 7) | (b & 0x7F);
+			// 最上位桁が0ならば、この桁で終わり
+			if((b & 0x80) == 0) {
+				mPos += i + 1;
+				return ret;
+			}
+		}
+		return {};
+	}
+
+	// 指定バイト数の領域を切り出して読み進めます (コピーは行いません)
+	constexpr std::optional<std::span<const std::byte>> read_span(size_t bytes)noexcept
+	{
+		if(remaining() < bytes) return {};
+		std::span<const std::byte> ret(mPos, bytes);
+		mPos += bytes;
+		return ret;
+	}
+
+private:
+	const std::byte* mPos = nullptr;
+	const std::byte* mEnd = nullptr;
+};
+
+// トラック内の1イベント (未デコード)
+// SysEx および メタイベント のデータは入力領域を直接参照するため、入力領域より長く保持してはなりません。
+struct TrackEvent
+{
+	// トラック先頭からの時刻(tick)
+	uint64_t tick = 0;
+
+	// ステータスバイト (ランニングステータスは解決済み)
+	uint8_t status = 0;
+
+	// メタイベント種別 (status == 0xFF の場合のみ有効)
+	uint8_t metaType = 0;
+
+	// チャネルメッセージ/システムコモンメッセージのデータバイト
+	std::array<uint8_t, 2> data = {};
+
+	// SysEx/メタイベントのデータ
+	std::span<const std::byte> payload;
+
+	// メタイベントか否かを取得します
+	bool isMeta()const noexcept { return status == 0xFF; }
+
+	// テンポ設定(Set Tempo)メタイベントか否かを取得します
+	bool isTempo()const noexcept { return isMeta() && metaType == 0x51 && payload.size() == 3; }
+
+	// テンポ設定メタイベントの 4分音符あたりの時間を取得します
+	std::chrono::microseconds tempo()const noexcept;
+
+	// MIDIメッセージへ変換します
+	std::unique_ptr<Message> toMessage()const; // throws decoding_exception
+};
+
+// トラックチャンク カーソル
+// トラックチャンクのデータ領域を参照し、next() が呼ばれる毎に1イベントずつ解析します。
+class TrackCursor final
+{
+public:
+	TrackCursor() noexcept = default;
+	explicit TrackCursor(std::span<const std::byte> chunkData) noexcept : mReader(chunkData) {}
+
+	// 次のイベントを取得します。トラック末尾に達した場合は無効値を返します
+	std::optional<TrackEvent> next(); // throws decoding_exception
+
+	// トラック末尾に達したか否かを取得します
+	bool empty()const noexcept { return mReader.empty(); }
+
+private:
+	ByteReader mReader;
+	uint64_t mTick = 0;
+	uint8_t mRunningStatus = 0x00;
+};
+
 
 // SMFファイル パーサ
+// 入力はメモリ上のバイト列(ファイルの場合はメモリマップした領域)を直接参照し、コピーを伴わずに解析します。
+// 構築時にはヘッダとチャンク境界のみを解析し、トラックチャンクの内容は cursor() で得られるカーソルにより遅延解析されます。
 class Parser
 	: non_copy_move
 {
 public:
 	static std::pair<Header, Body> parse(const std::filesystem::path& path); // throws decoding_exception
+	static std::pair<Header, Body> parse(std::span<const std::byte> data); // throws decoding_exception
+
+	explicit Parser(std::span<const std::byte> data); // throws decoding_exception
+
+	// ヘッダを取得します
+	const Header& header()const noexcept { return mHeader; }
+
+	// トラックチャンクのデータ領域を取得します
+	std::span<const std::byte> track(size_t index)const { return mTracks.at(index); }
+
+	// トラックチャンクを解析するカーソルを取得します
+	TrackCursor cursor(size_t index)const { return TrackCursor(track(index)); }
 
-protected:
-	Parser(std::istream& s) : s(s) {}
+private:
+	Header mHeader;
+	std::vector<std::span<const std::byte>> mTracks;
+};
+
+// 実時間が確定したイベント
+struct TimedEvent
+{
+	// 曲先頭からの時間
+	std::chrono::microseconds time;
+
+	// トラック番号
+	size_t track;
+
+	// イベント
+	TrackEvent event;
+};
+
+// 全トラックを時系列順に走査するカーソル
+// 各トラックのカーソルを (tick, トラック番号) 順のヒープで管理し、k-wayマージによりイベントを1つずつ取り出します。
+// 同一tickのイベントはトラック番号順、同一トラック内では出現順に得られます。
+// また、テンポ設定メタイベントを処理しながら各イベントの実時間を求めます。
+class MergedCursor final
+{
+public:
+	explicit MergedCursor(const Parser& parser); // throws decoding_exception
 
-	void stageHeader(Header& header);
-	void stageTrack(std::vector<std::pair<uint64_t, std::unique_ptr<Message>>>& messages);
+	// 次のイベントを取得します。全トラックの末尾に達した場合は無効値を返します
+	std::optional<TimedEvent> next(); // throws decoding_exception
 
 private:
-	std::istream& s;
+	struct Entry
+	{
+		TrackEvent event;
+		size_t track;
+	};
+	// ヒープの比較関数 : (tick, トラック番号) が最小の要素を先頭にする
+	static bool later(const Entry& lhs, const Entry& rhs)noexcept
+	{
+		if(lhs.event.tick != rhs.event.tick) return lhs.event.tick > rhs.event.tick;
+		return lhs.track > rhs.track;
+	}
+
+	std::vector<TrackCursor> mCursors;
+	std::vector<Entry> mHeap;
+	uint16_t mTicksPerQuarterNote;
+
+	uint64_t mPrevTick = 0;
+	std::chrono::microseconds mPos{0}; // 曲先頭からの相対時間
+	std::chrono::microseconds mTimePerTick{0}; // 1tickあたりの時間
 };
 
-}
\ No newline at end of file
+}
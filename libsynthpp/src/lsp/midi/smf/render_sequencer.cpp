@@ -0,0 +1,224 @@
+﻿#include <lsp/midi/smf/render_sequencer.hpp>
+
+using namespace lsp;
+using namespace lsp::midi::smf;
+
+namespace
+{
+// 時間 → フレーム位置 (切り捨て)
+uint64_t to_frames(std::chrono::microseconds time, uint32_t sampleFreq)
+{
+	return static_cast<uint64_t>(time.count()) * sampleFreq / 1000000ull;
+}
+}
+
+void RenderSequencer::load(Body&& body)
+{
+	load(Sequence::create(std::move(body)));
+}
+void RenderSequencer::load(std::shared_ptr<const Sequence> sequence)
+{
+	// 旧シーケンスの解放は advance() を待たせないよう、ロック外で行う
+	std::shared_ptr<const Sequence> retired;
+	Garbage garbage;
+	{
+		std::lock_guard lock(mMutex);
+		garbage = collectGarbage();
+		retired = std::exchange(mSequence, std::move(sequence));
+		if (mDelivering && retired.get() == mDeliveringSequence) {
+			// 配送中のシーケンスは配送後に回収する
+			std::swap(retired, mRetiredSequence);
+		}
+		mPlaying = false;
+		++mSerial;
+		mNextIndex = 0;
+		mPendingPosition.reset();
+		mFramePosition = 0;
+		mPosition.store(0, std::memory_order_relaxed);
+	}
+}
+void RenderSequencer::start()
+{
+	startAt(0, std::chrono::microseconds(0));
+}
+void RenderSequencer::seek(std::chrono::microseconds position)
+{
+	std::shared_ptr<const Sequence> sequence;
+	SystemType systemType;
+	{
+		std::lock_guard lock(mMutex);
+		sequence = mSequence;
+		systemType = mSystemType;
+	}
+	if (!sequence) return; // 未ロード
+	position = std::max(position, std::chrono::microseconds(0));
+
+	// 状態の追跡はレンダリングスレッドを止めないよう、ロック外で行う
+	const auto index = sequence->indexOf(position);
+	auto batch = std::make_unique<ImmediateBatch>();
+	batch->messages = sequence->chase(index).toMessages(systemType);
+
+	Garbage garbage;
+	std::lock_guard lock(mMutex);
+	if (mSequence != sequence) return; // 追跡中に別のシーケンスがロードされた
+	garbage = collectGarbage();
+	pushImmediate(std::move(batch));
+	mPlaying = true;
+	++mSerial;
+	mNextIndex = index;
+	mPendingPosition = position;
+	mPosition.store(position.count(), std::memory_order_relaxed);
+}
+void RenderSequencer::startAt(size_t index, std::chrono::microseconds position)
+{
+	Garbage garbage;
+	std::lock_guard lock(mMutex);
+	if (!mSequence) return; // 未ロード
+	garbage = collectGarbage();
+	mPlaying = true;
+	++mSerial;
+	mNextIndex = index;
+	mPendingPosition = position;
+	mPosition.store(position.count(), std::memory_order_relaxed);
+}
+void RenderSequencer::stop()
+{
+	Garbage garbage;
+	std::lock_guard lock(mMutex);
+	garbage = collectGarbage();
+	mPlaying = false;
+	++mSerial;
+}
+bool RenderSequencer::isPlaying()const
+{
+	std::lock_guard lock(mMutex);
+	return mPlaying;
+}
+std::chrono::microseconds RenderSequencer::position()const
+{
+	return std::chrono::microseconds(mPosition.load(std::memory_order_relaxed));
+}
+void RenderSequencer::reset(SystemType type)
+{
+	auto batch = std::make_unique<ImmediateBatch>();
+	if (auto msg = ChaseState::makeSystemReset(type)) {
+		batch->messages.push_back(std::move(msg));
+	}
+
+	Garbage garbage;
+	std::lock_guard lock(mMutex);
+	garbage = collectGarbage();
+	mSystemType = type;
+	if (!batch->messages.empty()) {
+		pushImmediate(std::move(batch));
+	}
+}
+void RenderSequencer::pushImmediate(std::unique_ptr<ImmediateBatch> batch)
+{
+	// mMutex を保持した状態で呼び出すこと
+	// 末尾への連結のみを行うため、配送中のバッチは変更されない
+	auto added = batch.get();
+	if (mImmediateTail) {
+		mImmediateTail->next = std::move(batch);
+	} else {
+		mImmediateHead = std::move(batch);
+	}
+	mImmediateTail = added;
+	if (!mImmediateNext) mImmediateNext = added;
+}
+RenderSequencer::Garbage RenderSequencer::collectGarbage()
+{
+	// mMutex を保持した状態で呼び出すこと
+	Garbage garbage;
+
+	// 配送済み かつ 配送中でないバッチを先頭から切り離す
+	while (mImmediateHead && mImmediateHead.get() != mImmediateNext && mImmediateHead.get() != mDeliveringBatch) {
+		auto batch = std::exchange(mImmediateHead, std::move(mImmediateHead->next));
+		batch->next = std::move(garbage.batches);
+		garbage.batches = std::move(batch);
+	}
+	if (!mImmediateHead) mImmediateTail = nullptr;
+
+	if (!mDelivering) {
+		garbage.sequence = std::move(mRetiredSequence);
+	}
+	return garbage;
+}
+
+void RenderSequencer::advance(uint32_t sampleFreq, size_t frames, Receiver& receiver)
+{
+	// 共有状態の複製 : 配送はロック外で行う
+	const ImmediateBatch* firstBatch;
+	const ImmediateBatch* lastBatch;
+	const Sequence* sequence;
+	uint64_t serial;
+	size_t index;
+	uint64_t position;
+	{
+		std::lock_guard lock(mMutex);
+		firstBatch = std::exchange(mImmediateNext, nullptr);
+		lastBatch = firstBatch ? mImmediateTail : nullptr;
+		sequence = mPlaying ? mSequence.get() : nullptr;
+		serial = mSerial;
+		index = mNextIndex;
+
+		// 再生位置の反映 : 位置は時間で保持し、サンプリング周波数の変更にも追従する
+		if (mPendingPosition) {
+			position = to_frames(*mPendingPosition, sampleFreq);
+		} else if (mSampleFreq != sampleFreq && mSampleFreq != 0) {
+			position = mFramePosition * sampleFreq / mSampleFreq;
+		} else {
+			position = mFramePosition;
+		}
+
+		mDelivering = true;
+		mDeliveringSequence = sequence;
+		mDeliveringBatch = firstBatch;
+	}
+
+	// 即時配送するメッセージ : 解放は呼び出し元スレッドに任せる (collectGarbage)
+	for (auto batch = firstBatch; batch; batch = batch->next.get()) {
+		for (const auto& msg : batch->messages) {
+			receiver.onMessage(0, msg);
+		}
+		if (batch == lastBatch) break; // 以降は配送開始後に連結されたもの
+	}
+
+	// 区間 [position, end) に含まれるメッセージを配送する
+	const uint64_t end = position + frames;
+	if (sequence) {
+		const auto& body = sequence->body();
+		const auto packets = sequence->packets();
+		while (index < body.size()) {
+			const auto& [time, msg] = body[index];
+			const auto frame = to_frames(time, sampleFreq);
+			if (frame >= end) break;
+			// 既に過ぎた位置のメッセージ(シーク直後等)はブロック先頭で配送する
+			const auto offset = frame > position ? static_cast<size_t>(frame - position) : 0;
+			if (const auto& packet = packets[index]; !packet.empty()) {
+				receiver.onPacket(offset, packet);
+			} else {
+				receiver.onMessage(offset, msg);
+			}
+			++index;
+		}
+	}
+
+	// 再生状態の書き戻し : 配送中に再生状態が変更された場合は変更後の状態を優先する
+	std::lock_guard lock(mMutex);
+	mDelivering = false;
+	mDeliveringSequence = nullptr;
+	mDeliveringBatch = nullptr;
+	if (!sequence || serial != mSerial) return;
+
+	mNextIndex = index;
+	mPendingPosition.reset();
+	mFramePosition = end;
+	mSampleFreq = sampleFreq;
+	mPosition.store(static_cast<int64_t>(end * 1000000ull / sampleFreq), std::memory_order_relaxed);
+
+	// 全て配送し終えた場合、停止
+	if (mNextIndex >= sequence->body().size()) {
+		mPlaying = false;
+	}
+}
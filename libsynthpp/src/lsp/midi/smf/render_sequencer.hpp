@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/system_type.hpp>
+#include <lsp/midi/message_source.hpp>
+#include <lsp/midi/smf/sequence.hpp>
+
+namespace lsp::midi::smf
+{
+// SMFファイル シーケンサ (レンダリングスレッド駆動)
+// 独自のスレッドを持たず、シンセサイザのレンダリングループから MessageSource として呼び出されます。
+// 各メッセージはレンダリング済みフレーム数を基準にサンプル単位の位置で配送されます。
+class RenderSequencer final
+	: public MessageSource
+{
+public:
+	RenderSequencer() = default;
+
+	// SMFを開きます
+	void load(Body&& body);
+
+	// シーケンスを開きます (シーケンスは複製されず、他のシーケンサと共有されます)
+	void load(std::shared_ptr<const Sequence> sequence);
+
+	// 先頭から再生を開始/再開します
+	void start();
+
+	// 指定位置へ移動し、その位置から再生を開始します
+	// その位置までのメッセージによるチャネル状態(プログラム, コントロールチェンジ, RPN/NRPN等)を再現してから再生します
+	void seek(std::chrono::microseconds position);
+
+	// 再生を停止します
+	void stop();
+
+	// 再生中か否かを取得します
+	bool isPlaying()const;
+
+	// 再生位置を取得します
+	std::chrono::microseconds position()const;
+
+	// システムリセットを送信します
+	void reset(SystemType type);
+
+	// MessageSource : 再生位置を進め、区間内のメッセージを配送します
+	void advance(uint32_t sampleFreq, size_t frames, Receiver& receiver)override;
+
+private:
+	// 次のブロックの先頭で配送するメッセージ (システムリセット, 状態の追跡結果)
+	// 呼び出し元スレッドでロック外に作成して連結し、配送中は変更されない
+	struct ImmediateBatch
+	{
+		std::vector<std::shared_ptr<const Message>> messages;
+		std::unique_ptr<ImmediateBatch> next;
+	};
+	// 呼び出し元スレッドでロック外に解放するもの
+	struct Garbage
+	{
+		std::unique_ptr<ImmediateBatch> batches;
+		std::shared_ptr<const Sequence> sequence;
+	};
+
+	void startAt(size_t index, std::chrono::microseconds position);
+	void pushImmediate(std::unique_ptr<ImmediateBatch> batch);
+	[[nodiscard]] Garbage collectGarbage();
+
+private:
+	// MEMO advance() は mMutex を配送前後の状態の受け渡しの間のみ保持し、受け取り先への配送(チャネルのレンダリング)はロック外で行う
+	//      配送中のシーケンス/メッセージはレンダリングスレッド上で解放しないよう、呼び出し元スレッドが配送後に回収する
+	mutable std::mutex mMutex;
+	std::shared_ptr<const Sequence> mSequence;
+	std::shared_ptr<const Sequence> mRetiredSequence; // 配送中に差し替えたシーケンス
+	SystemType mSystemType = SystemType::GM1(); // 直近に reset() で指定されたシステム種別
+
+	std::unique_ptr<ImmediateBatch> mImmediateHead; // 配送済みのものを含む
+	ImmediateBatch* mImmediateTail = nullptr;
+	ImmediateBatch* mImmediateNext = nullptr; // 次に配送するもの (nullptr : 無し)
+
+	// 配送中の状態
+	bool mDelivering = false;
+	const Sequence* mDeliveringSequence = nullptr;
+	const ImmediateBatch* mDeliveringBatch = nullptr;
+
+	bool mPlaying = false;
+	uint64_t mSerial = 0; // 再生状態の変更回数 : 配送中に変更された場合、advance() は再生位置を書き戻さない
+	size_t mNextIndex = 0; // 次に配送するメッセージ
+	std::optional<std::chrono::microseconds> mPendingPosition; // 次のブロックで反映する再生位置
+	uint64_t mFramePosition = 0; // 再生位置 (フレーム数)
+	uint32_t mSampleFreq = 0; // 直近のブロックのサンプリング周波数
+	std::atomic<int64_t> mPosition = 0; // 再生位置 (マイクロ秒, position() 用)
+};
+
+}
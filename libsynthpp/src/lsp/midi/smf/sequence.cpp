@@ -0,0 +1,46 @@
+﻿#include <lsp/midi/smf/sequence.hpp>
+
+using namespace lsp;
+using namespace lsp::midi::smf;
+
+Sequence::Sequence(Body&& body)
+	: mBody(std::move(body))
+{
+	// パケットへの変換
+	mPackets.reserve(mBody.size());
+	for (auto& [time, msg] : mBody) {
+		mPackets.push_back(Ump::from(*msg).value_or(Ump()));
+	}
+
+	// チェックポイントの作成
+	ChaseState state;
+	mCheckpoints.reserve(mBody.size() / CHECKPOINT_INTERVAL + 1);
+	for (size_t i = 0; i < mBody.size(); ++i) {
+		if (i % CHECKPOINT_INTERVAL == 0) {
+			mCheckpoints.push_back(state);
+		}
+		state.apply(mBody[i].second);
+	}
+	if (mCheckpoints.empty()) {
+		mCheckpoints.push_back(state);
+	}
+}
+
+size_t Sequence::indexOf(std::chrono::microseconds position)const noexcept
+{
+	auto iter = std::ranges::lower_bound(mBody, position, {}, [](const auto& e) { return e.first; });
+	return static_cast<size_t>(std::distance(mBody.begin(), iter));
+}
+
+ChaseState Sequence::chase(size_t index)const
+{
+	lsp_require(index <= mBody.size());
+
+	// 直近のチェックポイントから指定位置までを追跡する
+	const size_t checkpoint = std::min(index / CHECKPOINT_INTERVAL, mCheckpoints.size() - 1);
+	auto state = mCheckpoints[checkpoint];
+	for (size_t i = checkpoint * CHECKPOINT_INTERVAL; i < index; ++i) {
+		state.apply(mBody[i].second);
+	}
+	return state;
+}
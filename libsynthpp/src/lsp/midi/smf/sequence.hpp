@@ -0,0 +1,50 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/smf/parser.hpp>
+#include <lsp/midi/smf/chase_state.hpp>
+#include <lsp/midi/ump.hpp>
+
+namespace lsp::midi::smf
+{
+
+// シーケンス (不変)
+// 実時間順のメッセージ列と、途中位置から再生するためのチェックポイントを保持します。
+// チャネルボイスメッセージは構築時に Universal MIDI Packet へ変換され、再生時はパケットとして配送できます。
+// 構築後は変更されないため、std::shared_ptr<const Sequence> として複数のシーケンサから同時に再生できます。
+class Sequence final
+	: non_copy_move
+{
+public:
+	// チェックポイントの間隔(メッセージ数)
+	static constexpr size_t CHECKPOINT_INTERVAL = 1024;
+
+	explicit Sequence(Body&& body);
+
+	// シーケンスを作成します
+	static std::shared_ptr<const Sequence> create(Body&& body) { return std::make_shared<const Sequence>(std::move(body)); }
+
+	// メッセージ列を取得します (時系列順)
+	const Body& body()const noexcept { return mBody; }
+
+	// 各メッセージに対応するパケットを取得します (body() と同じ添字, パケットへ変換できないメッセージは空のパケット)
+	std::span<const Ump> packets()const noexcept { return mPackets; }
+
+	// 演奏時間 (最後のメッセージの時間) を取得します
+	std::chrono::microseconds duration()const noexcept { return mBody.empty() ? std::chrono::microseconds(0) : mBody.back().first; }
+
+	// 指定位置以降の最初のメッセージの添字を取得します
+	size_t indexOf(std::chrono::microseconds position)const noexcept;
+
+	// 先頭 index 個のメッセージを適用した追跡状態を取得します
+	ChaseState chase(size_t index)const;
+
+private:
+	const Body mBody;
+	std::vector<Ump> mPackets;
+
+	// チェックポイント : mCheckpoints[k] は 先頭 k * CHECKPOINT_INTERVAL 個のメッセージを適用した状態
+	std::vector<ChaseState> mCheckpoints;
+};
+
+}
@@ -4,6 +4,7 @@
 #include <lsp/midi/system_type.hpp>
 #include <lsp/midi/message_receiver.hpp>
 #include <lsp/midi/smf/parser.hpp>
+#include <lsp/midi/smf/sequence.hpp>
 
 
 namespace lsp::midi::smf
@@ -19,26 +20,39 @@ public:
 	// SMFを開きます
 	void load(Body&& body);
 
+	// シーケンスを開きます (シーケンスは複製されず、他のシーケンサと共有されます)
+	void load(std::shared_ptr<const Sequence> sequence);
+
 	// 先頭から再生を開始/再開します
 	void start();
 
+	// 指定位置へ移動し、その位置から再生を開始します
+	// その位置までのメッセージによるチャネル状態(プログラム, コントロールチェンジ, RPN/NRPN等)を再現してから再生します
+	void seek(std::chrono::microseconds position);
+
 	// 再生を停止します
 	void stop();
 
 	// 再生中か否かを取得します
 	bool isPlaying()const;
 
+	// 再生位置を取得します (停止中は0)
+	std::chrono::microseconds position()const;
+
 	// システムリセットを送信します
 	void reset(SystemType type);
 
 private:
-	void playThreadMain(const Body& messages);
+	void startAt(size_t index, std::chrono::microseconds position);
+	void playThreadMain(const Sequence& sequence, size_t index, clock::time_point startTime);
 
 private:
 	MessageReceiver& mReceiver;
 	std::thread mPlayThread;
 	std::atomic_bool mPlayThreadAbortFlag;
-	Body mSmfBody;
+	std::shared_ptr<const Sequence> mSequence;
+	clock::time_point mStartTime; // 曲先頭に相当する時刻
+	SystemType mSystemType = SystemType::GM1(); // 直近に reset() で指定されたシステム種別
 
 };
 
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/system_type.hpp>
+
+namespace lsp::midi
+{
+
+// SysEx パターン
+// バイト毎の 値/マスク の組で表されるパターンで、constexpr で定義でき、照合時にメモリ確保を行いません。
+// パターンの各要素は以下のいずれかで指定します :
+//   - 0x00 ~ 0xFF    : 完全一致
+//   - SysExPattern::ANY : 任意の値
+//   - SysExPattern::upper(v) : 上位4bitのみ一致
+class SysExPattern
+{
+public:
+	static constexpr size_t MAX_LENGTH = 16;
+
+	// 任意の値
+	static constexpr uint16_t ANY = 0xFF00;
+
+	// 上位4bitのみ一致
+	static constexpr uint16_t upper(uint8_t value)noexcept { return 0x0F00 | (value & 0xF0); }
+
+	constexpr SysExPattern(std::initializer_list<uint16_t> pattern)
+	{
+		lsp_require(pattern.size() <= MAX_LENGTH);
+		for (auto v : pattern) {
+			// 上位8bit : マスクの反転 (0x00 = 完全一致)
+			mMask[mLength] = static_cast<uint8_t>(~(v >> 8));
+			mValue[mLength] = static_cast<uint8_t>(v & mMask[mLength]);
+			++mLength;
+		}
+	}
+
+	// パターンの長さを取得します
+	constexpr size_t length()const noexcept { return mLength; }
+
+	// 先頭の値を取得します (メーカーIDの照合に用いる)
+	constexpr uint8_t front()const noexcept { return mValue[0]; }
+
+	// データの先頭がパターンと一致するか否かを取得します
+	constexpr bool match(std::span<const uint8_t> data)const noexcept
+	{
+		if (data.size() < mLength) return false;
+		for (size_t i = 0; i < mLength; ++i) {
+			if ((data[i] & mMask[i]) != mValue[i]) return false;
+		}
+		return true;
+	}
+
+private:
+	std::array<uint8_t, MAX_LENGTH> mValue = {};
+	std::array<uint8_t, MAX_LENGTH> mMask = {};
+	size_t mLength = 0;
+};
+
+// システムリセットとして扱う SysEx と、リセット後のシステム種別
+// MEMO シンセサイザ(Synthesizer::sysExMessage)とシーク時の状態追跡(ChaseState)で共用する
+struct SystemResetPattern
+{
+	SysExPattern pattern;
+	SystemType type;
+};
+inline constexpr SystemResetPattern SYSTEM_RESET_PATTERNS[] = {
+	// --- 非リアルタイム ユニバーサルシステムエクスクルーシブ ---
+	{ { 0x7E, 0x7F, 0x09, 0x01 }, SystemType::GM1() }, // GM1 System On
+	{ { 0x7E, 0x7F, 0x09, 0x03 }, SystemType::GM2() }, // GM2 System On
+	{ { 0x7E, 0x7F, 0x09, 0x02 }, SystemType::GS() },  // GM System Off → GS Reset
+	// --- Roland ---
+	{ { 0x41, SysExPattern::ANY, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41 }, SystemType::GS() },             // GS Reset
+	{ { 0x41, SysExPattern::ANY, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x00, 0x01 }, SystemType::SystemModeSet1() }, // System Mode Set 1 // ※32パートで1音源
+	{ { 0x41, SysExPattern::ANY, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x01, 0x00 }, SystemType::SystemModeSet2() }, // System Mode Set 2 // ※16パートを2音源扱いにする
+	// --- YAMAHA ---
+	{ { 0x43, SysExPattern::ANY, 0x4C, 0x00, 0x00, 0x7E, 0x00 }, SystemType::XG() }, // XG Reset
+};
+
+// SysEx (F0, F7を除く) がシステムリセットであれば、リセット後のシステム種別を取得します
+constexpr std::optional<SystemType> findSystemReset(std::span<const uint8_t> data)noexcept
+{
+	if (data.empty()) return std::nullopt;
+	for (const auto& reset : SYSTEM_RESET_PATTERNS) {
+		if (reset.pattern.front() != data.front()) continue;
+		if (reset.pattern.match(data)) return reset.type;
+	}
+	return std::nullopt;
+}
+
+}
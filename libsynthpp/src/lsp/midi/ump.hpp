@@ -0,0 +1,286 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message.hpp>
+#include <lsp/midi/messages/basic_message.hpp>
+
+namespace lsp::midi
+{
+
+// Universal MIDI Packet (MIDI 2.0)
+// 32/64bit 固定長のワード列で表されるMIDIメッセージです。 トリビアルにコピー可能であり、メモリ確保や仮想呼び出しを伴わずに受け渡しできます。
+// 本実装では 64bit までのパケット(チャネルボイスメッセージ)のみを扱います。 SysEx 等は従来通り midi::Message で扱います。
+//   参考 : Universal MIDI Packet (UMP) Format and MIDI 2.0 Protocol (M2-104-UM)
+class Ump final
+{
+public:
+	// メッセージタイプ (word0 の上位4bit)
+	enum class MessageType : uint8_t
+	{
+		Utility = 0x0,				// 32bit : ユーティリティ (NOOP 等)
+		System = 0x1,				// 32bit : システムコモン/リアルタイム
+		Midi1ChannelVoice = 0x2,	// 32bit : MIDI 1.0 チャネルボイス
+		Data64 = 0x3,				// 64bit : SysEx(7bit)
+		Midi2ChannelVoice = 0x4,	// 64bit : MIDI 2.0 チャネルボイス
+	};
+	// MIDI 2.0 チャネルボイスメッセージのステータス (オペコード)
+	enum class Status : uint8_t
+	{
+		RegisteredPerNoteController = 0x0,
+		AssignablePerNoteController = 0x1,
+		RegisteredController = 0x2,		// RPN
+		AssignableController = 0x3,		// NRPN
+		RelativeRegisteredController = 0x4,
+		RelativeAssignableController = 0x5,
+		PerNotePitchBend = 0x6,
+		NoteOff = 0x8,
+		NoteOn = 0x9,
+		PolyPressure = 0xA,
+		ControlChange = 0xB,
+		ProgramChange = 0xC,
+		ChannelPressure = 0xD,
+		PitchBend = 0xE,
+		PerNoteManagement = 0xF,
+	};
+
+	// ノートオン/オフの属性種別
+	static constexpr uint8_t ATTRIBUTE_NONE = 0x00;
+	static constexpr uint8_t ATTRIBUTE_PITCH_7_9 = 0x03; // 属性値 : ノート番号(7bit) + 小数部(9bit)
+
+	// パーノートマネジメントのフラグ
+	static constexpr uint8_t PER_NOTE_RESET = 0x01;		// S : パーノートコントローラを初期値に戻す
+	static constexpr uint8_t PER_NOTE_DETACH = 0x02;	// D : 発音中のノートからパーノートコントローラを切り離す
+
+	// 32bit値の中央値 (ピッチベンド等)
+	static constexpr uint32_t CENTER_32 = 0x80000000u;
+
+public:
+	// NOOP パケット
+	constexpr Ump()noexcept = default;
+	constexpr explicit Ump(uint32_t word0, uint32_t word1 = 0)noexcept
+		: mWords{ word0, word1 }
+	{}
+
+	constexpr uint32_t word(size_t index)const noexcept { return mWords[index]; }
+
+	// ワード数を取得します
+	constexpr size_t size()const noexcept
+	{
+		switch(messageType()) {
+		case MessageType::Data64:
+		case MessageType::Midi2ChannelVoice:
+			return 2;
+		default:
+			return 1;
+		}
+	}
+	// NOOP (空のパケット) か否かを取得します
+	constexpr bool empty()const noexcept { return mWords[0] == 0 && mWords[1] == 0; }
+
+	constexpr MessageType messageType()const noexcept { return static_cast<MessageType>(mWords[0] >> 28); }
+	constexpr uint8_t group()const noexcept { return static_cast<uint8_t>((mWords[0] >> 24) & 0x0F); }
+	constexpr Status status()const noexcept { return static_cast<Status>((mWords[0] >> 20) & 0x0F); }
+	constexpr uint8_t channel()const noexcept { return static_cast<uint8_t>((mWords[0] >> 16) & 0x0F); }
+
+	// --- MIDI 2.0 チャネルボイス ---
+	// ノート番号 (ノート系), コントロール番号 (CC), バンク (RPN/NRPN)
+	constexpr uint8_t note()const noexcept { return static_cast<uint8_t>((mWords[0] >> 8) & 0x7F); }
+	constexpr uint8_t index()const noexcept { return static_cast<uint8_t>((mWords[0] >> 8) & 0x7F); }
+	constexpr uint8_t bank()const noexcept { return static_cast<uint8_t>((mWords[0] >> 8) & 0x7F); }
+	// 属性種別 (ノートオン/オフ), インデックス (RPN/NRPN, パーノートコントローラ), フラグ (プログラムチェンジ, パーノートマネジメント)
+	constexpr uint8_t attributeType()const noexcept { return static_cast<uint8_t>(mWords[0] & 0xFF); }
+	constexpr uint8_t subIndex()const noexcept { return static_cast<uint8_t>(mWords[0] & 0xFF); }
+	constexpr uint8_t flags()const noexcept { return static_cast<uint8_t>(mWords[0] & 0xFF); }
+
+	// ベロシティ (16bit, ノートオン/オフ)
+	constexpr uint16_t velocity()const noexcept { return static_cast<uint16_t>(mWords[1] >> 16); }
+	// 属性値 (16bit, ノートオン/オフ)
+	constexpr uint16_t attributeData()const noexcept { return static_cast<uint16_t>(mWords[1] & 0xFFFF); }
+	// 値 (32bit, CC/ピッチベンド/プレッシャー/RPN/NRPN 等)
+	constexpr uint32_t data()const noexcept { return mWords[1]; }
+
+	// プログラムチェンジ
+	constexpr uint8_t program()const noexcept { return static_cast<uint8_t>((mWords[1] >> 24) & 0x7F); }
+	constexpr bool bankValid()const noexcept { return (mWords[0] & 0x01) != 0; }
+	constexpr uint8_t bankMSB()const noexcept { return static_cast<uint8_t>((mWords[1] >> 8) & 0x7F); }
+	constexpr uint8_t bankLSB()const noexcept { return static_cast<uint8_t>(mWords[1] & 0x7F); }
+
+	// --- MIDI 1.0 チャネルボイス (32bit) ---
+	constexpr uint8_t midi1Status()const noexcept { return static_cast<uint8_t>((mWords[0] >> 16) & 0xFF); }
+	constexpr uint8_t midi1Data1()const noexcept { return static_cast<uint8_t>((mWords[0] >> 8) & 0x7F); }
+	constexpr uint8_t midi1Data2()const noexcept { return static_cast<uint8_t>(mWords[0] & 0x7F); }
+
+public:
+	// MIDI 2.0 チャネルボイスメッセージを作成します
+	static constexpr Ump midi2(Status status, uint8_t ch, uint8_t byte2, uint8_t byte3, uint32_t data, uint8_t group = 0)noexcept
+	{
+		return Ump(
+			(static_cast<uint32_t>(MessageType::Midi2ChannelVoice) << 28)
+			| (static_cast<uint32_t>(group & 0x0F) << 24)
+			| (static_cast<uint32_t>(status) << 20)
+			| (static_cast<uint32_t>(ch & 0x0F) << 16)
+			| (static_cast<uint32_t>(byte2) << 8)
+			| byte3,
+			data);
+	}
+	// MIDI 1.0 チャネルボイスメッセージを作成します
+	static constexpr Ump midi1(uint8_t status, uint8_t data1, uint8_t data2, uint8_t group = 0)noexcept
+	{
+		return Ump(
+			(static_cast<uint32_t>(MessageType::Midi1ChannelVoice) << 28)
+			| (static_cast<uint32_t>(group & 0x0F) << 24)
+			| (static_cast<uint32_t>(status) << 16)
+			| (static_cast<uint32_t>(data1 & 0x7F) << 8)
+			| (data2 & 0x7F));
+	}
+
+	static constexpr Ump noteOn(uint8_t ch, uint8_t noteNo, uint16_t velocity, uint8_t attributeType = ATTRIBUTE_NONE, uint16_t attributeData = 0)noexcept
+	{
+		return midi2(Status::NoteOn, ch, noteNo & 0x7F, attributeType, (static_cast<uint32_t>(velocity) << 16) | attributeData);
+	}
+	static constexpr Ump noteOff(uint8_t ch, uint8_t noteNo, uint16_t velocity, uint8_t attributeType = ATTRIBUTE_NONE, uint16_t attributeData = 0)noexcept
+	{
+		return midi2(Status::NoteOff, ch, noteNo & 0x7F, attributeType, (static_cast<uint32_t>(velocity) << 16) | attributeData);
+	}
+	static constexpr Ump polyPressure(uint8_t ch, uint8_t noteNo, uint32_t value)noexcept
+	{
+		return midi2(Status::PolyPressure, ch, noteNo & 0x7F, 0, value);
+	}
+	static constexpr Ump controlChange(uint8_t ch, uint8_t ctrlNo, uint32_t value)noexcept
+	{
+		return midi2(Status::ControlChange, ch, ctrlNo & 0x7F, 0, value);
+	}
+	static constexpr Ump programChange(uint8_t ch, uint8_t progNo, std::optional<std::pair<uint8_t, uint8_t>> bank = std::nullopt)noexcept
+	{
+		uint32_t data = static_cast<uint32_t>(progNo & 0x7F) << 24;
+		if(bank) data |= (static_cast<uint32_t>(bank->first & 0x7F) << 8) | (bank->second & 0x7F);
+		return midi2(Status::ProgramChange, ch, 0, bank ? 0x01 : 0x00, data);
+	}
+	static constexpr Ump channelPressure(uint8_t ch, uint32_t value)noexcept
+	{
+		return midi2(Status::ChannelPressure, ch, 0, 0, value);
+	}
+	static constexpr Ump pitchBend(uint8_t ch, uint32_t value)noexcept
+	{
+		return midi2(Status::PitchBend, ch, 0, 0, value);
+	}
+	static constexpr Ump perNotePitchBend(uint8_t ch, uint8_t noteNo, uint32_t value)noexcept
+	{
+		return midi2(Status::PerNotePitchBend, ch, noteNo & 0x7F, 0, value);
+	}
+	static constexpr Ump registeredController(uint8_t ch, uint8_t bank, uint8_t index, uint32_t value)noexcept
+	{
+		return midi2(Status::RegisteredController, ch, bank & 0x7F, index & 0x7F, value);
+	}
+	static constexpr Ump assignableController(uint8_t ch, uint8_t bank, uint8_t index, uint32_t value)noexcept
+	{
+		return midi2(Status::AssignableController, ch, bank & 0x7F, index & 0x7F, value);
+	}
+	static constexpr Ump perNoteManagement(uint8_t ch, uint8_t noteNo, uint8_t flags)noexcept
+	{
+		return midi2(Status::PerNoteManagement, ch, noteNo & 0x7F, flags, 0);
+	}
+
+	// --- 値の解像度変換 ---
+	// 低解像度の値を高解像度へ拡大します (Min-Center-Max 方式 : 最小/中央/最大値が保存される)
+	static constexpr uint32_t scaleUp(uint32_t value, uint8_t srcBits, uint8_t dstBits)noexcept
+	{
+		const uint8_t scaleBits = dstBits - srcBits;
+		uint32_t shifted = value << scaleBits;
+		const uint32_t center = 1u << (srcBits - 1);
+		if(value <= center) return shifted;
+
+		// 中央値より上 : 下位bitを繰り返して最大値が全bit 1 となるようにする
+		const uint8_t repeatBits = srcBits - 1;
+		const uint32_t repeatMask = (1u << repeatBits) - 1;
+		uint32_t repeat = value & repeatMask;
+		if(scaleBits > repeatBits) {
+			repeat <<= scaleBits - repeatBits;
+		} else {
+			repeat >>= repeatBits - scaleBits;
+		}
+		while(repeat != 0) {
+			shifted |= repeat;
+			repeat >>= repeatBits;
+		}
+		return shifted;
+	}
+	// 高解像度の値を低解像度へ縮小します
+	static constexpr uint32_t scaleDown(uint32_t value, uint8_t srcBits, uint8_t dstBits)noexcept
+	{
+		return value >> (srcBits - dstBits);
+	}
+
+	// --- MIDI 1.0 → MIDI 2.0 変換 ---
+	// MIDI 1.0 チャネルボイスメッセージを MIDI 2.0 チャネルボイスメッセージへ変換します
+	// ※ バンクセレクト, RPN/NRPN はコントロールチェンジのまま変換します (ステートレスな変換)
+	static constexpr std::optional<Ump> upConvert(uint8_t status, uint8_t data1, uint8_t data2, uint8_t group = 0)noexcept
+	{
+		const uint8_t ch = status & 0x0F;
+		data1 &= 0x7F;
+		data2 &= 0x7F;
+		switch(status & 0xF0) {
+		case 0x80:
+			return noteOff(ch, data1, static_cast<uint16_t>(scaleUp(data2, 7, 16))).withGroup(group);
+		case 0x90:
+			if(data2 == 0) {
+				// ベロシティ0のノートオン : ノートオフ (MIDI 1.0 のノートオフ既定ベロシティ 64 相当)
+				return noteOff(ch, data1, static_cast<uint16_t>(scaleUp(64, 7, 16))).withGroup(group);
+			}
+			return noteOn(ch, data1, static_cast<uint16_t>(scaleUp(data2, 7, 16))).withGroup(group);
+		case 0xA0:
+			return polyPressure(ch, data1, scaleUp(data2, 7, 32)).withGroup(group);
+		case 0xB0:
+			return controlChange(ch, data1, scaleUp(data2, 7, 32)).withGroup(group);
+		case 0xC0:
+			return programChange(ch, data1).withGroup(group);
+		case 0xD0:
+			return channelPressure(ch, scaleUp(data1, 7, 32)).withGroup(group);
+		case 0xE0:
+			return pitchBend(ch, scaleUp(static_cast<uint32_t>(data1) | (static_cast<uint32_t>(data2) << 7), 14, 32)).withGroup(group);
+		default:
+			return std::nullopt;
+		}
+	}
+	// MIDI 1.0 チャネルボイスメッセージのパケットを MIDI 2.0 へ変換します
+	constexpr std::optional<Ump> upConvert()const noexcept
+	{
+		if(messageType() != MessageType::Midi1ChannelVoice) return std::nullopt;
+		return upConvert(midi1Status(), midi1Data1(), midi1Data2(), group());
+	}
+	// MIDIメッセージを MIDI 2.0 チャネルボイスメッセージへ変換します (変換できない場合は std::nullopt)
+	static std::optional<Ump> from(const Message& msg)noexcept
+	{
+		using namespace messages;
+		if(auto noteOn = dynamic_cast<const NoteOn*>(&msg)) {
+			return upConvert(0x90 | noteOn->channel(), noteOn->noteNo(), noteOn->velocity());
+		} else if(auto noteOff = dynamic_cast<const NoteOff*>(&msg)) {
+			return upConvert(0x80 | noteOff->channel(), noteOff->noteNo(), 64);
+		} else if(auto programChange = dynamic_cast<const ProgramChange*>(&msg)) {
+			return upConvert(0xC0 | programChange->channel(), programChange->progId(), 0);
+		} else if(auto controlChange = dynamic_cast<const ControlChange*>(&msg)) {
+			return upConvert(0xB0 | controlChange->channel(), controlChange->ctrlNo(), controlChange->value());
+		} else if(auto pitchBend = dynamic_cast<const PitchBend*>(&msg)) {
+			const auto value = static_cast<uint16_t>(pitchBend->pitch() + 8192);
+			return upConvert(0xE0 | pitchBend->channel(), value & 0x7F, (value >> 7) & 0x7F);
+		} else if(auto polyPressure = dynamic_cast<const PolyphonicKeyPressure*>(&msg)) {
+			return upConvert(0xA0 | polyPressure->channel(), polyPressure->noteNo(), polyPressure->value());
+		} else if(auto chanPressure = dynamic_cast<const ChannelPressure*>(&msg)) {
+			return upConvert(0xD0 | chanPressure->channel(), chanPressure->value(), 0);
+		}
+		return std::nullopt;
+	}
+
+	// グループを変更したパケットを取得します
+	constexpr Ump withGroup(uint8_t group)const noexcept
+	{
+		return Ump((mWords[0] & 0xF0FFFFFFu) | (static_cast<uint32_t>(group & 0x0F) << 24), mWords[1]);
+	}
+
+	constexpr bool operator==(const Ump&)const noexcept = default;
+
+private:
+	std::array<uint32_t, 2> mWords = {};
+};
+
+}
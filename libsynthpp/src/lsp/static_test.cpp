@@ -1,7 +1,16 @@
 ﻿#include <lsp/core/core.hpp>
 #include <lsp/dsp/biquadratic_filter.hpp>
 #include <lsp/dsp/envelope_generator.hpp>
+#include <lsp/dsp/noise_generator.hpp>
+#include <lsp/dsp/function_generator.hpp>
+#include <lsp/dsp/resampler.hpp>
+#include <lsp/dsp/compressor.hpp>
+#include <lsp/dsp/limiter.hpp>
+#include <lsp/dsp/reverb.hpp>
+#include <lsp/dsp/chorus.hpp>
+#include <lsp/dsp/convolver.hpp>
 #include <lsp/midi/message.hpp>
+#include <lsp/midi/ump.hpp>
 #include <lsp/midi/smf/parser.hpp>
 #include <lsp/midi/smf/sequencer.hpp>
 #include <lsp/audio/wav_file_output.hpp>
@@ -54,6 +63,90 @@ static_assert(requantize<double>(static_cast<int8_t>(-0x7F)) == -1.0,  "Filter::
 static_assert(requantize<int8_t>(+1.0) == +0x7F,  "Filter::Requantizer failed");
 static_assert(requantize<int8_t>(-1.0) == -0x7F,  "Filter::Requantizer failed");
 
+// ############################################################################
+// ### Filter/NoiseGenerator
+// PCG32 リファレンス実装(pcg32-demo : seed=42, seq=54)と同一の系列であること
+static_assert([] { dsp::Pcg32 rng(42u, 54u); return rng.next(); }() == 0xa15c02b7u, "dsp::Pcg32 failed");
+static_assert([] { dsp::Pcg32 rng(42u, 54u); rng.next(); return rng.next(); }() == 0x7b47f409u, "dsp::Pcg32 failed");
+namespace 
+{
+[[maybe_unused]]
+void unused_function_f_ng() {
+	dsp::NoiseGenerator<float> ng_float(0, dsp::NoiseColor::Pink);
+	dsp::NoiseGenerator<double> ng_double(0, dsp::NoiseColor::Brown);
+	std::array<float, 16> buf;
+	ng_float.generate(buf);
+	ng_double.update();
+	dsp::FunctionGenerator<float> fg;
+	fg.setBrownNoise();
+	fg.generate(buf);
+}
+}
+
+// ############################################################################
+// ### Filter/Resampler
+namespace 
+{
+[[maybe_unused]]
+void unused_function_f_rs() {
+	dsp::Resampler<float> rs_float(44100, 48000, 2, dsp::ResamplerQuality::High);
+	dsp::Resampler<double> rs_double(48000, 44100, 1, dsp::ResamplerQuality::Low);
+	auto out = rs_float.process(Signal<float>::allocate(2, 441));
+	std::array<double, 64> in{}, buf{};
+	rs_double.process(in.data(), in.size(), buf.data(), buf.size());
+}
+}
+
+// ############################################################################
+// ### Filter/Compressor, Filter/LookaheadLimiter
+namespace 
+{
+[[maybe_unused]]
+void unused_function_f_dyn() {
+	std::array<float, 64> buf{};
+	dsp::Compressor<float> comp;
+	comp.setParam(44100, 2, -12, 2, 6, 0.01f, 0.1f, 0.01f);
+	comp.process(buf.data(), buf.size() / 2);
+	dsp::LookaheadLimiter<float> lim;
+	lim.setParam(44100, 2, 1, 0.001f, 0.05f);
+	lim.process(buf.data(), buf.size() / 2);
+}
+}
+
+// ############################################################################
+// ### Filter/FdnReverb, Filter/Chorus
+namespace 
+{
+[[maybe_unused]]
+void unused_function_f_fx() {
+	std::array<float, 64> buf{};
+	dsp::FdnReverb<float> rev;
+	rev.setParam(44100, 2.0f, 0.3f, 0.02f);
+	rev.process(buf.data(), buf.data(), buf.size() / 2);
+	dsp::Chorus<double> cho;
+	cho.setParam(44100, 0.01, 0.002, 0.5, 0.1);
+	std::array<double, 64> dbuf{};
+	cho.process(dbuf.data(), dbuf.data(), dbuf.size() / 2);
+}
+}
+
+// ############################################################################
+// ### Filter/PartitionedConvolver
+namespace 
+{
+[[maybe_unused]]
+void unused_function_f_conv() {
+	std::array<float, 64> buf{};
+	auto ir = Signal<float>::allocate(2, 44100);
+	dsp::PartitionedConvolver<float> conv(ir, 64, 1024);
+	conv.process(buf.data(), buf.data(), buf.size() / 2);
+	dsp::fft::FftPlan<double> plan(1024);
+	std::array<double, 1024> re{}, im{};
+	plan.forward(re.data(), im.data());
+	plan.inverse(re.data(), im.data());
+}
+}
+
 // ############################################################################
 // ### Filter/EnvelopeGenerator
 namespace 
@@ -96,4 +189,18 @@ void unused_function_a_wfo() {
 	out.write(Signal<float>());
 	out.write(Signal<double>());
 }
-}
\ No newline at end of file
+}
+
+// ############################################################################
+// ### MIDI/Ump
+static_assert(sizeof(midi::Ump) == 8 && std::is_trivially_copyable_v<midi::Ump>, "midi::Ump failed");
+static_assert(midi::Ump::scaleUp(0, 7, 32) == 0x00000000u, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::scaleUp(64, 7, 32) == 0x80000000u, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::scaleUp(127, 7, 32) == 0xFFFFFFFFu, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::scaleUp(127, 7, 16) == 0xFFFFu, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::scaleUp(8192, 14, 32) == 0x80000000u, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::scaleUp(16383, 14, 32) == 0xFFFFFFFFu, "midi::Ump::scaleUp failed");
+static_assert(midi::Ump::upConvert(0x93, 60, 127) == midi::Ump::noteOn(3, 60, 0xFFFF), "midi::Ump::upConvert failed");
+static_assert(midi::Ump::upConvert(0x93, 60, 0)->status() == midi::Ump::Status::NoteOff, "midi::Ump::upConvert failed");
+static_assert(midi::Ump::upConvert(0xE0, 0x00, 0x40) == midi::Ump::pitchBend(0, midi::Ump::CENTER_32), "midi::Ump::upConvert failed");
+static_assert(midi::Ump::midi1(0xB5, 7, 100).upConvert()->channel() == 5, "midi::Ump::upConvert failed");
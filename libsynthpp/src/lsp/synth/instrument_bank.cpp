@@ -0,0 +1,227 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#include <lsp/synth/instrument_bank.hpp>
+#include <lsp/util/checksum.hpp>
+#include <lsp/util/mapped_file.hpp>
+
+#include <cstring>
+#include <fstream>
+
+using namespace lsp;
+using namespace lsp::synth;
+
+// TODO リトルエンディアンでの実行前提
+static_assert(std::endian::native == std::endian::little);
+
+namespace
+{
+
+constexpr size_t align8(size_t n) noexcept { return (n + 7) & ~size_t(7); }
+
+}
+
+void InstrumentBank::compile(const InstrumentTable& table, const std::filesystem::path& path)
+{
+	if (table.soundFont()) {
+		Log::w("InstrumentBank : SoundFont is not stored in the compiled bank; pass it to load() again ({})", path.string());
+	}
+
+	// 出力内容を実行環境に依らず一定とするため、variant および 番号順に整列する
+	auto variantOrder = [](const InstrumentVariantKey& key) {
+		return std::make_tuple(static_cast<uint8_t>(key.systemType), key.bankMSB, key.bankLSB);
+	};
+	std::vector<std::tuple<InstrumentVariantKey, int32_t, const MelodyParam*>> melodyParams;
+	std::vector<std::tuple<InstrumentVariantKey, int32_t, const DrumParam*>> drumParams;
+	table.forEachMelodyParam([&](const InstrumentVariantKey& variant, int32_t progId, const MelodyParam& param) {
+		melodyParams.emplace_back(variant, progId, &param);
+	});
+	table.forEachDrumParam([&](const InstrumentVariantKey& variant, int32_t noteNo, const DrumParam& param) {
+		drumParams.emplace_back(variant, noteNo, &param);
+	});
+	auto paramOrder = [&](const auto& a, const auto& b) {
+		return std::make_tuple(variantOrder(std::get<0>(a)), std::get<1>(a)) < std::make_tuple(variantOrder(std::get<0>(b)), std::get<1>(b));
+	};
+	std::ranges::sort(melodyParams, paramOrder);
+	std::ranges::sort(drumParams, paramOrder);
+
+	std::vector<Variant> variants;
+	std::vector<Melody> melodies;
+	std::vector<Drum> drums;
+	std::vector<std::byte> captions;
+
+	auto addCaption = [&](const std::string& caption) -> Caption {
+		if (captions.size() + caption.size() > std::numeric_limits<uint32_t>::max()) {
+			throw bank_format_exception("too large caption area");
+		}
+		Caption ret = { static_cast<uint32_t>(captions.size()), static_cast<uint32_t>(caption.size()) };
+		const auto bytes = std::as_bytes(std::span(caption));
+		captions.insert(captions.end(), bytes.begin(), bytes.end());
+		return ret;
+	};
+	// レコードを追加し、variant が切り替わる毎に索引を追加する
+	auto addVariant = [&](const InstrumentVariantKey& key, VariantKind kind, size_t index) {
+		if (!variants.empty() && variants.back().kind == kind
+			&& variants.back().systemType == static_cast<uint8_t>(key.systemType)
+			&& variants.back().bankMSB == key.bankMSB && variants.back().bankLSB == key.bankLSB) {
+			++variants.back().count;
+			return;
+		}
+		variants.push_back({ static_cast<uint8_t>(key.systemType), key.bankMSB, key.bankLSB, kind, 0, static_cast<uint32_t>(index), 1 });
+	};
+
+	for (auto& [variant, progId, param] : melodyParams) {
+		addVariant(variant, VariantKind::Melody, melodies.size());
+		melodies.push_back({
+			progId,
+			param->volume, param->attack, param->hold, param->decay, param->sustain, param->fade, param->release, param->noteOffset,
+			static_cast<uint8_t>(param->waveForm), static_cast<uint8_t>(param->isDrumLike ? 1 : 0), 0,
+			addCaption(param->caption)
+		});
+	}
+	for (auto& [variant, noteNo, param] : drumParams) {
+		addVariant(variant, VariantKind::Drum, drums.size());
+		drums.push_back({
+			noteNo, param->pitch,
+			param->volume, param->attack, param->hold, param->decay, param->pan, 0,
+			addCaption(param->caption)
+		});
+	}
+
+	// ヘッダ以降の領域を構築
+	const auto variants_bytes = std::as_bytes(std::span(variants));
+	const auto melodies_bytes = std::as_bytes(std::span(melodies));
+	const auto drums_bytes = std::as_bytes(std::span(drums));
+	std::vector<std::byte> body;
+	body.reserve(variants_bytes.size() + melodies_bytes.size() + drums_bytes.size() + align8(captions.size()));
+	body.insert(body.end(), variants_bytes.begin(), variants_bytes.end());
+	body.insert(body.end(), melodies_bytes.begin(), melodies_bytes.end());
+	body.insert(body.end(), drums_bytes.begin(), drums_bytes.end());
+	body.insert(body.end(), captions.begin(), captions.end());
+	body.resize(align8(body.size()));
+
+	FileHeader fh = {};
+	fh.magic = MAGIC;
+	fh.version = VERSION;
+	fh.headerSize = sizeof(FileHeader);
+	fh.variantOffset = sizeof(FileHeader);
+	fh.variantCount = variants.size();
+	fh.melodyOffset = fh.variantOffset + variants_bytes.size();
+	fh.melodyCount = melodies.size();
+	fh.drumOffset = fh.melodyOffset + melodies_bytes.size();
+	fh.drumCount = drums.size();
+	fh.captionOffset = fh.drumOffset + drums_bytes.size();
+	fh.captionSize = captions.size();
+	fh.checksum = xxh64(body);
+
+	std::ofstream s;
+	s.exceptions(std::ios::failbit | std::ios::badbit);
+	s.open(path, std::ios::binary | std::ios::trunc);
+	s.write(reinterpret_cast<const char*>(&fh), sizeof(fh));
+	s.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+	s.close();
+}
+
+InstrumentTable InstrumentBank::load(const std::filesystem::path& path, std::shared_ptr<const SoundFont> soundFont)
+{
+	MappedFile file;
+	try {
+		file = MappedFile(path, MappedFile::AccessPattern::Sequential);
+	} catch (const std::system_error&) {
+		throw bank_format_exception("invalid input");
+	}
+	const auto data = file.data();
+
+	// ヘッダ
+	FileHeader fh;
+	if (data.size() < sizeof(fh)) throw bank_format_exception("invalid instrument bank : truncated");
+	std::memcpy(&fh, data.data(), sizeof(fh));
+	if (fh.magic != MAGIC) throw bank_format_exception("invalid instrument bank");
+	if (fh.version != VERSION) throw bank_format_exception("invalid instrument bank : unsupported version");
+	if (fh.headerSize != sizeof(FileHeader)) throw bank_format_exception("invalid instrument bank");
+
+	// 各ブロックの境界 : 乗算のオーバーフローを避けるため、要素数は残りの領域から求めた上限と比較する
+	auto block = [&](uint64_t offset, uint64_t count, size_t elem) {
+		if (offset % alignof(uint64_t) != 0 || offset > data.size() || count > (data.size() - offset) / elem) {
+			throw bank_format_exception("invalid instrument bank : broken layout");
+		}
+		return data.subspan(static_cast<size_t>(offset), static_cast<size_t>(count * elem));
+	};
+	const auto variantBlock = block(fh.variantOffset, fh.variantCount, sizeof(Variant));
+	const auto melodyBlock = block(fh.melodyOffset, fh.melodyCount, sizeof(Melody));
+	const auto drumBlock = block(fh.drumOffset, fh.drumCount, sizeof(Drum));
+	const auto captionBlock = block(fh.captionOffset, fh.captionSize, 1);
+
+	// チェックサム
+	if (xxh64(data.subspan(sizeof(FileHeader))) != fh.checksum) {
+		throw bank_format_exception("invalid instrument bank : checksum mismatch");
+	}
+
+	// マップ領域はページ境界に配置され、各ブロックは8バイト境界に配置されているため、直接参照できる
+	const std::span variants(reinterpret_cast<const Variant*>(variantBlock.data()), static_cast<size_t>(fh.variantCount));
+	const std::span melodies(reinterpret_cast<const Melody*>(melodyBlock.data()), static_cast<size_t>(fh.melodyCount));
+	const std::span drums(reinterpret_cast<const Drum*>(drumBlock.data()), static_cast<size_t>(fh.drumCount));
+
+	auto caption = [&](const Caption& c) {
+		if (c.offset > captionBlock.size() || c.length > captionBlock.size() - c.offset) {
+			throw bank_format_exception("invalid instrument bank : broken caption");
+		}
+		return std::string(reinterpret_cast<const char*>(captionBlock.data()) + c.offset, c.length);
+	};
+	auto records = [](const auto& all, const Variant& v) {
+		if (v.first > all.size() || v.count > all.size() - v.first) {
+			throw bank_format_exception("invalid instrument bank : broken index");
+		}
+		return all.subspan(v.first, v.count);
+	};
+
+	InstrumentTable table;
+	for (const auto& v : variants) {
+		if (v.systemType > static_cast<uint8_t>(InstrumentSystemType::XG)) {
+			throw bank_format_exception("invalid instrument bank : unknown system type");
+		}
+		const InstrumentVariantKey key = { static_cast<InstrumentSystemType>(v.systemType), v.bankMSB, v.bankLSB };
+		switch (v.kind) {
+		case VariantKind::Melody:
+			for (const auto& rec : records(melodies, v)) {
+				if (rec.waveForm > static_cast<uint8_t>(MelodyWaveForm::Noise)) {
+					throw bank_format_exception("invalid instrument bank : unknown wave form");
+				}
+				MelodyParam param;
+				param.caption    = caption(rec.caption);
+				param.volume     = rec.volume;
+				param.attack     = rec.attack;
+				param.hold       = rec.hold;
+				param.decay      = rec.decay;
+				param.sustain    = rec.sustain;
+				param.fade       = rec.fade;
+				param.release    = rec.release;
+				param.waveForm   = static_cast<MelodyWaveForm>(rec.waveForm);
+				param.isDrumLike = rec.isDrumLike != 0;
+				param.noteOffset = rec.noteOffset;
+				table.setMelodyParam(key, rec.progId, std::move(param));
+			}
+			break;
+		case VariantKind::Drum:
+			for (const auto& rec : records(drums, v)) {
+				DrumParam param;
+				param.caption = caption(rec.caption);
+				param.pitch   = rec.pitch;
+				param.volume  = rec.volume;
+				param.attack  = rec.attack;
+				param.hold    = rec.hold;
+				param.decay   = rec.decay;
+				param.pan     = rec.pan;
+				table.setDrumParam(key, rec.noteNo, std::move(param));
+			}
+			break;
+		default:
+			throw bank_format_exception("invalid instrument bank : unknown variant kind");
+		}
+	}
+	table.setSoundFont(std::move(soundFont));
+
+	// 以降は読み取り専用 : 検索用の索引を構築する
+	table.freeze();
+	return table;
+}
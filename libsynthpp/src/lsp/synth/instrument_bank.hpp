@@ -0,0 +1,127 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/synth/instrument_table.hpp>
+
+namespace lsp::synth
+{
+
+// インストゥルメントバンクの形式エラー
+class bank_format_exception
+	: public std::runtime_error
+{
+public:
+	using runtime_error::runtime_error;
+};
+
+// コンパイル済みインストゥルメントバンク
+// InstrumentTable を固定長レコードの平坦な形式で保存し、メモリマップにより読み込みます。
+// TOMLの解析を伴わないため、起動時の読み込みを高速に行えます。
+//
+// ファイル形式 (リトルエンディアン, 各ブロックは8バイト境界に配置) :
+//   FileHeader | Variant[variantCount] | Melody[melodyCount] | Drum[drumCount] | 音色名領域
+//   Variant   : InstrumentVariantKey 毎の索引. 対応する Melody/Drum レコードの範囲 [first, first + count) を指す
+//   音色名領域 : UTF-8文字列の連結 (終端文字なし)
+//   checksum  : FileHeader以降の全バイトに対する XXH64
+//
+// ※ load() はレコードを InstrumentTable へ展開した上で凍結します。
+//    MidiChannel は MelodyParam/DrumParam を直接参照するため、マップ領域を参照し続ける形式とはしていません。
+//    (展開と索引構築を含めても、数千レコードのバンクで1ms未満で読み込めるため)
+// ※ バンクに保存されるのは波形メモリ音源の音色パラメータのみです。
+//    InstrumentTable が保持する SoundFont は保存されないため、読み込み時に load() へ指定し直してください。
+class InstrumentBank final
+{
+public:
+	static constexpr uint32_t MAGIC = 0x42504C4C; // "LLPB"
+	static constexpr uint16_t VERSION = 3;
+
+	// インストゥルメント情報テーブルをコンパイルして保存します
+	// テーブルが SoundFont を保持している場合、SoundFont は保存されない旨を警告として記録します
+	static void compile(const InstrumentTable& table, const std::filesystem::path& path); // throws bank_format_exception, std::ios_base::failure
+
+	// コンパイル済みバンクを読み込みます (凍結済み)
+	// soundFont : サンプル再生に用いる SoundFont (省略時は波形メモリ音源のみ)
+	static InstrumentTable load(const std::filesystem::path& path, std::shared_ptr<const SoundFont> soundFont = nullptr); // throws bank_format_exception
+
+private:
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t headerSize;
+
+		uint64_t variantOffset;
+		uint64_t variantCount;
+		uint64_t melodyOffset;
+		uint64_t melodyCount;
+		uint64_t drumOffset;
+		uint64_t drumCount;
+		uint64_t captionOffset;
+		uint64_t captionSize;
+
+		uint64_t checksum;
+	};
+	static_assert(sizeof(FileHeader) == 80 && std::is_trivially_copyable_v<FileHeader>);
+
+	enum class VariantKind : uint8_t
+	{
+		Melody = 0,
+		Drum = 1,
+	};
+	struct Variant
+	{
+		uint8_t systemType; // InstrumentSystemType
+		uint8_t bankMSB;
+		uint8_t bankLSB;
+		VariantKind kind;
+		uint32_t reserved;
+
+		uint32_t first; // 対応するレコードの先頭位置
+		uint32_t count; // 対応するレコード数
+	};
+	static_assert(sizeof(Variant) == 16 && std::is_trivially_copyable_v<Variant>);
+
+	struct Caption
+	{
+		uint32_t offset; // 音色名領域内のオフセット
+		uint32_t length;
+	};
+
+	struct Melody
+	{
+		int32_t progId;
+		float volume;
+		float attack;
+		float hold;
+		float decay;
+		float sustain;
+		float fade;
+		float release;
+		float noteOffset;
+		uint8_t waveForm; // MelodyWaveForm
+		uint8_t isDrumLike;
+		uint16_t reserved;
+		Caption caption;
+	};
+	static_assert(sizeof(Melody) == 48 && std::is_trivially_copyable_v<Melody>);
+
+	struct Drum
+	{
+		int32_t noteNo;
+		int32_t pitch;
+		float volume;
+		float attack;
+		float hold;
+		float decay;
+		float pan;
+		uint32_t reserved;
+		Caption caption;
+	};
+	static_assert(sizeof(Drum) == 40 && std::is_trivially_copyable_v<Drum>);
+
+};
+
+}
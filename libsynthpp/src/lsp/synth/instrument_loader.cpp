@@ -1,7 +1,9 @@
-﻿#include <luath/io/instrument_loader.hpp>
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#include <lsp/synth/instrument_loader.hpp>
 #include <toml++/toml.hpp>
 
-using namespace luath;
 using namespace lsp::synth;
 
 // 文字列からMelodyWaveFormへ変換
@@ -52,21 +54,34 @@ static std::optional<int32_t> tryParseInt(std::string_view str)
 	}
 }
 
-InstrumentTable InstrumentLoader::loadFromDirectory(const std::filesystem::path& dir)
+InstrumentTable InstrumentLoader::loadFromDirectory(const std::filesystem::path& dir, std::optional<SoundFont::StreamingOptions> streaming)
 {
 	InstrumentTable table;
 
 	if(!std::filesystem::exists(dir) || !std::filesystem::is_directory(dir)) {
+		table.freeze();
 		return table;
 	}
 
 	// ディレクトリ内の全 .toml ファイルを読み込む
+	std::vector<std::filesystem::path> soundFonts;
 	for(auto& entry : std::filesystem::directory_iterator(dir)) {
 		if(!entry.is_regular_file()) continue;
+		if(entry.path().extension() == ".sf2") soundFonts.push_back(entry.path());
 		if(entry.path().extension() != ".toml") continue;
 		loadFile(table, entry.path());
 	}
 
+	// .sf2 ファイルがあればサンプル再生に用いる (複数ある場合はファイル名順で先頭のもの)
+	if(!soundFonts.empty()) {
+		std::ranges::sort(soundFonts);
+		table.setSoundFont(streaming
+			? std::make_shared<const SoundFont>(soundFonts.front(), *streaming)
+			: std::make_shared<const SoundFont>(soundFonts.front()));
+	}
+
+	// 以降は読み取り専用 : 検索用の索引を構築する
+	table.freeze();
 	return table;
 }
 
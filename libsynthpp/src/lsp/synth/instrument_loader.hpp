@@ -0,0 +1,30 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/synth/instrument_table.hpp>
+#include <lsp/synth/sound_font.hpp>
+#include <filesystem>
+
+#if LSP_WITH_TOML
+namespace lsp::synth
+{
+
+// TOMLファイルからインストゥルメント情報を読み込みます
+// ※ ビルドオプション LSP_WITH_TOML が有効な場合のみ宣言されます (tomlplusplus を使用)
+class InstrumentLoader final
+{
+public:
+	// 指定ディレクトリ内の全 .toml ファイルを読み込み InstrumentTable を構築します (凍結済み)
+	// 各ファイルにはオプションで system_type, bank_msb, bank_lsb を記述可能
+	// .sf2 ファイルがあれば SoundFont として読み込み、該当するプリセットのある音色はサンプルを再生します
+	// streaming を指定した場合、SoundFont はストリーミングモードで読み込みます
+	static InstrumentTable loadFromDirectory(const std::filesystem::path& dir, std::optional<SoundFont::StreamingOptions> streaming = std::nullopt);
+
+private:
+	static void loadFile(InstrumentTable& table, const std::filesystem::path& path);
+};
+
+}
+#endif
@@ -9,6 +9,8 @@
 namespace lsp::synth
 {
 
+class SoundFont;
+
 // メロディ用波形種別
 enum class MelodyWaveForm
 {
@@ -102,18 +104,44 @@ namespace lsp::synth
 {
 
 // インストゥルメント情報テーブル
+// 読み込み完了後に freeze() すると、以降の検索はフォールバック解決済みの固定長配列を参照します。
 class InstrumentTable final
 {
 public:
+	// 凍結後の索引が保持する番号の範囲 [0, FROZEN_ID_COUNT) : プログラム番号 / ドラムのノート番号
+	static constexpr int32_t FROZEN_ID_COUNT = 128;
+
 	InstrumentTable() = default;
+	InstrumentTable(InstrumentTable&&) noexcept = default;
+	InstrumentTable& operator=(InstrumentTable&&) noexcept = default;
+	// MEMO 凍結後の索引はパラメータへのポインタを保持するため、複製時は索引を再構築する
+	InstrumentTable(const InstrumentTable& d)
+		: mMelodyParams(d.mMelodyParams)
+		, mDrumParams(d.mDrumParams)
+		, mSoundFont(d.mSoundFont)
+	{
+		if(d.mFrozen) freeze();
+	}
+	InstrumentTable& operator=(const InstrumentTable& d)
+	{
+		if(this != &d) {
+			*this = InstrumentTable(d);
+		}
+		return *this;
+	}
 
 	// メロディパラメータの設定・取得
 	void setMelodyParam(const InstrumentVariantKey& variant, int32_t progId, MelodyParam param)
 	{
+		lsp_require(!mFrozen);
 		mMelodyParams[variant][progId] = std::move(param);
 	}
 	const MelodyParam* findMelodyParam(InstrumentSystemType systemType, uint8_t bankMSB, uint8_t bankLSB, int32_t progId) const
 	{
+		if(mFrozen && progId >= 0 && progId < FROZEN_ID_COUNT) {
+			return findFrozen(mFrozenMelodyParams, {systemType, bankMSB, bankLSB}).resolved[progId];
+		}
+
 		using ST = InstrumentSystemType;
 		// 1. 完全一致 (systemType + bank)
 		if(auto p = findMelodyExact({systemType, bankMSB, bankLSB}, progId)) return p;
@@ -135,10 +163,15 @@ public:
 	// ドラムパラメータの設定・取得
 	void setDrumParam(const InstrumentVariantKey& variant, int32_t noteNo, DrumParam param)
 	{
+		lsp_require(!mFrozen);
 		mDrumParams[variant][noteNo] = std::move(param);
 	}
 	const DrumParam* findDrumParam(InstrumentSystemType systemType, uint8_t bankMSB, uint8_t bankLSB, int32_t noteNo) const
 	{
+		if(mFrozen && noteNo >= 0 && noteNo < FROZEN_ID_COUNT) {
+			return findFrozen(mFrozenDrumParams, {systemType, bankMSB, bankLSB}).resolved[noteNo];
+		}
+
 		using ST = InstrumentSystemType;
 		// 1. 完全一致 (systemType + bank)
 		if(auto p = findDrumExact({systemType, bankMSB, bankLSB}, noteNo)) return p;
@@ -157,6 +190,63 @@ public:
 		return nullptr;
 	}
 
+	// サンプル再生に用いる SoundFont の設定・取得
+	// SoundFont に該当するプリセットがある音色は、メロディ/ドラムパラメータの波形に代えてサンプルを再生します。
+	void setSoundFont(std::shared_ptr<const SoundFont> soundFont)
+	{
+		lsp_require(!mFrozen);
+		mSoundFont = std::move(soundFont);
+	}
+	const std::shared_ptr<const SoundFont>& soundFont() const noexcept { return mSoundFont; }
+
+	// 以降の変更を禁止し、検索用の索引を構築します
+	// 全てのシステム種別 × 登録済みのバンクについて、番号毎のフォールバック結果を予め解決しておきます。
+	void freeze()
+	{
+		lsp_require(!mFrozen);
+
+		// 登録済みのバンク (MSB, LSB) の組 : 未登録のバンクは (0, 0) と同じ解決結果となるため、(0, 0) は常に含める
+		std::vector<std::pair<uint8_t, uint8_t>> banks = { {0, 0} };
+		for(auto& [variant, params] : mMelodyParams) banks.emplace_back(variant.bankMSB, variant.bankLSB);
+		for(auto& [variant, params] : mDrumParams) banks.emplace_back(variant.bankMSB, variant.bankLSB);
+		std::ranges::sort(banks);
+		banks.erase(std::unique(banks.begin(), banks.end()), banks.end());
+
+		// キー順に構築するため、索引は整列済みとなる
+		mFrozenMelodyParams.clear();
+		mFrozenDrumParams.clear();
+		for(auto st : { InstrumentSystemType::None, InstrumentSystemType::GM1, InstrumentSystemType::GM2, InstrumentSystemType::GS, InstrumentSystemType::XG }) {
+			for(auto [msb, lsb] : banks) {
+				auto& melody = mFrozenMelodyParams.emplace_back();
+				auto& drum = mFrozenDrumParams.emplace_back();
+				melody.key = drum.key = { st, msb, lsb };
+				for(int32_t id = 0; id < FROZEN_ID_COUNT; ++id) {
+					melody.resolved[id] = findMelodyParam(st, msb, lsb, id);
+					drum.resolved[id] = findDrumParam(st, msb, lsb, id);
+				}
+			}
+		}
+		mFrozen = true;
+	}
+	bool frozen() const noexcept { return mFrozen; }
+
+	// 登録済みの全パラメータを列挙します (順序は不定)
+	// f : void(const InstrumentVariantKey&, int32_t progId/noteNo, const MelodyParam&/DrumParam&)
+	template<class F>
+	void forEachMelodyParam(F&& f) const
+	{
+		for(auto& [variant, params] : mMelodyParams) {
+			for(auto& [progId, param] : params) f(variant, progId, param);
+		}
+	}
+	template<class F>
+	void forEachDrumParam(F&& f) const
+	{
+		for(auto& [variant, params] : mDrumParams) {
+			for(auto& [noteNo, param] : params) f(variant, noteNo, param);
+		}
+	}
+
 private:
 	const MelodyParam* findMelodyExact(const InstrumentVariantKey& key, int32_t progId) const
 	{
@@ -173,8 +263,36 @@ private:
 		return it != varIt->second.end() ? &it->second : nullptr;
 	}
 
+	// 凍結後の索引 : variant 毎のフォールバック解決済みパラメータ (キー順に整列)
+	template<class Param>
+	struct FrozenVariant
+	{
+		InstrumentVariantKey key;
+		std::array<const Param*, FROZEN_ID_COUNT> resolved = {};
+	};
+	static constexpr uint32_t frozenOrder(const InstrumentVariantKey& key) noexcept
+	{
+		return (static_cast<uint32_t>(key.systemType) << 16) | (static_cast<uint32_t>(key.bankMSB) << 8) | key.bankLSB;
+	}
+	template<class Param>
+	static const FrozenVariant<Param>& findFrozen(const std::vector<FrozenVariant<Param>>& variants, const InstrumentVariantKey& key) noexcept
+	{
+		auto find = [&variants](const InstrumentVariantKey& k) {
+			auto it = std::ranges::lower_bound(variants, frozenOrder(k), {}, [](const FrozenVariant<Param>& v) { return frozenOrder(v.key); });
+			return (it != variants.end() && it->key == k) ? &*it : nullptr;
+		};
+		if(auto found = find(key)) return *found;
+		// 未登録のバンク : systemType + bank 0/0 と同じ解決結果となる (freeze() で必ず構築済み)
+		return *find({ key.systemType, 0, 0 });
+	}
+
 	std::unordered_map<InstrumentVariantKey, std::unordered_map<int32_t, MelodyParam>> mMelodyParams;
 	std::unordered_map<InstrumentVariantKey, std::unordered_map<int32_t, DrumParam>> mDrumParams;
+	std::shared_ptr<const SoundFont> mSoundFont;
+
+	bool mFrozen = false;
+	std::vector<FrozenVariant<MelodyParam>> mFrozenMelodyParams;
+	std::vector<FrozenVariant<DrumParam>> mFrozenDrumParams;
 };
 
 }
@@ -47,7 +47,10 @@ auto Instruments::createSquareGenerator(float volume)
 		return table;
 	}();
 
-	return WaveTableGenerator(table, volume);
+	// 正規化係数はテーブル毎に一度だけ算出する
+	static const float unitNorm = WaveTableGenerator::computePerceptualNorm(table, 1.f, 1.f);
+
+	return WaveTableGenerator(table, volume, 1.f, WaveTableGenerator::scalePerceptualNorm(unitNorm, volume));
 }
 
 // 正弦波のジェネレータを返します
@@ -68,7 +71,10 @@ auto Instruments::createSineGenerator(float volume)
 		return table;
 	}();
 
-	return WaveTableGenerator(table, volume);
+	// 正規化係数はテーブル毎に一度だけ算出する
+	static const float unitNorm = WaveTableGenerator::computePerceptualNorm(table, 1.f, 1.f);
+
+	return WaveTableGenerator(table, volume, 1.f, WaveTableGenerator::scalePerceptualNorm(unitNorm, volume));
 }
 
 // 三角波のジェネレータを返します
@@ -93,7 +99,10 @@ auto Instruments::createTriangleGenerator(float volume)
 		return table;
 	}();
 
-	return WaveTableGenerator(table, volume);
+	// 正規化係数はテーブル毎に一度だけ算出する
+	static const float unitNorm = WaveTableGenerator::computePerceptualNorm(table, 1.f, 1.f);
+
+	return WaveTableGenerator(table, volume, 1.f, WaveTableGenerator::scalePerceptualNorm(unitNorm, volume));
 }
 
 // のこぎり波のジェネレータを返します
@@ -111,7 +120,10 @@ auto Instruments::createSawtoothGenerator(float volume)
 		return table;
 	}();
 
-	return WaveTableGenerator(table, volume);
+	// 正規化係数はテーブル毎に一度だけ算出する
+	static const float unitNorm = WaveTableGenerator::computePerceptualNorm(table, 1.f, 1.f);
+
+	return WaveTableGenerator(table, volume, 1.f, WaveTableGenerator::scalePerceptualNorm(unitNorm, volume));
 }
 
 // ドラム用ノイズのジェネレータを返します
@@ -121,11 +133,13 @@ auto Instruments::createDrumNoiseGenerator(float volume)
 	using FunctionGenerator = dsp::FunctionGenerator<float>;
 	using BiquadraticFilter = dsp::BiquadraticFilter<float>;
 	static constexpr size_t samples = 131072;
+	// テーブル内容を実行環境に依らず再現可能とするため、シードは固定値とする
+	static constexpr uint32_t noiseSeed = 0x4C535044; // 'LSPD'
 
 	static const auto [table, preAmp] = []() -> std::tuple<Signal<float>, float> {
 		auto table = Signal<float>::allocate(samples);
 		auto data = table.data();
-		FunctionGenerator fg;
+		FunctionGenerator fg(noiseSeed);
 		fg.setWhiteNoise();
 		std::array<BiquadraticFilter, 6> bqfs;
 		bqfs[0].setLopassParam(44100, 4000.f, 1.0f); // 不要高周波を緩やかにカットオフ
@@ -133,19 +147,26 @@ auto Instruments::createDrumNoiseGenerator(float volume)
 		bqfs[2].setLopassParam(44100, 3000.f, 0.5f); // (同上)
 		bqfs[3].setLopassParam(44100, 2000.f, 0.5f); // (同上)
 		bqfs[4].setLopassParam(44100, 1000.f, 1.0f); // 基本となる高さ
-		for(size_t i = 0; i < samples * 2; i++) {
+		auto filterTable = [&] {
+			for(size_t i = 0; i < samples; ++i) {
+				float s = data[i];
+				for(auto& bqf : bqfs) s = bqf.update(s);
+				data[i] = s;
+			}
+		};
+		for(size_t pass = 0; pass < 2; ++pass) {
 			// 波形が安定するまで読み捨てる
-			float s = fg.update();
-			for(auto& bqf : bqfs) s = bqf.update(s);
-		}
-		for(size_t i = 0; i < samples; ++i) {
-			float s = fg.update();
-			for(auto& bqf : bqfs) s = bqf.update(s);
-			data[i] = s;
+			fg.generate({data, samples});
+			filterTable();
 		}
+		fg.generate({data, samples});
+		filterTable();
 		auto preAmp = 10.0f;
 		return std::make_tuple(std::move(table), preAmp);
 	}();
 
-	return WaveTableGenerator(table, preAmp * volume, 62.5f);
+	// 正規化係数はテーブル毎に一度だけ算出する (ノイズテーブルは1周期が長いため特に重要)
+	static const float unitNorm = WaveTableGenerator::computePerceptualNorm(table, preAmp, 62.5f);
+
+	return WaveTableGenerator(table, preAmp * volume, 62.5f, WaveTableGenerator::scalePerceptualNorm(unitNorm, volume));
 }
\ No newline at end of file
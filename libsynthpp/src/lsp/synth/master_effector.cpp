@@ -0,0 +1,44 @@
+﻿#include <lsp/synth/master_effector.hpp>
+
+using namespace lsp::synth;
+
+MasterEffector::MasterEffector(uint32_t sampleFreq)
+{
+	const auto freq = static_cast<float>(sampleFreq);
+
+	// コンプレッサ : 大音量時のみ緩やかに圧縮する
+	mCompressor.setParam(freq, 2,
+		-12.0f,	// threshold [dBFS]
+		2.0f,	// ratio
+		6.0f,	// knee [dB]
+		0.010f,	// attack [sec]
+		0.150f,	// release [sec]
+		0.010f	// RMS [sec]
+	);
+
+	// リミッタ : -0.3dBFS を上限とし、クリップを防止する
+	mLimiter.setParam(freq, 2,
+		0.966f,	// ceiling (-0.3dBFS)
+		0.0015f,// lookahead [sec]
+		0.050f	// release [sec]
+	);
+}
+
+void MasterEffector::reset()
+{
+	mCompressor.reset();
+	mLimiter.reset();
+}
+
+MasterEffector::Statistics MasterEffector::process(Signal<float>& sig)
+{
+	Statistics stat;
+	if(sig.channels() != 2) {
+		lsp_rt_fail(return stat, "MasterEffector: unsupported channels={}", sig.channels());
+	}
+
+	stat.compressor_gain_reduction_db = mCompressor.process(sig.data(), sig.frames());
+	const auto limiterGain = mLimiter.process(sig.data(), sig.frames());
+	stat.limiter_gain_reduction_db = -20.0f * std::log10(std::max(limiterGain, 1e-6f));
+	return stat;
+}
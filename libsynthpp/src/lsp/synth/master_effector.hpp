@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/dsp/compressor.hpp>
+#include <lsp/dsp/limiter.hpp>
+
+namespace lsp::synth
+{
+
+// マスタエフェクタ
+// シンセサイザ全体の出力に対して、コンプレッサ → リミッタの順でエフェクトを適用します。
+// 信号はステレオ(2ch)インターリーブ形式を前提とします。
+class MasterEffector final
+	: non_copy_move
+{
+public:
+	struct Statistics {
+		float compressor_gain_reduction_db = 0;	// 直近の処理区間でのコンプレッサの最大ゲインリダクション量(dB)
+		float limiter_gain_reduction_db = 0;	// 直近の処理区間でのリミッタの最大ゲインリダクション量(dB)
+	};
+
+public:
+	explicit MasterEffector(uint32_t sampleFreq);
+
+	// 内部状態をリセットします
+	void reset();
+
+	// 信号を処理します (in-place)
+	Statistics process(Signal<float>& sig);
+
+private:
+	dsp::Compressor<float> mCompressor;
+	dsp::LookaheadLimiter<float> mLimiter;
+};
+
+}
@@ -0,0 +1,112 @@
+﻿#include <lsp/synth/message_coalescer.hpp>
+
+using namespace lsp::synth;
+
+MessageCoalescer::MessageCoalescer(size_t capacity)
+{
+	lsp_require(capacity > 0);
+	mEntries.reserve(capacity);
+	clear();
+}
+
+void MessageCoalescer::push(size_t frameOffset, const std::shared_ptr<const midi::Message>& msg)
+{
+	lsp_require(msg != nullptr);
+	lsp_require(!full());
+	lsp_require(mEntries.empty() || mEntries.back().frameOffset <= frameOffset);
+
+	mEntries.push_back({frameOffset, midi::Ump(), msg});
+
+	// パケットとして扱えないメッセージ(SysEx 等)は集約しない
+	const auto ch = msg->channel();
+	if(ch < CHANNELS) {
+		barrier(ch);
+	} else {
+		// チャネルを持たないメッセージ : 全チャネルの状態に影響し得る
+		for(uint8_t i = 0; i < CHANNELS; ++i) barrier(i);
+	}
+}
+
+void MessageCoalescer::push(size_t frameOffset, const midi::Ump& packet)
+{
+	lsp_require(!full());
+	lsp_require(mEntries.empty() || mEntries.back().frameOffset <= frameOffset);
+
+	const auto index = static_cast<uint32_t>(mEntries.size());
+	mEntries.push_back({frameOffset, packet, nullptr});
+
+	const auto slot = slotOf(packet);
+	if(!slot) {
+		const auto type = packet.messageType();
+		if(type == midi::Ump::MessageType::Midi1ChannelVoice || type == midi::Ump::MessageType::Midi2ChannelVoice) {
+			barrier(packet.channel());
+		} else {
+			for(uint8_t i = 0; i < CHANNELS; ++i) barrier(i);
+		}
+		return;
+	}
+
+	// 同一チャネル・同一スロットの直前のパケットを取り除く
+	auto& last = mLastIndices[packet.channel()][*slot];
+	if(last != NONE) {
+		mEntries[last].packet = midi::Ump();
+		++mCoalescedCount;
+	}
+	last = index;
+}
+
+void MessageCoalescer::clear()noexcept
+{
+	mEntries.clear();
+	for(uint8_t ch = 0; ch < CHANNELS; ++ch) barrier(ch);
+}
+
+void MessageCoalescer::barrier(uint8_t ch)noexcept
+{
+	mLastIndices[ch].fill(NONE);
+}
+
+std::optional<size_t> MessageCoalescer::slotOf(const midi::Ump& packet)noexcept
+{
+	using Status = midi::Ump::Status;
+
+	// コントロール番号 → スロット番号
+	//   値の適用のみを行い、後続の値で完全に上書きされるものに限る
+	//   (スイッチ系, Bank Select, RPN/NRPN, チャネルモードメッセージ は前後関係に意味があるため対象外)
+	static constexpr auto CC_SLOTS = [] {
+		std::array<int8_t, 128> slots;
+		slots.fill(-1);
+		int8_t next = 0;
+		for(uint8_t ctrlNo : {
+			1,	// Modulation
+			7,	// Channel Volume
+			10,	// Pan
+			11,	// Expression
+			71,	// Resonance
+			72,	// Release Time
+			73,	// Attack Time
+			74,	// Brightness
+			75,	// Decay Time
+			91,	// Effect1 Depth
+			93,	// Effect3 Depth
+		}) {
+			slots[ctrlNo] = next++;
+		}
+		return slots;
+	}();
+	constexpr size_t PITCH_BEND_SLOT = SLOTS - 2;
+	constexpr size_t CHANNEL_PRESSURE_SLOT = SLOTS - 1;
+
+	if(packet.messageType() != midi::Ump::MessageType::Midi2ChannelVoice) return std::nullopt;
+	switch(packet.status()) {
+	case Status::ControlChange:
+		if(const auto slot = CC_SLOTS[packet.index()]; slot >= 0) return static_cast<size_t>(slot);
+		return std::nullopt;
+	case Status::PitchBend:
+		return PITCH_BEND_SLOT;
+	case Status::ChannelPressure:
+		return CHANNEL_PRESSURE_SLOT;
+	default:
+		return std::nullopt;
+	}
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/midi/message.hpp>
+#include <lsp/midi/ump.hpp>
+
+#include <array>
+
+namespace lsp::synth
+{
+
+// MIDIメッセージ 集約器
+// 1ブロック内に届いた連続値のメッセージ(CC#1/#7/#11 等, ピッチベンド, チャネルプレッシャー)のうち、
+// 同一チャネル・同一種別で後続に上書きされるものを取り除き、最後の値のみを適用させます。
+//   - 集約は同一チャネルのそれ以外のメッセージ(ノート, スイッチ系CC, RPN/NRPN 等)を跨いで行わない
+//   - チャネルを持たないメッセージ(SysEx 等)は全チャネルの集約を打ち切る
+//   - 残ったメッセージの順序と位置は変更しない
+// これにより、届いたメッセージ量によらずブロックあたりのパラメータ更新コストが抑えられます。
+class MessageCoalescer final
+	: non_copy_move
+{
+public:
+	static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+	explicit MessageCoalescer(size_t capacity = DEFAULT_CAPACITY);
+
+	// メッセージ/パケットを追加します (frameOffset : ブロック先頭からのフレーム位置, 時系列順に追加すること)
+	// 容量に達している場合、先にそれまでのメッセージを flush(f) してから追加します
+	template<class F>
+	void push(size_t frameOffset, const std::shared_ptr<const midi::Message>& msg, F&& f)
+	{
+		if(full()) flush(f);
+		push(frameOffset, msg);
+	}
+	template<class F>
+	void push(size_t frameOffset, const midi::Ump& packet, F&& f)
+	{
+		if(full()) flush(f);
+		push(frameOffset, packet);
+	}
+
+	// 残ったメッセージ/パケットを順に f(frameOffset, msg) または f(frameOffset, packet) へ渡し、内部状態をクリアします
+	template<class F>
+	void flush(F&& f)
+	{
+		for(auto& entry : mEntries) {
+			if(entry.msg) {
+				f(entry.frameOffset, entry.msg);
+			} else if(!entry.packet.empty()) {
+				f(entry.frameOffset, entry.packet);
+			}
+		}
+		clear();
+	}
+
+	// 内部状態をクリアします
+	void clear()noexcept;
+
+	// これまでに取り除いたメッセージ数を取得します
+	uint64_t coalescedCount()const noexcept { return mCoalescedCount; }
+
+private:
+	bool full()const noexcept { return mEntries.size() >= mEntries.capacity(); }
+	void push(size_t frameOffset, const std::shared_ptr<const midi::Message>& msg);
+	void push(size_t frameOffset, const midi::Ump& packet);
+
+	// 集約対象のスロット番号を取得します (集約対象外の場合は std::nullopt)
+	static std::optional<size_t> slotOf(const midi::Ump& packet)noexcept;
+	// 指定チャネルの集約を打ち切ります
+	void barrier(uint8_t ch)noexcept;
+
+private:
+	static constexpr size_t CHANNELS = 16;
+	static constexpr size_t SLOTS = 13;
+	static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+	struct Entry
+	{
+		size_t frameOffset;
+		midi::Ump packet; // 取り除いた場合は空のパケット
+		std::shared_ptr<const midi::Message> msg; // パケットとして扱えないメッセージのみ
+	};
+	std::vector<Entry> mEntries;
+
+	// チャネル・スロット毎の直近のメッセージ位置 (mEntries のインデックス)
+	std::array<std::array<uint32_t, SLOTS>, CHANNELS> mLastIndices;
+
+	uint64_t mCoalescedCount = 0;
+};
+
+}
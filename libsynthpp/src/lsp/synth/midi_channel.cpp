@@ -1,13 +1,16 @@
 ﻿#include <lsp/synth/midi_channel.hpp>
 #include <lsp/synth/voice.hpp>
+#include <lsp/midi/ump.hpp>
+
+#include <random>
 
 using namespace lsp::synth;
 
 MidiChannel::MidiChannel(uint32_t sampleFreq, uint8_t ch, const InstrumentTable& instrumentTable, std::optional<uint32_t> randomSeed)
 	: mSampleFreq(sampleFreq)
 	, mMidiCh(ch)
-	, mInstrumentTable(instrumentTable)
-	, mRandomEngine(randomSeed.value_or(std::random_device()()))
+	, mInstrumentTable(&instrumentTable)
+	, mRandomEngine(randomSeed ? *randomSeed : std::random_device{}()) // シード指定時は random_device を生成しない
 {
 	// メンバ変数の初期化のみ行う
 	// システム種別に基づくリセットは Synthesizer::reset() から一括で行われる
@@ -24,7 +27,7 @@ void MidiChannel::reset(midi::SystemType type)
 void MidiChannel::resetVoices()
 {
 	// 全発音を強制停止
-	mVoices.clear();
+	clearVoices();
 	mMonoNoteStack.clear();
 }
 void MidiChannel::resetParameters()
@@ -36,18 +39,28 @@ void MidiChannel::resetParameters()
 	// コントロールチェンジ系 (CC#121では維持される項目)
 	ccVolume = 1.0;
 	ccPan = 0.5f;
+	ccReverbSend = 40 / 127.0f; // GS/XG の初期値
+	ccChorusSend = 0.0f;
 
 	ccPrevCtrlNo = 0xFF; // invalid value
 	ccPrevValue = 0x00;
 
 	ccBankSelectLSB = 0;
 	ccBankSelectMSB = 0;
+	resolveInstrument();
 
 	mMonoMode = false;
 
 	// RPN/NRPN 値のクリア (CC#121ではパラメータ番号のみリセットされ、値は維持される)
-	ccRPNs.clear();
-	ccNRPNs.clear();
+	mRPNs.fill({});
+	mNRPNs.fill({});
+	for(auto& params : mDrumNRPNs) {
+		params.fill({});
+	}
+	updateTuning();
+	for(uint8_t noteNo = 0; noteNo < 128; ++noteNo) {
+		updateDrumNote(noteNo);
+	}
 
 	// CC#121 リセットオールコントローラ相当の初期化
 	resetAllControllers();
@@ -84,6 +97,7 @@ void MidiChannel::resetAllControllers()
 	// Pitch Bend → center
 	mRawPitchBend = 0;
 	updatePitchBend();
+	mPerNotePitchBend.fill(0);
 
 	// Channel Pressure → 0
 	mChannelPressure = 0.0f;
@@ -92,6 +106,7 @@ void MidiChannel::resetAllControllers()
 	ccAttackTime = 64;
 	ccDecayTime = 64;
 	ccReleaseTime = 64;
+	updateEGTimeScale();
 	updateReleaseTime();
 
 	// CC 71/74 → center(64)
@@ -103,6 +118,15 @@ void MidiChannel::resetAllControllers()
 	resetParameterNumberState();
 }
 void MidiChannel::noteOn(uint32_t noteNo, uint8_t vel)
+{
+	startNote(static_cast<uint8_t>(noteNo & 0x7F), vel / 127.f, std::nullopt);
+}
+void MidiChannel::noteOnHighRes(uint8_t noteNo, uint16_t vel, std::optional<float> pitch)
+{
+	// MEMO MIDI 2.0 ではベロシティ0のノートオンはノートオフではないが、無音となるため発音しない
+	startNote(noteNo & 0x7F, vel / 65535.f, pitch);
+}
+void MidiChannel::startNote(uint8_t noteNo, float vel, std::optional<float> pitch)
 {
 	// 同じノート番号は同時発音不可
 	noteOff(noteNo);
@@ -114,28 +138,24 @@ void MidiChannel::noteOn(uint32_t noteNo, uint8_t vel)
 			mMonoNoteStack.push_back(static_cast<uint8_t>(noteNo));
 
 			// 発音中(Free/Release以外)のボイスを探す
-			Voice* activeVoice = nullptr;
+			AnyVoice* activeVoice = nullptr;
 			for (auto& [id, voice] : mVoices) {
-				if (voice->isNoteOn()) {
-					activeVoice = voice.get();
+				if (voice.isNoteOn()) {
+					activeVoice = &voice;
 					break;
 				}
 			}
 
 			if (activeVoice) {
 				// レガート : ピッチだけ変更
-				activeVoice->setNoteNo(static_cast<float>(noteNo));
+				changeVoiceNote(*activeVoice, noteNo);
 			} else {
 				// 最初の打鍵 : 通常通りボイスを生成
-				auto id = VoiceId::issue();
-				auto voice = createVoice(noteNo, vel);
-				mVoices.emplace(id, std::move(voice));
+				createVoice(noteNo, vel, pitch);
 			}
 		} else {
 			// ポリモードまたはドラム : 通常動作
-			auto id = VoiceId::issue();
-			auto voice = createVoice(noteNo, vel);
-			mVoices.emplace(id, std::move(voice));
+			createVoice(noteNo, vel, pitch);
 		}
 	}
 }
@@ -149,31 +169,47 @@ void MidiChannel::noteOff(uint32_t noteNo)
 			// スタックに残りがある → 前のノートのピッチに戻す
 			uint8_t prevNote = mMonoNoteStack.back();
 			for (auto& [id, voice] : mVoices) {
-				if (voice->isNoteOn()) {
-					voice->setNoteNo(static_cast<float>(prevNote));
+				if (voice.isNoteOn()) {
+					changeVoiceNote(voice, prevNote);
 				}
 			}
 		} else {
 			// スタックが空 → 全ボイスをnoteOff
 			for (auto& [id, voice] : mVoices) {
-				voice->noteOff();
+				voice.noteOff();
 			}
 		}
 	} else {
 		// ポリモードまたはドラム : 通常動作
-		for (auto& [id, voice] : mVoices) {
-			if (voice->noteNo() == noteNo) {
-				voice->noteOff();
-			}
+		if (noteNo >= mNoteVoices.size()) return;
+		for (auto voice : mNoteVoices[noteNo]) {
+			voice->noteOff();
 		}
 	}
 }
 void MidiChannel::noteCut(uint32_t noteNo)
 {
-	for(auto& [id, voice] : mVoices) {
-		if(voice->noteNo() == noteNo) {
-			voice->noteCut();
-		}
+	if(noteNo >= mNoteVoices.size()) return;
+	for(auto voice : mNoteVoices[noteNo]) {
+		voice->noteCut();
+	}
+}
+void MidiChannel::clearVoices()
+{
+	// MEMO 索引側は容量を維持し、以降の発音でメモリ確保が起きないようにする
+	for(auto& voices : mNoteVoices) {
+		voices.clear();
+	}
+	mVoices.clear();
+}
+void MidiChannel::changeVoiceNote(AnyVoice& voice, uint8_t noteNo)
+{
+	auto oldIndex = noteIndexOf(voice.base());
+	voice.base().setNoteNo(static_cast<float>(noteNo));
+	auto newIndex = noteIndexOf(voice.base());
+	if(oldIndex != newIndex) {
+		std::erase(mNoteVoices[oldIndex], &voice);
+		mNoteVoices[newIndex].push_back(&voice);
 	}
 }
 // プログラムチェンジ
@@ -182,6 +218,7 @@ void MidiChannel::programChange(uint8_t progId)
 	// 事前に受信していたバンクセレクトを解決
 	// プログラムId更新
 	mProgId = progId;
+	resolveInstrument();
 }
 // コントロールチェンジ & チャネルモードメッセージ
 void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
@@ -195,6 +232,7 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 	// --- コントロールチェンジ ---
 	case 0: // Bank Select <MSB>（バンクセレクト）
 		ccBankSelectMSB = value;
+		resolveInstrument();
 		break;
 	case 1: // Modulation（モジュレーション / ビブラート）
 		ccModulation = value;
@@ -217,8 +255,9 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 		break;
 	case 32: // Bank Select <LSB>（バンクセレクト）
 		ccBankSelectLSB = value;
+		resolveInstrument();
 		break;
-	case 36: // Data Entry(LSB)
+	case 38: // Data Entry(LSB)
 		ccDE_LSB = value;
 		apply_RPN_NRPN_state = true; // MSBのみでよいものはこのタイミングで適用する
 		break;
@@ -240,6 +279,7 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 		break;
 	case 73: // Attack Time(アタックタイム)
 		ccAttackTime = value;
+		updateEGTimeScale();
 		break;
 	case 74: // Brightness(ブライトネス / カットオフ)
 		ccBrightness = value;
@@ -247,6 +287,13 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 		break;
 	case 75: // Decay Time(ディケイタイム)
 		ccDecayTime = value;
+		updateEGTimeScale();
+		break;
+	case 91: // Effect1 Depth(リバーブセンドレベル)
+		ccReverbSend = value / 127.0f;
+		break;
+	case 93: // Effect3 Depth(コーラスセンドレベル)
+		ccChorusSend = value / 127.0f;
 		break;
 	case 98: // NRPN(LSB)
 		ccNRPN_LSB = value;
@@ -274,7 +321,7 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 	case 123: // オールノートオフ
 		mMonoNoteStack.clear();
 		for (auto& kvp : mVoices) {
-			kvp.second->noteOff();
+			kvp.second.noteOff();
 		}
 		break;
 	// --- チャネルモードメッセージ : not implemented ---
@@ -286,14 +333,14 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 		mMonoMode = true;
 		mMonoNoteStack.clear();
 		for (auto& kvp : mVoices) {
-			kvp.second->noteOff();
+			kvp.second.noteOff();
 		}
 		break;
 	case 127: // ポリモード
 		mMonoMode = false;
 		mMonoNoteStack.clear();
 		for (auto& kvp : mVoices) {
-			kvp.second->noteOff();
+			kvp.second.noteOff();
 		}
 		break;
 	}
@@ -305,49 +352,33 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 			resetParameterNumberState();
 		}
 		else if(ccDE_MSB || ccDE_LSB) {
-			if(ccRPN_MSB && ccRPN_LSB) {
-				auto key = (static_cast<uint16_t>(*ccRPN_MSB) << 8) | *ccRPN_LSB;
+			// 値を保持しないパラメータは読み捨てる
+			auto store = [this](ParameterValue* param) {
+				if(!param) return;
 				if(ccDE_LSB) {
-					ccRPNs[key].second = *ccDE_LSB;
+					param->lsb = *ccDE_LSB;
 				}
 				else {
-					ccRPNs[key].first = *ccDE_MSB;
+					param->msb = *ccDE_MSB;
 				}
+			};
+			if(ccRPN_MSB && ccRPN_LSB) {
+				store(findParameter(true, *ccRPN_MSB, *ccRPN_LSB));
 			}
 			if(ccNRPN_MSB && ccNRPN_LSB) {
-				auto key = (static_cast<uint16_t>(*ccNRPN_MSB) << 8) | *ccNRPN_LSB;
-				if(ccDE_LSB) {
-					ccNRPNs[key].second = *ccDE_LSB;
-				}
-				else {
-					ccNRPNs[key].first = *ccDE_MSB;
-				}
+				store(findParameter(false, *ccNRPN_MSB, *ccNRPN_LSB));
 			}
 
 			// RPN/ NRPN 即時反映系
-			// - RPN: ピッチベンドセンシティビティ
-			if(ccRPN_MSB == 0 && ccRPN_LSB == 0 && ccDE_MSB) {
-				updatePitchBend();
-			}
-
-			// - NRPN(XG) : ドラムパートへ切替
-			if(mSystemType.isXG() && ccNRPN_MSB == 127) {
-				setDrumMode(true);
-			}
-
-			// - NRPN(GS/XG) : EGリリースタイム
-			if((mSystemType.isGS() || mSystemType.isXG()) && ccNRPN_MSB == 1 && ccNRPN_LSB == 102) {
-				updateReleaseTime();
+			if(ccRPN_MSB && ccRPN_LSB && ccDE_MSB) {
+				onParameterChanged(true, *ccRPN_MSB, *ccRPN_LSB);
 			}
-
-			// - NRPN(GS/XG) : カットオフ / レゾナンス
-			if((mSystemType.isGS() || mSystemType.isXG()) && ccNRPN_MSB == 1 && (ccNRPN_LSB == 32 || ccNRPN_LSB == 33)) {
-				updateFilter();
+			if(ccNRPN_MSB && ccNRPN_LSB) {
+				onParameterChanged(false, *ccNRPN_MSB, *ccNRPN_LSB);
 			}
-
-			// - NRPN(GS/XG) : ビブラートレート / デプス / ディレイ
-			if((mSystemType.isGS() || mSystemType.isXG()) && ccNRPN_MSB == 1 && (ccNRPN_LSB == 8 || ccNRPN_LSB == 9 || ccNRPN_LSB == 10)) {
-				updateVibrato();
+			else if(mSystemType.isXG() && ccNRPN_MSB == 127) {
+				// - NRPN(XG) : ドラムパートへ切替 (MSBのみで切り替える)
+				setDrumMode(true);
 			}
 		}
 	}
@@ -358,69 +389,139 @@ void MidiChannel::controlChange(uint8_t ctrlNo, uint8_t value)
 
 void MidiChannel::pitchBend(int16_t pitch)
 {
-	mRawPitchBend = pitch;
+	mRawPitchBend = pitch / 8192.0f;
 	updatePitchBend();
 }
 void MidiChannel::channelPressure(uint8_t value)
 {
 	mChannelPressure = value / 127.0f;
 }
+void MidiChannel::controlChangeHighRes(uint8_t ctrlNo, uint32_t value)
+{
+	// 7bit値で通常通り処理した後、高解像度で保持できるパラメータのみ上書きする
+	controlChange(ctrlNo, static_cast<uint8_t>(midi::Ump::scaleDown(value, 32, 7)));
+
+	const float normalized = static_cast<float>(value / 4294967295.0);
+	switch (ctrlNo) {
+	case 7: // Channel Volume
+		ccVolume = normalized;
+		break;
+	case 10: // Pan
+		ccPan = std::clamp((normalized * 127 - 1) / 126.0f, 0.0f, 1.0f);
+		break;
+	case 11: // Expression
+		ccExpression = normalized;
+		break;
+	case 91: // Effect1 Depth
+		ccReverbSend = normalized;
+		break;
+	case 93: // Effect3 Depth
+		ccChorusSend = normalized;
+		break;
+	}
+}
+void MidiChannel::channelPressureHighRes(uint32_t value)
+{
+	mChannelPressure = static_cast<float>(value / 4294967295.0);
+}
+void MidiChannel::polyphonicKeyPressureHighRes(uint8_t noteNo, uint32_t value)
+{
+	float pressure = static_cast<float>(value / 4294967295.0);
+	for (auto voice : mNoteVoices[noteNo & 0x7F]) {
+		voice->base().setPolyPressure(pressure);
+	}
+}
+void MidiChannel::pitchBendHighRes(uint32_t pitch)
+{
+	mRawPitchBend = static_cast<float>((static_cast<int64_t>(pitch) - midi::Ump::CENTER_32) / 2147483648.0);
+	updatePitchBend();
+}
+void MidiChannel::perNotePitchBend(uint8_t noteNo, uint32_t pitch)
+{
+	noteNo &= 0x7F;
+	mPerNotePitchBend[noteNo] = static_cast<float>((static_cast<int64_t>(pitch) - midi::Ump::CENTER_32) / 2147483648.0);
+
+	// RPN(0,7) : パーノート ピッチベンドセンシティビティ (既定値 : 48半音)
+	const float semitones = mPerNotePitchBend[noteNo] * mPerNotePitchBendSensitivity;
+	for (auto voice : mNoteVoices[noteNo]) {
+		voice->base().setPerNotePitchBend(semitones);
+	}
+}
+void MidiChannel::resetPerNoteControllers(uint8_t noteNo)
+{
+	perNotePitchBend(noteNo, midi::Ump::CENTER_32);
+}
+void MidiChannel::parameterChange(bool registered, uint8_t msb, uint8_t lsb, uint32_t value)
+{
+	msb &= 0x7F;
+	lsb &= 0x7F;
+	// 32bit値の上位14bitを Data Entry MSB/LSB として扱う
+	if(auto param = findParameter(registered, msb, lsb)) {
+		param->msb = static_cast<uint8_t>((value >> 25) & 0x7F);
+		param->lsb = static_cast<uint8_t>((value >> 18) & 0x7F);
+	}
+	onParameterChanged(registered, msb, lsb);
+}
 void MidiChannel::polyphonicKeyPressure(uint8_t noteNo, uint8_t value)
 {
 	float pressure = value / 127.0f;
-	for (auto& [id, voice] : mVoices) {
-		if (static_cast<uint8_t>(voice->noteNo()) == noteNo) {
-			voice->setPolyPressure(pressure);
-		}
+	for (auto voice : mNoteVoices[noteNo & 0x7F]) {
+		voice->base().setPolyPressure(pressure);
 	}
 }
 
-StereoFrame MidiChannel::update()
+void MidiChannel::render(float* left, float* right, size_t frames)
 {
+	lsp_require(frames <= MAX_RENDER_FRAMES);
+
+	std::fill_n(left, frames, 0.0f);
+	std::fill_n(right, frames, 0.0f);
+
 	// オシレータからの出力はモノラル
-	StereoFrame ret = std::make_pair(0.0f, 0.0f);
+	std::array<float, MAX_RENDER_FRAMES> buffer;
 	for (auto iter = mVoices.begin(); iter != mVoices.end();) {
-		auto& voice = *iter->second;
-		// ボイス単体の音を生成
-		float v = voice.update();
+		auto& voice = iter->second;
+		// ボイス単体の音を生成 (発音を終えた以降のフレームは加算しない)
+		const size_t rendered = voice.render(buffer.data(), frames);
 
 		// パン適用
 		float pan = ccPan;
-		if (voice.pan().has_value()) {
-			float vpan = *voice.pan();
-			if (vpan < 0.5f) {
+		if (auto vpan = voice.base().pan(); vpan.has_value()) {
+			if (*vpan < 0.5f) {
 				// vpan=0 : 左, vpan=0.5 : 元のpan
-				pan = pan * (vpan * 2);
+				pan = pan * (*vpan * 2);
 			} else {
 				// vpan=0.5 : 元のpan, vpan=1.0 : 右
-				pan = 1.0f - (1.0f - pan) * ((1.0f - vpan) * 2);
+				pan = 1.0f - (1.0f - pan) * ((1.0f - *vpan) * 2);
 			}
 		}
 
-		ret.first += v * (1.0f - pan); // L ch
-		ret.second += v * pan;         // R ch
-
+		for (size_t i = 0; i < rendered; ++i) {
+			left[i] += buffer[i] * (1.0f - pan); // L ch
+			right[i] += buffer[i] * pan;         // R ch
+		}
 
 		// 発音終了済のボイスを破棄
-		if (iter->second->isBusy()) {
+		if (voice.isBusy()) {
 			++iter;
 		} else {
+			std::erase(mNoteVoices[noteIndexOf(voice.base())], &voice);
 			iter = mVoices.erase(iter);
 		}
 	}
 
-	// ボリューム
-	ret.first *= ccVolume;
-	ret.second *= ccVolume;
+	for (size_t i = 0; i < frames; ++i) {
+		// ボリューム
+		left[i] *= ccVolume;
+		right[i] *= ccVolume;
 
-	// エクスプレッション
-	ret.first *= ccExpression;
-	ret.second *= ccExpression;
+		// エクスプレッション
+		left[i] *= ccExpression;
+		right[i] *= ccExpression;
+	}
 
 	// チャネルプレッシャーは現状未適用
 	// 対応するインストゥルメントが存在しないため、Voice出力への反映は保留とする
-
-	return ret;
 }
 MidiChannel::Digest MidiChannel::digest()const
 {
@@ -436,6 +537,8 @@ MidiChannel::Digest MidiChannel::digest()const
 	digest.pan = ccPan;
 	digest.pitchBend = mCalculatedPitchBend;
 	digest.modulation = ccModulation;
+	digest.reverbSend = ccReverbSend;
+	digest.chorusSend = ccChorusSend;
 	digest.attackTime = ccAttackTime;
 	digest.decayTime = ccDecayTime;
 	digest.releaseTime = ccReleaseTime;
@@ -448,58 +551,144 @@ MidiChannel::Digest MidiChannel::digest()const
 	digest.drum = mIsDrumPart;
 
 	for (auto& [id, voice] : mVoices) {
-		digest.voices.emplace(id, voice->digest());
+		digest.voices.emplace(id, voice.digest());
 	}
 
 	return digest;
 }
-std::unique_ptr<Voice> MidiChannel::createVoice(uint8_t noteNo, uint8_t vel)
+void MidiChannel::onParameterChanged(bool registered, uint8_t msb, uint8_t lsb)
 {
-	if(mIsDrumPart) {
-		return createDrumVoice(noteNo, vel);
+	if(registered) {
+		// - RPN: ピッチベンドセンシティビティ / マスターチューニング / パーノート ピッチベンドセンシティビティ
+		if(msb == 0 && (lsb <= 2 || lsb == 7)) {
+			updateTuning();
+			updatePitchBend();
+		}
+		return;
+	}
+
+	// - NRPN(XG) : ドラムパートへ切替
+	if(mSystemType.isXG() && msb == 127) {
+		setDrumMode(true);
+	}
+
+	// GS/XG 以外では導出パラメータ算出時にNRPNを無視するため、ここでは常に再計算してよい
+	switch(msb) {
+	case 1:
+		switch(lsb) {
+		case 8: case 9: case 10: // - NRPN(GS/XG) : ビブラートレート / デプス / ディレイ
+			updateVibrato();
+			break;
+		case 32: case 33: // - NRPN(GS/XG) : カットオフ / レゾナンス
+			updateFilter();
+			break;
+		case 99: case 100: // - NRPN(GS/XG) : EGアタック / ディケイタイム (次のノートオンから反映)
+			updateEGTimeScale();
+			break;
+		case 102: // - NRPN(GS/XG) : EGリリースタイム
+			updateReleaseTime();
+			break;
+		}
+		break;
+	case 24: case 25: case 26: case 28: // - NRPN : ドラム ピッチ / レベル / パン (次のノートオンから反映)
+		updateDrumNote(lsb);
+		break;
 	}
-	else {
-		return createMelodyVoice(noteNo, vel);
+}
+AnyVoice* MidiChannel::createVoice(uint8_t noteNo, float vel, std::optional<float> pitch)
+{
+	auto voice = mSamplePreset ? createSampleVoice(noteNo, vel)
+		: mIsDrumPart ? createDrumVoice(noteNo, vel)
+		: createMelodyVoice(noteNo, vel);
+	if(!voice) return voice;
+
+	// パーノート ピッチベンド + ノートオン属性による音高指定
+	float perNotePitch = mPerNotePitchBend[noteNo] * mPerNotePitchBendSensitivity;
+	if(pitch) perNotePitch += *pitch - noteNo;
+	if(perNotePitch != 0) {
+		voice->base().setPerNotePitchBend(perNotePitch);
+	}
+	return voice;
+}
+const MidiChannel::ParameterValue* MidiChannel::findParameter(bool registered, uint8_t msb, uint8_t lsb)const noexcept
+{
+	if(registered) {
+		if(msb != 0) return nullptr;
+		switch(lsb) {
+		case 0: return &mRPNs[0]; // ピッチベンドセンシティビティ
+		case 1: return &mRPNs[1]; // マスターファインチューニング
+		case 2: return &mRPNs[2]; // マスターコースチューニング
+		case 7: return &mRPNs[3]; // パーノート ピッチベンドセンシティビティ
+		default: return nullptr;
+		}
+	}
+
+	if(lsb >= 128) return nullptr;
+	switch(msb) {
+	case 1:
+		switch(lsb) {
+		case 8: return &mNRPNs[0];   // ビブラートレート
+		case 9: return &mNRPNs[1];   // ビブラートデプス
+		case 10: return &mNRPNs[2];  // ビブラートディレイ
+		case 32: return &mNRPNs[3];  // カットオフ
+		case 33: return &mNRPNs[4];  // レゾナンス
+		case 99: return &mNRPNs[5];  // EGアタックタイム
+		case 100: return &mNRPNs[6]; // EGディケイタイム
+		case 102: return &mNRPNs[7]; // EGリリースタイム
+		default: return nullptr;
+		}
+	case 24: return &mDrumNRPNs[0][lsb]; // ドラム ピッチ粗調整
+	case 25: return &mDrumNRPNs[1][lsb]; // ドラム ピッチ微調整
+	case 26: return &mDrumNRPNs[2][lsb]; // ドラム レベル
+	case 28: return &mDrumNRPNs[3][lsb]; // ドラム パン
+	default: return nullptr;
 	}
 }
+MidiChannel::ParameterValue* MidiChannel::findParameter(bool registered, uint8_t msb, uint8_t lsb)noexcept
+{
+	return const_cast<ParameterValue*>(std::as_const(*this).findParameter(registered, msb, lsb));
+}
 std::optional<uint8_t> MidiChannel::getRPN_MSB(uint8_t msb, uint8_t lsb)const noexcept
 {
-	auto found = ccRPNs.find((static_cast<uint16_t>(msb) << 8) | lsb);
-	return found != ccRPNs.end() ? std::make_optional<uint8_t>(found->second.first) : std::nullopt;
+	auto param = findParameter(true, msb, lsb);
+	return param ? param->msb : std::nullopt;
 }
 std::optional<uint8_t> MidiChannel::getRPN_LSB(uint8_t msb, uint8_t lsb)const noexcept
 {
-	auto found = ccRPNs.find((static_cast<uint16_t>(msb) << 8) | lsb);
-	return found != ccRPNs.end() ? found->second.second : std::nullopt;
+	auto param = findParameter(true, msb, lsb);
+	return param ? param->lsb : std::nullopt;
 }
 std::optional<uint8_t> MidiChannel::getNRPN_MSB(uint8_t msb, uint8_t lsb)const noexcept
 {
-	auto found = ccNRPNs.find((static_cast<uint16_t>(msb) << 8) | lsb);
-	return found != ccNRPNs.end() ? std::make_optional<uint8_t>(found->second.first) : std::nullopt;
+	auto param = findParameter(false, msb, lsb);
+	return param ? param->msb : std::nullopt;
 }
 std::optional<uint8_t> MidiChannel::getNRPN_LSB(uint8_t msb, uint8_t lsb)const noexcept
 {
-	auto found = ccNRPNs.find((static_cast<uint16_t>(msb) << 8) | lsb);
-	return found != ccNRPNs.end() ? found->second.second : std::nullopt;
+	auto param = findParameter(false, msb, lsb);
+	return param ? param->lsb : std::nullopt;
 }
-void MidiChannel::updatePitchBend()
+void MidiChannel::updateTuning()
 {
-	auto pitchBendSensitivity = getRPN_MSB(0, 0).value_or(2);
+	mPitchBendSensitivity = getRPN_MSB(0, 0).value_or(2);
 	auto masterCoarseTuning = getRPN_MSB(0, 2).value_or(64) - 64;
 	auto masterFineTuning = ((getRPN_MSB(0, 1).value_or(64) - 64) * 128 + (getRPN_LSB(0, 1).value_or(64) - 64)) / 8192.f;
-	mCalculatedPitchBend 
-		= pitchBendSensitivity * (mRawPitchBend / 8192.0f)
-		+ masterCoarseTuning
-		+ masterFineTuning;
+	mMasterTuning = masterCoarseTuning + masterFineTuning;
+	// RPN(0,7) : パーノート ピッチベンドセンシティビティ (既定値 : 48半音)
+	mPerNotePitchBendSensitivity = getRPN_MSB(0, 7).value_or(48);
+}
+void MidiChannel::updatePitchBend()
+{
+	mCalculatedPitchBend = mPitchBendSensitivity * mRawPitchBend + mMasterTuning;
 
 	for (auto& kvp : mVoices) {
-		kvp.second->setPitchBend(mCalculatedPitchBend);
+		kvp.second.base().setPitchBend(mCalculatedPitchBend);
 	}
 }
 void MidiChannel::updateHold()
 {
 	for (auto& [id, voice] : mVoices) {
-		voice->setHold(ccPedal);
+		voice.setHold(ccPedal);
 	}
 }
 float MidiChannel::calcEGTimeScale(uint8_t ccValue)
@@ -508,6 +697,19 @@ float MidiChannel::calcEGTimeScale(uint8_t ccValue)
 	// 中心值64で等倍(1.0)、最小値で0で約x0.006、最大值127で約x190
 	return powf(10.0f, (ccValue / 128.f - 0.5f) * 4.556f);
 }
+void MidiChannel::updateEGTimeScale()
+{
+	mAttackTimeScale = calcEGTimeScale(ccAttackTime);
+	mDecayTimeScale = calcEGTimeScale(ccDecayTime);
+
+	// NRPN (1, 99/100) : GS/XGのパート別アタック/ディケイタイムオフセット
+	mNrpnAttackTimeScale = 1.0f;
+	mNrpnDecayTimeScale = 1.0f;
+	if(mSystemType.isGS() || mSystemType.isXG()) {
+		mNrpnAttackTimeScale = calcEGTimeScale(getNRPN_MSB(1, 99).value_or(64));
+		mNrpnDecayTimeScale = calcEGTimeScale(getNRPN_MSB(1, 100).value_or(64));
+	}
+}
 float MidiChannel::calcReleaseTimeScale()const
 {
 	float scale = calcEGTimeScale(ccReleaseTime);
@@ -519,12 +721,15 @@ float MidiChannel::calcReleaseTimeScale()const
 }
 void MidiChannel::updateReleaseTime()
 {
-	float scale = calcReleaseTimeScale();
+	mReleaseTimeScale = calcReleaseTimeScale();
+	// ドラムパートのボイスはノートオン時と同様にリリースタイムのスケーリングを適用しない
+	// (ドラムモードの切り替え時には発音中のボイスが消去されるため、チャネル単位で判定できる)
+	if (mIsDrumPart) return;
 	for (auto& [id, voice] : mVoices) {
-		voice->setReleaseTimeScale(scale);
+		voice.setReleaseTimeScale(mReleaseTimeScale);
 	}
 }
-float MidiChannel::calcFilterCutoff(float noteFreq)const
+float MidiChannel::calcFilterCutoffScale()const
 {
 	// CC#74 (Brightness) → ローパスフィルタのカットオフ周波数
 	// CC値を対数スケーリングでカットオフ周波数に変換します
@@ -541,7 +746,11 @@ float MidiChannel::calcFilterCutoff(float noteFreq)const
 		nrpnScale = exp2f(nrpnOffset / 16.f); // ±4オクターブ
 	}
 
-	float cutoff = noteFreq * ccRate * nrpnScale;
+	return ccRate * nrpnScale;
+}
+float MidiChannel::filterCutoff(float noteFreq)const noexcept
+{
+	float cutoff = noteFreq * mFilterCutoffScale;
 
 	// ナイキスト周波数以下に制限
 	float nyquist = mSampleFreq / 2.f;
@@ -573,21 +782,41 @@ float MidiChannel::calcFilterQ()const
 }
 void MidiChannel::updateFilter()
 {
-	float Q = calcFilterQ();
+	mFilterCutoffScale = calcFilterCutoffScale();
+	mFilterQ = calcFilterQ();
 	for (auto& [id, voice] : mVoices) {
-		float noteFreq = 440.f * exp2f((voice->soundingNoteNo() - 69.f) / 12.f);
-		float cutoff = calcFilterCutoff(noteFreq);
-		voice->setFilter(cutoff, Q);
+		float noteFreq = 440.f * exp2f((voice.base().soundingNoteNo() - 69.f) / 12.f);
+		voice.base().setFilter(filterCutoff(noteFreq), mFilterQ);
 	}
 }
 void MidiChannel::updateVibrato()
 {
-	float rate = calcVibratoRate();
-	float depth = calcVibratoDepth();
-	float delay = calcVibratoDelay();
+	mVibratoRate = calcVibratoRate();
+	mVibratoDepth = calcVibratoDepth();
+	mVibratoDelay = calcVibratoDelay();
 	for (auto& [id, voice] : mVoices) {
-		voice->setVibrato(rate, depth, delay);
+		voice.setVibrato(mVibratoRate, mVibratoDepth, mVibratoDelay);
+	}
+}
+void MidiChannel::updateDrumNote(uint8_t noteNo)
+{
+	if(noteNo >= 128) return;
+	auto& param = mDrumNoteParams[noteNo];
+
+	// NRPN (24, noteNo) : ドラムピッチ粗調整 (中心値64 = 変化なし、±半音単位)
+	// NRPN (25, noteNo) : ドラムピッチ微調整 (中心値64 = 変化なし、±1半音の範囲)
+	float coarseOffset = static_cast<float>(getNRPN_MSB(24, noteNo).value_or(64) - 64);
+	float fineOffset = (getNRPN_MSB(25, noteNo).value_or(64) - 64) / 64.0f;
+	param.pitchOffset = coarseOffset + fineOffset;
+
+	// NRPN (26, noteNo) : ドラムレベル (0-127、デフォルト127相当)
+	param.level = 1.0f;
+	if(auto drumLevel = getNRPN_MSB(26, noteNo)) {
+		param.level = *drumLevel / 127.0f;
 	}
+
+	// NRPN (28, noteNo) : ドラムパン (ランダムパンはノートオン毎に決定するため、値のみ保持する)
+	param.pan = getNRPN_MSB(28, noteNo);
 }
 float MidiChannel::calcVibratoRate()const
 {
@@ -637,22 +866,77 @@ void MidiChannel::updateSostenuto()
 		// ソステヌートON: 現在キーが押下中のボイスのみをソステヌート対象にする
 		// isNoteOn()はnoteOff未受信かつリリース/止音状態でないことを確認する
 		for (auto& [id, voice] : mVoices) {
-			if (voice->isNoteOn()) {
-				voice->setSostenuto(true);
+			if (voice.isNoteOn()) {
+				voice.setSostenuto(true);
 			}
 		}
 	} else {
 		// ソステヌートOFF: 全ボイスのソステヌートを解除
 		// Hold(CC:64)も無効であれば、保留中のnoteOffが実行される
 		for (auto& [id, voice] : mVoices) {
-			voice->setSostenuto(false);
+			voice.setSostenuto(false);
 		}
 	}
 }
 void MidiChannel::setDrumMode(bool isDrum)
 {
 	if(mIsDrumPart != isDrum) {
-		mVoices.clear();
+		clearVoices();
 		mIsDrumPart = isDrum;
+		resolveInstrument();
+	}
+}
+void MidiChannel::setInstrumentTable(const InstrumentTable& instrumentTable, uint64_t generation)
+{
+	// 発音中のボイスはテンプレートから生成済みのため、以降のノートオンから新しいテーブルが適用される
+	mInstrumentTable = &instrumentTable;
+	mInstrumentGeneration = generation;
+	resolveInstrument();
+}
+uint64_t MidiChannel::oldestInstrumentGeneration()const noexcept
+{
+	uint64_t oldest = mInstrumentGeneration;
+	for (auto& [id, voice] : mVoices) {
+		oldest = std::min(oldest, voice.base().instrumentGeneration());
+	}
+	return oldest;
+}
+void MidiChannel::resolveInstrument()
+{
+	// テーブルに該当する音色が無い場合の既定値
+	static const MelodyParam defaultMelodyParam;
+
+	// フォールバック検索とテンプレート生成はここ(ドラムは drumTemplate)でのみ行い、ノートオン時はテンプレートを参照する
+	// ドラムはバンクセレクト毎に全ノート分を生成しないよう、無効化のみ行う
+	if(mIsDrumPart) {
+		mDrumTemplatesResolved.reset();
+	} else {
+		auto found = mInstrumentTable->findMelodyParam(toInstrumentSystemType(mSystemType), ccBankSelectMSB, ccBankSelectLSB, mProgId);
+		mMelodyTemplate = MelodyVoiceTemplate::compile(found ? *found : defaultMelodyParam);
+	}
+
+	// SoundFont : 該当するプリセットがあればサンプルを再生する
+	// ドラムはパーカッション用バンクのプログラム(ドラムセット)、メロディはバンクセレクトMSBをバンク番号とし、無ければ既定のバンク/セットへフォールバックする
+	mSamplePreset = nullptr;
+	if(const auto& soundFont = mInstrumentTable->soundFont()) {
+		if(mIsDrumPart) {
+			mSamplePreset = soundFont->findPreset(SoundFont::PERCUSSION_BANK, mProgId);
+			if(!mSamplePreset) mSamplePreset = soundFont->findPreset(SoundFont::PERCUSSION_BANK, 0);
+		} else {
+			mSamplePreset = soundFont->findPreset(ccBankSelectMSB, mProgId);
+			if(!mSamplePreset) mSamplePreset = soundFont->findPreset(0, mProgId);
+		}
+	}
+}
+const DrumVoiceTemplate& MidiChannel::drumTemplate(uint8_t noteNo)
+{
+	// テーブルに該当する音色が無い場合の既定値
+	static const DrumParam defaultDrumParam;
+
+	if(!mDrumTemplatesResolved.test(noteNo)) {
+		auto found = mInstrumentTable->findDrumParam(toInstrumentSystemType(mSystemType), ccBankSelectMSB, ccBankSelectLSB, noteNo);
+		mDrumTemplates[noteNo] = DrumVoiceTemplate::compile(found ? *found : defaultDrumParam);
+		mDrumTemplatesResolved.set(noteNo);
 	}
+	return mDrumTemplates[noteNo];
 }
\ No newline at end of file
@@ -5,15 +5,15 @@
 #include <lsp/midi/message.hpp>
 #include <lsp/synth/instrument_table.hpp>
 #include <lsp/synth/voice.hpp>
+#include <lsp/synth/voice_template.hpp>
+#include <lsp/dsp/noise_generator.hpp>
 #include <array>
-#include <random>
+#include <bitset>
 
 namespace lsp::synth
 {
 class WaveTable;
 
-using StereoFrame = std::pair<float, float>;
-
 class MidiChannel
 	: non_copy
 {
@@ -29,6 +29,8 @@ public:
 		float channelPressure = 1.0f; // チャネルプレッシャー
 		float pitchBend = 0.0f; // ピッチベンド(ピッチベンドセンシティビティ考慮済み)
 		uint8_t modulation = 0; // モジュレーション(CC#1)
+		float reverbSend = 40.0f / 127.0f; // リバーブセンドレベル(CC#91)
+		float chorusSend = 0.0f; // コーラスセンドレベル(CC#93)
 		size_t poly = 0; // 同時発音数
 		uint8_t attackTime = 64; // アタックタイム
 		uint8_t decayTime = 64; // ディケイタイム
@@ -59,33 +61,95 @@ public:
 	void channelPressure(uint8_t value);
 	void polyphonicKeyPressure(uint8_t noteNo, uint8_t value);
 	void pitchBend(int16_t pitch);
+	// --- 高解像度 (MIDI 2.0) ---
+	// pitch : ノートオンの属性で指定された音高 (ノート番号単位, 小数部含む)
+	void noteOnHighRes(uint8_t noteNo, uint16_t vel, std::optional<float> pitch = std::nullopt);
+	void controlChangeHighRes(uint8_t ctrlNo, uint32_t value);
+	void channelPressureHighRes(uint32_t value);
+	void polyphonicKeyPressureHighRes(uint8_t noteNo, uint32_t value);
+	void pitchBendHighRes(uint32_t pitch);
+	void perNotePitchBend(uint8_t noteNo, uint32_t pitch);
+	void resetPerNoteControllers(uint8_t noteNo);
+	// RPN(registered=true) / NRPN の値を直接設定します
+	void parameterChange(bool registered, uint8_t msb, uint8_t lsb, uint32_t value);
 	void updateHold();
 	void updateSostenuto();
 	void setDrumMode(bool isDrumMode);
+	// インストゥルメント情報テーブルを差し替えます (発音中のボイスには影響しない)
+	// テーブルは再度差し替えられ、かつ oldestInstrumentGeneration() が generation を超えるまで呼び出し元が保持すること
+	void setInstrumentTable(const InstrumentTable& instrumentTable, uint64_t generation);
+	// 発音中のボイス(および現在のテーブル)が参照しているインストゥルメント情報テーブルのうち、最も古い世代を取得します
+	uint64_t oldestInstrumentGeneration()const noexcept;
 	// ---
-	StereoFrame update();
+	// 一度に生成できる最大フレーム数
+	static constexpr size_t MAX_RENDER_FRAMES = 64;
+	// 発音中の全ボイスを frames (MAX_RENDER_FRAMES 以下) フレーム分生成し、left/right へ書き込みます
+	void render(float* left, float* right, size_t frames);
+	// エフェクトへのセンドレベルを取得します [0.0, 1.0]
+	float reverbSend()const noexcept { return ccReverbSend; }
+	float chorusSend()const noexcept { return ccChorusSend; }
 	// ---
 	Digest digest()const;
 	// ---
 
 private:
-	// ボイスを生成します
-	std::unique_ptr<Voice> createVoice(uint8_t noteNo, uint8_t vel);
-	std::unique_ptr<Voice> createMelodyVoice(uint8_t noteNo, uint8_t vel);
-	std::unique_ptr<Voice> createDrumVoice(uint8_t noteNo, uint8_t vel);
+	// ノートオン共通処理 (vel : [0.0, 1.0], 0 の場合はノートオフのみ)
+	void startNote(uint8_t noteNo, float vel, std::optional<float> pitch);
+
+	// 発音中ボイスの登録・破棄 (ノート番号索引も併せて更新します)
+	// MEMO ボイスは具象型のまま mVoices のノード内に直接構築する
+	//      (ノード自体の確保は残るが、ボイス毎の unique_ptr による個別の確保と仮想呼び出しを避けるため)
+	template<class V, class... Args>
+	AnyVoice& emplaceVoice(uint8_t noteNo, Args&&... args)
+	{
+		auto [iter, inserted] = mVoices.emplace(
+			std::piecewise_construct,
+			std::forward_as_tuple(VoiceId::issue()),
+			std::forward_as_tuple(std::in_place_type<V>, mSampleFreq, static_cast<float>(noteNo), mCalculatedPitchBend, std::forward<Args>(args)...)
+		);
+		auto& voice = iter->second;
+		voice.base().setInstrumentGeneration(mInstrumentGeneration);
+		mNoteVoices[noteIndexOf(voice.base())].push_back(&voice);
+		return voice;
+	}
+	void clearVoices();
+	// 発音中ボイスのノート番号を変更します (モノモードのレガート用)
+	void changeVoiceNote(AnyVoice& voice, uint8_t noteNo);
+	static uint8_t noteIndexOf(const Voice& voice) noexcept { return static_cast<uint8_t>(voice.noteNo()) & 0x7F; }
+
+	// ボイスを生成します (vel : [0.0, 1.0])
+	// 生成したボイスは発音中ボイスとして登録済みの状態で返します (生成できない場合は nullptr)
+	AnyVoice* createVoice(uint8_t noteNo, float vel, std::optional<float> pitch);
+	AnyVoice* createMelodyVoice(uint8_t noteNo, float vel);
+	AnyVoice* createDrumVoice(uint8_t noteNo, float vel);
+	AnyVoice* createSampleVoice(uint8_t noteNo, float vel);
 
+	// プログラム, バンクセレクト, システム種別, ドラムモードから有効な音色を解決し、ボイステンプレートを生成します
+	// ドラムパートではテンプレートを無効化するのみとし、各ノートの初回のノートオン時に drumTemplate() で解決します
+	void resolveInstrument();
+	const DrumVoiceTemplate& drumTemplate(uint8_t noteNo);
+
+	// RPN/NRPN の値が変更された際に、導出パラメータを再計算し即時反映が必要なものを更新します
+	void onParameterChanged(bool registered, uint8_t msb, uint8_t lsb);
+
+	// 導出パラメータを再計算し、発音中のボイスへ反映します
+	void updateTuning();
 	void updatePitchBend();
+	void updateEGTimeScale();
 	void updateReleaseTime();
 	void updateFilter();
 	void updateVibrato();
+	void updateDrumNote(uint8_t noteNo);
 
 	// CC 72/73/75 および対応するNRPNからEGタイムスケーリング係数を計算します
 	static float calcEGTimeScale(uint8_t ccValue);
 	float calcReleaseTimeScale()const;
 
 	// CC 71/74 および対応するNRPN(1,32/33)からフィルタパラメータを計算します
-	float calcFilterCutoff(float noteFreq)const;
+	float calcFilterCutoffScale()const;
 	float calcFilterQ()const;
+	// 基本周波数に対するカットオフ周波数を取得します (導出済みの値を用いる)
+	float filterCutoff(float noteFreq)const noexcept;
 
 	// CC#1 および対応するNRPN(1,8/9/10)からビブラートパラメータを計算します
 	float calcVibratoRate()const;
@@ -93,6 +157,15 @@ private:
 	float calcVibratoDelay()const;
 
 	// RPN and NRPN
+	struct ParameterValue
+	{
+		std::optional<uint8_t> msb; // Data Entry MSB
+		std::optional<uint8_t> lsb; // Data Entry LSB
+	};
+	// 値を保持するRPN/NRPNの格納先を取得します (使用しないパラメータの場合は nullptr)
+	const ParameterValue* findParameter(bool registered, uint8_t msb, uint8_t lsb)const noexcept;
+	ParameterValue* findParameter(bool registered, uint8_t msb, uint8_t lsb)noexcept;
+
 	std::optional<uint8_t> getRPN_MSB(uint8_t msb, uint8_t lsb)const noexcept;
 	std::optional<uint8_t> getRPN_LSB(uint8_t msb, uint8_t lsb)const noexcept;
 
@@ -104,13 +177,16 @@ private:
 	const uint32_t mSampleFreq;
 	// チャネル番号(実行時に動的にセット)
 	const uint8_t mMidiCh;
-	// インストゥルメント情報テーブル
-	const InstrumentTable& mInstrumentTable;
+	// インストゥルメント情報テーブル (所有権は Synthesizer が持つ)
+	const InstrumentTable* mInstrumentTable;
+	uint64_t mInstrumentGeneration = 0;
 	// 乱数エンジン
-	std::mt19937 mRandomEngine;
+	dsp::Pcg32 mRandomEngine;
 
 	// 発音中のボイス
-	std::unordered_map<VoiceId, std::unique_ptr<Voice>> mVoices;
+	std::unordered_map<VoiceId, AnyVoice> mVoices;
+	// ノート番号毎の発音中ボイス (mVoices の索引. 要素の所有権は mVoices が持つ)
+	std::array<std::vector<AnyVoice*>, 128> mNoteVoices;
 
 	// システムリセット種別
 	midi::SystemType mSystemType;
@@ -119,6 +195,12 @@ private:
 	uint8_t mProgId; // プログラムId
 	bool mIsDrumPart = false;
 
+	// 解決済みの音色から生成したボイステンプレート
+	MelodyVoiceTemplate mMelodyTemplate;
+	std::array<DrumVoiceTemplate, 128> mDrumTemplates; // ノート番号毎 (ドラムパート時のみ解決)
+	std::bitset<128> mDrumTemplatesResolved; // mDrumTemplates のうち解決済みのもの
+	const SoundFont::Preset* mSamplePreset = nullptr; // SoundFont の該当プリセット (無い場合は波形メモリで発音)
+
 	// コントロールチェンジ
 	uint8_t ccPrevCtrlNo;
 	uint8_t ccPrevValue;
@@ -135,6 +217,8 @@ private:
 	uint8_t ccDecayTime;	// CC:75 - ディケイタイム
 	uint8_t ccResonance;	// CC:71 - レゾナンス (ハーモニックコンテント)
 	uint8_t ccBrightness;	// CC:74 - ブライトネス (カットオフ)
+	float ccReverbSend;		// CC:91 - リバーブセンドレベル [0.0, +1.0]
+	float ccChorusSend;		// CC:93 - コーラスセンドレベル [0.0, +1.0]
 
 	// チャネルモードメッセージ
 	bool mMonoMode;         // CC:126/127 - モノ/ポリモード
@@ -144,9 +228,12 @@ private:
 	float mChannelPressure;
 
 	// ピッチベンド
-	int16_t mRawPitchBend;
+	float mRawPitchBend; // [-1.0, +1.0)
 	float mCalculatedPitchBend;
 
+	// パーノート ピッチベンド [-1.0, +1.0) (MIDI 2.0)
+	std::array<float, 128> mPerNotePitchBend;
+
 	// RPN/NRPN State
 	std::optional<uint8_t> ccRPN_MSB;
 	std::optional<uint8_t> ccRPN_LSB;
@@ -155,8 +242,32 @@ private:
 	std::optional<uint8_t> ccDE_MSB;
 	std::optional<uint8_t> ccDE_LSB;
 
-	std::unordered_map<uint16_t, std::pair<uint8_t, std::optional<int8_t>>> ccRPNs;
-	std::unordered_map<uint16_t, std::pair<uint8_t, std::optional<int8_t>>> ccNRPNs;
+	// RPN/NRPN 値 : 使用するパラメータのみ固定長で保持する
+	std::array<ParameterValue, 4> mRPNs;	// (0,0) (0,1) (0,2) (0,7)
+	std::array<ParameterValue, 8> mNRPNs;	// (1,8) (1,9) (1,10) (1,32) (1,33) (1,99) (1,100) (1,102)
+	std::array<std::array<ParameterValue, 128>, 4> mDrumNRPNs; // (24,n) (25,n) (26,n) (28,n) : n = ノート番号
+
+	// 導出パラメータ : RPN/NRPN および関連するCCの変更時にのみ再計算する
+	float mPitchBendSensitivity;		// RPN(0,0) [半音]
+	float mMasterTuning;				// RPN(0,1) + RPN(0,2) [半音]
+	float mPerNotePitchBendSensitivity;	// RPN(0,7) [半音]
+	float mAttackTimeScale;				// CC#73
+	float mDecayTimeScale;				// CC#75
+	float mNrpnAttackTimeScale;			// NRPN(1,99)
+	float mNrpnDecayTimeScale;			// NRPN(1,100)
+	float mReleaseTimeScale;			// CC#72 × NRPN(1,102)
+	float mFilterCutoffScale;			// CC#74 × NRPN(1,32)
+	float mFilterQ;						// CC#71 + NRPN(1,33)
+	float mVibratoRate;					// NRPN(1,8)
+	float mVibratoDepth;				// CC#1 × NRPN(1,9)
+	float mVibratoDelay;				// NRPN(1,10)
+	struct DrumNoteParam
+	{
+		float pitchOffset = 0;		// NRPN(24,n) + NRPN(25,n) [半音]
+		float level = 1.0f;			// NRPN(26,n)
+		std::optional<uint8_t> pan;	// NRPN(28,n) (0 = ランダム)
+	};
+	std::array<DrumNoteParam, 128> mDrumNoteParams;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+﻿#include <lsp/synth/midi_channel.hpp>
+
+using namespace lsp::synth;
+
+AnyVoice* MidiChannel::createSampleVoice(uint8_t noteNo, float vel)
+{
+	// 主要パラメータ (プログラム/バンク変更時に解決済みのプリセットから、ノート番号・ベロシティに該当するゾーンを選ぶ)
+	// MEMO 複数のゾーンが該当する場合(レイヤー)は先頭のゾーンのみ発音する
+	const auto vel7 = static_cast<uint8_t>(std::clamp(std::lround(vel * 127.f), 0L, 127L));
+	const SampleZone* zone = mSamplePreset->findZone(noteNo, vel7);
+	if(!zone) return nullptr;
+
+	float a = zone->attack;
+	float h = zone->hold;
+	float d = zone->decay;
+	float s = zone->sustain;
+	float r = zone->release;
+	float pan = zone->pan;
+	float level = 1.0f;
+
+	// スケールチューニング : ルートキーからの距離に応じて音程変化量を調整する
+	float noteOffset = (static_cast<float>(noteNo) - zone->rootKey) * (zone->scaleTuning - 1.0f);
+
+	// CC 72/73/75 によるEGタイム調整（全システムタイプで適用）
+	// NRPN (1, 99/100) によるアタック/ディケイタイム調整 (GS/XG, それ以外では等倍)
+	float attackScale = mAttackTimeScale * mNrpnAttackTimeScale;
+	float decayScale = mDecayTimeScale * mNrpnDecayTimeScale;
+	if(mIsDrumPart) {
+		// ドラムは元々長いDecayを持つ楽器があるため、スケール係数を制限する (最大4倍)
+		attackScale = std::min(mAttackTimeScale, 4.0f);
+		decayScale = std::min(mDecayTimeScale, 4.0f);
+
+		// NRPN (24/25/26/28, noteNo) : ドラム ピッチ / レベル / パン (導出済み)
+		const auto& noteParam = mDrumNoteParams[noteNo & 0x7F];
+		noteOffset += noteParam.pitchOffset;
+		level = noteParam.level;
+		if(noteParam.pan) {
+			// value 0 = ランダム、1 = 左端、64 = 中央、127 = 右端
+			uint8_t panValue = *noteParam.pan;
+			if(panValue == 0) {
+				pan = static_cast<float>(1 + mRandomEngine.nextBounded(127)) / 127.f;
+			} else {
+				pan = std::clamp((panValue - 1) / 126.0f, 0.0f, 1.0f);
+			}
+		}
+	}
+	a *= attackScale;
+	d *= decayScale;
+
+	// MEMO 人間の聴覚ではボリュームは対数的な特性を持つため、ベロシティを指数的に補正する
+	float volume = powf(10.f, -20.f * (1.f - vel) / 20.f) * zone->volume * level;
+	float thresholdLevel = 0.01f;  // ほぼ無音を長々再生するのを防ぐため、ほぼ聞き取れないレベルまで落ちたら止音する
+	static const dsp::EnvelopeCurve<float> curveExp3(3.0f);
+
+	r *= mIsDrumPart ? 1.0f : mReleaseTimeScale;
+
+	auto setup = [&](auto& voice) {
+		voice.setNoteOffset(noteOffset);
+		if(mIsDrumPart || pan != 0.5f) {
+			voice.setPan(pan);
+		}
+		{
+			float noteFreq = 440.f * exp2f((noteNo + noteOffset - 69.f) / 12.f);
+			voice.setFilter(filterCutoff(noteFreq), mFilterQ);
+		}
+		voice.setBaseReleaseTime(zone->release);
+		if(!mIsDrumPart) {
+			voice.setVibrato(mVibratoRate, mVibratoDepth, mVibratoDelay);
+		}
+
+		auto& eg = voice.envelopeGenerator();
+		eg.setEnvelope(
+			static_cast<float>(mSampleFreq), curveExp3,
+			std::max(0.001f, a),
+			h,
+			std::max(0.001f, d),
+			s,
+			0.0f,
+			std::max(0.001f, r),
+			thresholdLevel
+		);
+		eg.noteOn();
+	};
+
+	// ストリーミングモードで常駐していない部分があるゾーンは、I/Oスレッドの先読みを用いて再生する
+	const auto& soundFont = mInstrumentTable->soundFont();
+	if(zone->isStreamed() && soundFont->streamer()) {
+		auto& emplaced = emplaceVoice<StreamedSampleVoice>(noteNo, volume, ccPedal, mSampleFreq, *soundFont, *zone);
+		setup(emplaced.get<StreamedSampleVoice>());
+		return &emplaced;
+	}
+	auto& emplaced = emplaceVoice<SampleVoice>(noteNo, volume, ccPedal, mSampleFreq, *soundFont, *zone);
+	setup(emplaced.get<SampleVoice>());
+	return &emplaced;
+}
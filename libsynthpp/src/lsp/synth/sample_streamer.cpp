@@ -0,0 +1,146 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#include <lsp/synth/sample_streamer.hpp>
+#include <lsp/synth/sound_font.hpp>
+
+using namespace lsp;
+using namespace lsp::synth;
+
+namespace
+{
+
+// I/Oスレッドが一度に読み込むフレーム数 (読み込み毎にレンダースレッドへ公開する)
+constexpr uint64_t READ_CHUNK_FRAMES = 4096;
+
+// 読み込み要求が無い場合の先読み間隔
+constexpr auto POLLING_INTERVAL = std::chrono::milliseconds(5);
+
+}
+
+SampleLoop SampleLoop::of(const SampleZone& zone)noexcept
+{
+	SampleLoop loop;
+	if(zone.loopMode != dsp::SampleLoopMode::None && zone.loopStart < zone.loopEnd && zone.loopEnd <= zone.data.size()) {
+		loop.looping = true;
+		loop.start = zone.loopStart;
+		loop.end = zone.loopEnd;
+	}
+	return loop;
+}
+
+SampleStream::SampleStream(size_t ringFrames)
+	: mRing(std::make_unique<float[]>(std::bit_ceil(ringFrames)))
+	, mMask(std::bit_ceil(ringFrames) - 1)
+{
+	lsp_require(ringFrames > 0);
+}
+
+SampleStreamer::SampleStreamer(size_t streamCount, size_t ringFrames)
+	: mThreadPool(1, ThreadPriority::AboveNormal)
+{
+	lsp_require(streamCount > 0);
+
+	mStreams.reserve(streamCount);
+	for(size_t i = 0; i < streamCount; ++i) {
+		mStreams.emplace_back(std::make_unique<SampleStream>(ringFrames));
+	}
+	mWorker = mThreadPool.enqueue([this] { run(); });
+}
+
+SampleStreamer::~SampleStreamer()
+{
+	mStopping = true;
+	mRequested.set();
+	mWorker.wait();
+}
+
+SampleStream* SampleStreamer::open(const SampleZone& zone, uint64_t from)noexcept
+{
+	for(auto& stream : mStreams) {
+		// ストリーマは SoundFont と共に複数のシンセサイザ(レンダースレッド)から共有され得るため、取得は CAS で行う
+		auto expected = SampleStream::State::Free;
+		if(!stream->mState.compare_exchange_strong(expected, SampleStream::State::Opening, std::memory_order_acq_rel)) continue;
+
+		stream->mData = zone.data;
+		stream->mLinked = zone.linked;
+		stream->mLoop = SampleLoop::of(zone);
+		stream->mReadPos.store(from, std::memory_order_relaxed);
+		stream->mWritePos.store(from, std::memory_order_relaxed);
+		stream->mReleasePos.store(SampleLoop::NO_RELEASE, std::memory_order_relaxed);
+		stream->mReleaseApplied.store(false, std::memory_order_relaxed);
+		stream->mState.store(SampleStream::State::Active, std::memory_order_release);
+
+		mRequested.set();
+		return stream.get();
+	}
+	return nullptr;
+}
+
+void SampleStreamer::close(SampleStream* stream)noexcept
+{
+	if(!stream) return;
+	// I/Oスレッドが先読み中の可能性があるため、Free への遷移はI/Oスレッドに任せる
+	stream->mState.store(SampleStream::State::Closing, std::memory_order_release);
+}
+
+void SampleStreamer::release(SampleStream* stream, uint64_t pos)noexcept
+{
+	if(!stream) return;
+	stream->mReleasePos.store(pos, std::memory_order_release);
+	mRequested.set();
+}
+
+void SampleStreamer::run()
+{
+	while(!mStopping) {
+		for(auto& stream : mStreams) {
+			switch(stream->mState.load(std::memory_order_acquire)) {
+			case SampleStream::State::Active:
+				fill(*stream);
+				break;
+			case SampleStream::State::Closing:
+				stream->mState.store(SampleStream::State::Free, std::memory_order_release);
+				break;
+			default:
+				break;
+			}
+		}
+		// 新たなストリームの開始時は即座に、それ以外は一定間隔で先読みする
+		mRequested.wait_for(POLLING_INTERVAL);
+	}
+}
+
+void SampleStreamer::fill(SampleStream& stream)
+{
+	uint64_t write = stream.mWritePos.load(std::memory_order_relaxed);
+
+	// ループを抜けた場合 : 先読み済みのループ区間を破棄し、ループ終端からの続きを読み込み直す
+	const uint64_t releasePos = stream.mReleasePos.load(std::memory_order_acquire);
+	if(releasePos != SampleLoop::NO_RELEASE && !stream.mReleaseApplied.load(std::memory_order_relaxed)) {
+		write = std::min(write, releasePos);
+		stream.mWritePos.store(write, std::memory_order_relaxed);
+		stream.mReleaseApplied.store(true, std::memory_order_release);
+	}
+
+	// リングバッファの空き領域を埋める (ループしない場合はサンプルの終端まで)
+	// 常駐部分のみで再生している間に消費済みとなった位置は読み込まない
+	const uint64_t capacity = stream.mMask + 1;
+	const uint64_t read = stream.mReadPos.load(std::memory_order_acquire);
+	const uint64_t limit = std::min(read + capacity, stream.mLoop.sequenceEndOf(stream.mData.size(), releasePos));
+	if(write < read) {
+		write = read;
+		stream.mWritePos.store(write, std::memory_order_release);
+	}
+
+	while(write < limit) {
+		const uint64_t end = std::min(limit, write + READ_CHUNK_FRAMES);
+		for(; write < end; ++write) {
+			stream.mRing[write & stream.mMask] = dsp::SamplePlayer<float>::sampleAt(stream.mData, stream.mLinked, stream.mLoop.sourceIndexOf(write, releasePos));
+		}
+		stream.mWritePos.store(write, std::memory_order_release);
+
+		// 再生終了したストリームの読み込みは打ち切る
+		if(stream.mState.load(std::memory_order_relaxed) != SampleStream::State::Active) break;
+	}
+}
@@ -0,0 +1,138 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/util/auto_reset_event.hpp>
+#include <lsp/util/thread_pool.hpp>
+
+namespace lsp::synth
+{
+
+struct SampleZone;
+
+// ストリーミング再生時のループ区間
+// ストリーミング時は再生順に先読みするため、ループを展開した再生順の位置(シーケンス位置)で扱います。
+// UntilRelease の場合、ノートオフ時点の周回の終端(releasePos)以降はループを抜け、ループ終端からの続きとなります。
+struct SampleLoop
+{
+	static constexpr uint64_t NO_RELEASE = std::numeric_limits<uint64_t>::max();
+
+	bool looping = false;
+	size_t start = 0;
+	size_t end = 0;
+
+	static SampleLoop of(const SampleZone& zone)noexcept;
+
+	// シーケンス位置 → サンプルデータ内の位置
+	size_t sourceIndexOf(uint64_t pos, uint64_t releasePos = NO_RELEASE)const noexcept
+	{
+		if(!looping || pos < end) return static_cast<size_t>(pos);
+		if(pos >= releasePos) return end + static_cast<size_t>(pos - releasePos);
+		return start + static_cast<size_t>((pos - end) % (end - start));
+	}
+	// サンプルデータの終端に対応するシーケンス位置 (ループし続ける場合は NO_RELEASE)
+	uint64_t sequenceEndOf(size_t size, uint64_t releasePos = NO_RELEASE)const noexcept
+	{
+		if(!looping) return size;
+		if(releasePos == NO_RELEASE) return NO_RELEASE;
+		return releasePos + (size - end);
+	}
+};
+
+// ストリーミング再生用のサンプルストリーム
+// I/Oスレッド(供給側)とレンダースレッド(消費側)の間の、単一生産者・単一消費者のリングバッファです。
+// 位置はゾーンの先頭からのシーケンス位置(ループを展開した再生順の位置)で表します。
+class SampleStream final
+	: non_copy_move
+{
+public:
+	explicit SampleStream(size_t ringFrames);
+
+	// 指定位置のサンプルを取得します (レンダースレッド)
+	// I/Oスレッドによる読み込みが追いついていない場合は std::nullopt を返します
+	std::optional<float> peek(uint64_t pos)const noexcept
+	{
+		// ループを抜けた後の位置は、I/Oスレッドが読み込み直すまで参照しない (先読み済みのループ区間が残っている可能性がある)
+		if(pos >= mReleasePos.load(std::memory_order_relaxed) && !mReleaseApplied.load(std::memory_order_acquire)) return {};
+		if(pos < mReadPos.load(std::memory_order_relaxed) || pos >= mWritePos.load(std::memory_order_acquire)) return {};
+		return mRing[pos & mMask];
+	}
+
+	// 指定位置より前のサンプルが不要になったことを通知します (レンダースレッド)
+	void consume(uint64_t pos)noexcept
+	{
+		if(pos > mReadPos.load(std::memory_order_relaxed)) {
+			mReadPos.store(pos, std::memory_order_release);
+		}
+	}
+
+private:
+	friend class SampleStreamer;
+
+	enum class State : uint8_t
+	{
+		Free,		// 未使用 (レンダースレッドが取得可能)
+		Opening,	// 取得済み (取得したレンダースレッドが読み込み元を設定中)
+		Active,		// 再生中 (I/Oスレッドが先読みする)
+		Closing,	// 再生終了 (I/Oスレッドが Free へ戻す)
+	};
+
+private:
+	// 読み込み元 (Opening の間に取得したレンダースレッドが設定する)
+	std::span<const int16_t> mData;
+	std::span<const int16_t> mLinked;
+	SampleLoop mLoop;
+
+	// リングバッファ (要素数は2の冪)
+	std::unique_ptr<float[]> mRing;
+	uint64_t mMask;
+	std::atomic<uint64_t> mWritePos = 0;	// 読み込み済みの終端 (I/Oスレッドが更新)
+	std::atomic<uint64_t> mReadPos = 0;		// 消費済みの位置 (レンダースレッドが更新)
+	std::atomic<uint64_t> mReleasePos = SampleLoop::NO_RELEASE;	// ループを抜ける位置 (レンダースレッドが設定)
+	std::atomic<bool> mReleaseApplied = false;	// mReleasePos 以降を読み込み直したか (I/Oスレッドが設定)
+	std::atomic<State> mState = State::Free;
+};
+
+// サンプルストリーマ
+// 常駐していないサンプルデータを、I/Oスレッドがストリーム毎のリングバッファへ先読みします。
+// ストリームは構築時に固定数を確保するため、レンダースレッドからの取得・解放でメモリ確保やロックは発生しません。
+// 読み込み元はメモリマップ領域であり、ページフォールトによるディスク読み込みはI/Oスレッド上でのみ発生します。
+class SampleStreamer final
+	: non_copy_move
+{
+public:
+	SampleStreamer(size_t streamCount, size_t ringFrames);
+	~SampleStreamer();
+
+	// ストリームを取得し、指定のシーケンス位置からの先読みを開始します (レンダースレッド)
+	// 空きストリームが無い場合は nullptr を返します
+	SampleStream* open(const SampleZone& zone, uint64_t from)noexcept;
+
+	// ストリームを解放します (レンダースレッド)
+	void close(SampleStream* stream)noexcept;
+
+	// 指定のシーケンス位置以降はループを抜け、ループ終端からの続きを先読みさせます (レンダースレッド, UntilRelease のノートオフ用)
+	void release(SampleStream* stream, uint64_t pos)noexcept;
+
+	// 先読みが間に合わなかった回数を記録・取得します
+	void notifyUnderrun()noexcept { mUnderruns.fetch_add(1, std::memory_order_relaxed); }
+	uint64_t underruns()const noexcept { return mUnderruns.load(std::memory_order_relaxed); }
+
+private:
+	void run();
+	void fill(SampleStream& stream);
+
+private:
+	std::vector<std::unique_ptr<SampleStream>> mStreams;
+	std::atomic<uint64_t> mUnderruns = 0;
+
+	// I/Oスレッド
+	std::atomic<bool> mStopping = false;
+	AutoResetEvent mRequested;
+	ThreadPool mThreadPool;
+	std::future<void> mWorker;
+};
+
+}
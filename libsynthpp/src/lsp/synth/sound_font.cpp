@@ -0,0 +1,416 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#include <lsp/synth/sound_font.hpp>
+
+#include <cstring>
+#include <map>
+
+using namespace lsp;
+using namespace lsp::synth;
+
+// TODO リトルエンディアンでの実行前提
+static_assert(std::endian::native == std::endian::little);
+
+namespace
+{
+
+// ジェネレータ種別 (SoundFont 2.04 8.1.2)
+enum Generator : uint16_t
+{
+	StartAddrsOffset = 0,
+	EndAddrsOffset = 1,
+	StartloopAddrsOffset = 2,
+	EndloopAddrsOffset = 3,
+	StartAddrsCoarseOffset = 4,
+	EndAddrsCoarseOffset = 12,
+	Pan = 17,
+	AttackVolEnv = 34,
+	HoldVolEnv = 35,
+	DecayVolEnv = 36,
+	SustainVolEnv = 37,
+	ReleaseVolEnv = 38,
+	Instrument = 41,
+	KeyRange = 43,
+	VelRange = 44,
+	StartloopAddrsCoarseOffset = 45,
+	InitialAttenuation = 48,
+	EndloopAddrsCoarseOffset = 50,
+	CoarseTune = 51,
+	FineTune = 52,
+	SampleID = 53,
+	SampleModes = 54,
+	ScaleTuning = 56,
+	OverridingRootKey = 58,
+	EndOper = 60,
+};
+// ゾーン毎のジェネレータ値 (未指定の場合は std::nullopt)
+using Generators = std::array<std::optional<uint16_t>, EndOper>;
+
+// RIFFチャンク
+struct Chunk
+{
+	std::string_view id;
+	std::span<const std::byte> data;
+};
+
+// チャンクの並びを読み出します
+std::vector<Chunk> readChunks(std::span<const std::byte> data)
+{
+	std::vector<Chunk> chunks;
+	while(!data.empty()) {
+		if(data.size() < 8) throw sound_font_exception("invalid sound font : truncated chunk");
+		uint32_t size;
+		std::memcpy(&size, data.data() + 4, sizeof(size));
+		if(size > data.size() - 8) throw sound_font_exception("invalid sound font : truncated chunk");
+		chunks.push_back({ { reinterpret_cast<const char*>(data.data()), 4 }, data.subspan(8, size) });
+		// チャンクは2バイト境界に配置される
+		data = data.subspan(std::min<size_t>(data.size(), 8 + size + (size & 1)));
+	}
+	return chunks;
+}
+const Chunk* findChunk(const std::vector<Chunk>& chunks, std::string_view id)
+{
+	auto found = std::ranges::find(chunks, id, &Chunk::id);
+	return found != chunks.end() ? &*found : nullptr;
+}
+// LIST チャンクの内容 (種別, 子チャンク) を読み出します
+std::pair<std::string_view, std::vector<Chunk>> readList(const Chunk& chunk)
+{
+	if(chunk.id != "LIST" || chunk.data.size() < 4) throw sound_font_exception("invalid sound font : broken list");
+	return { { reinterpret_cast<const char*>(chunk.data.data()), 4 }, readChunks(chunk.data.subspan(4)) };
+}
+
+// 固定長レコードの並び
+class Records
+{
+public:
+	Records(const std::vector<Chunk>& chunks, std::string_view id, size_t recordSize)
+		: mRecordSize(recordSize)
+	{
+		auto chunk = findChunk(chunks, id);
+		// 終端レコードを含め、最低1レコード必要
+		if(!chunk || chunk->data.size() % recordSize != 0 || chunk->data.size() < recordSize) {
+			throw sound_font_exception("invalid sound font : broken " + std::string(id));
+		}
+		mData = chunk->data;
+	}
+
+	// 終端レコードを含むレコード数
+	size_t size()const noexcept { return mData.size() / mRecordSize; }
+
+	template<class T>
+	T read(size_t index, size_t offset)const noexcept
+	{
+		T v;
+		std::memcpy(&v, mData.data() + index * mRecordSize + offset, sizeof(T));
+		return v;
+	}
+	std::string name(size_t index)const
+	{
+		// 20バイトの名前 (NUL終端, 20文字の場合は終端なし)
+		auto p = reinterpret_cast<const char*>(mData.data() + index * mRecordSize);
+		return std::string(p, std::find(p, p + 20, '\0'));
+	}
+
+private:
+	std::span<const std::byte> mData;
+	size_t mRecordSize;
+};
+
+// サンプルヘッダ
+struct SampleHeader
+{
+	uint32_t start;
+	uint32_t end;
+	uint32_t startLoop;
+	uint32_t endLoop;
+	uint32_t sampleRate;
+	uint8_t originalPitch;
+	int8_t pitchCorrection;
+	uint16_t sampleLink;
+	uint16_t sampleType;
+};
+
+// ゾーンの並びを読み出します (SoundFont 2.04 7.3, 7.7)
+// 先頭のゾーンが terminal (Instrument / SampleID) を持たない場合はグローバルゾーンとし、他のゾーンの既定値とします。
+std::vector<Generators> readZones(const Records& bags, const Records& gens, size_t firstBag, size_t lastBag, Generator terminal)
+{
+	if(firstBag > lastBag || lastBag >= bags.size()) throw sound_font_exception("invalid sound font : broken bag index");
+
+	std::vector<Generators> zones;
+	Generators global;
+	for(size_t bag = firstBag; bag < lastBag; ++bag) {
+		const size_t firstGen = bags.read<uint16_t>(bag, 0);
+		const size_t lastGen = bags.read<uint16_t>(bag + 1, 0);
+		if(firstGen > lastGen || lastGen >= gens.size()) throw sound_font_exception("invalid sound font : broken generator index");
+
+		Generators zone;
+		for(size_t gen = firstGen; gen < lastGen; ++gen) {
+			const auto oper = gens.read<uint16_t>(gen, 0);
+			if(oper < EndOper) zone[oper] = gens.read<uint16_t>(gen, 2);
+		}
+		if(!zone[terminal]) {
+			// グローバルゾーン (先頭以外で terminal を持たないゾーンは無視する)
+			if(bag == firstBag) global = zone;
+			continue;
+		}
+		for(size_t oper = 0; oper < EndOper; ++oper) {
+			if(!zone[oper]) zone[oper] = global[oper];
+		}
+		zones.push_back(zone);
+	}
+	return zones;
+}
+
+int32_t value(const Generators& g, Generator oper, int32_t def) noexcept
+{
+	return g[oper] ? static_cast<int16_t>(*g[oper]) : def;
+}
+std::pair<uint8_t, uint8_t> range(const Generators& g, Generator oper) noexcept
+{
+	const uint16_t v = g[oper].value_or(0x7F00);
+	return { static_cast<uint8_t>(v & 0xFF), static_cast<uint8_t>(v >> 8) };
+}
+// タイムセント → 秒
+float timecentsToSec(int32_t tc) noexcept
+{
+	return exp2f(static_cast<float>(std::clamp(tc, -12000, 8000)) / 1200.0f);
+}
+// センチベル(減衰量) → 振幅
+float centibelsToLevel(int32_t cb) noexcept
+{
+	return powf(10.0f, -static_cast<float>(std::clamp(cb, 0, 1440)) / 200.0f);
+}
+
+}
+
+SoundFont::SoundFont(const std::filesystem::path& path)
+{
+	try {
+		// サンプルデータはボイスが任意の位置から読み進めるため、順次読み込みのヒントは与えない (読み捨てや的外れな先読みを避ける)
+		mFile = MappedFile(path, MappedFile::AccessPattern::Normal);
+	} catch (const std::system_error&) {
+		throw sound_font_exception("invalid input");
+	}
+	parse();
+}
+SoundFont::SoundFont(const std::filesystem::path& path, const StreamingOptions& options)
+	: SoundFont(path)
+{
+	makeResident(options.residentFrames);
+	mStreamer = std::make_unique<SampleStreamer>(options.streamCount, options.ringFrames);
+}
+
+void SoundFont::makeResident(size_t residentFrames)
+{
+	// 常駐させる領域 : 同じ位置・長さの領域は複数のゾーンで共有する
+	std::map<std::pair<const int16_t*, size_t>, size_t> offsets;
+	auto reserve = [&](std::span<const int16_t> data) {
+		if(data.empty()) return;
+		auto [it, inserted] = offsets.try_emplace({ data.data(), std::min(data.size(), residentFrames) }, mResident.size());
+		if(inserted) mResident.resize(mResident.size() + it->first.second);
+	};
+	// UntilRelease の場合、ノートオフ後に再生するループ終端以降の先頭部分も常駐させる (ノートオフからストリームの読み込み直しまでの間に再生する)
+	auto releaseTail = [&](const SampleZone& zone, std::span<const int16_t> data) -> std::span<const int16_t> {
+		if(zone.loopMode != dsp::SampleLoopMode::UntilRelease || !SampleLoop::of(zone).looping || data.size() <= residentFrames) return {};
+		return data.subspan(zone.loopEnd);
+	};
+	for(auto& preset : mPresets) {
+		for(auto& zone : preset.zones) {
+			reserve(zone.data);
+			reserve(zone.linked);
+			reserve(releaseTail(zone, zone.data));
+			reserve(releaseTail(zone, zone.linked));
+		}
+	}
+	for(auto& [key, offset] : offsets) {
+		std::copy_n(key.first, key.second, mResident.begin() + offset);
+	}
+
+	// 確保完了後に参照を設定する
+	auto resident = [&](std::span<const int16_t> data) -> std::span<const int16_t> {
+		if(data.empty()) return {};
+		const size_t length = std::min(data.size(), residentFrames);
+		return { mResident.data() + offsets.at({ data.data(), length }), length };
+	};
+	for(auto& preset : mPresets) {
+		for(auto& zone : preset.zones) {
+			zone.residentReleaseData = resident(releaseTail(zone, zone.data));
+			zone.residentReleaseLinked = resident(releaseTail(zone, zone.linked));
+			zone.residentData = resident(zone.data);
+			zone.residentLinked = resident(zone.linked);
+			if(zone.residentData.size() == zone.data.size()) {
+				// 全体が常駐している : ストリーミング不要
+				zone.data = zone.residentData;
+				zone.linked = zone.residentLinked;
+			}
+		}
+	}
+}
+
+void SoundFont::parse()
+{
+	const auto file = mFile.data();
+
+	// RIFF sfbk
+	auto riff = readChunks(file);
+	if(riff.empty() || riff[0].id != "RIFF" || riff[0].data.size() < 4
+		|| std::string_view(reinterpret_cast<const char*>(riff[0].data.data()), 4) != "sfbk")
+	{
+		throw sound_font_exception("invalid sound font");
+	}
+	std::vector<Chunk> info, sdta, pdta;
+	for(const auto& chunk : readChunks(riff[0].data.subspan(4))) {
+		if(chunk.id != "LIST") continue;
+		auto [type, children] = readList(chunk);
+		if(type == "INFO") info = std::move(children);
+		else if(type == "sdta") sdta = std::move(children);
+		else if(type == "pdta") pdta = std::move(children);
+	}
+
+	// INFO : バンク名
+	if(auto inam = findChunk(info, "INAM")) {
+		auto p = reinterpret_cast<const char*>(inam->data.data());
+		mName.assign(p, std::find(p, p + inam->data.size(), '\0'));
+	}
+
+	// sdta : 16bit PCM サンプルデータ (マップ領域を直接参照する)
+	std::span<const int16_t> samples;
+	if(auto smpl = findChunk(sdta, "smpl")) {
+		// マップ領域はページ境界に配置され、チャンクは2バイト境界に配置されているため、直接参照できる
+		if(reinterpret_cast<uintptr_t>(smpl->data.data()) % alignof(int16_t) != 0) {
+			throw sound_font_exception("invalid sound font : misaligned sample data");
+		}
+		samples = { reinterpret_cast<const int16_t*>(smpl->data.data()), smpl->data.size() / sizeof(int16_t) };
+	}
+
+	// pdta : プリセット/インストゥルメント/サンプルの各レコード
+	const Records phdr(pdta, "phdr", 38);
+	const Records pbag(pdta, "pbag", 4);
+	const Records pgen(pdta, "pgen", 4);
+	const Records inst(pdta, "inst", 22);
+	const Records ibag(pdta, "ibag", 4);
+	const Records igen(pdta, "igen", 4);
+	const Records shdr(pdta, "shdr", 46);
+
+	auto sampleHeader = [&](size_t index) {
+		return SampleHeader{
+			shdr.read<uint32_t>(index, 20),
+			shdr.read<uint32_t>(index, 24),
+			shdr.read<uint32_t>(index, 28),
+			shdr.read<uint32_t>(index, 32),
+			shdr.read<uint32_t>(index, 36),
+			shdr.read<uint8_t>(index, 40),
+			shdr.read<int8_t>(index, 41),
+			shdr.read<uint16_t>(index, 42),
+			shdr.read<uint16_t>(index, 44),
+		};
+	};
+
+	// インストゥルメントゾーンとプリセットゾーンを合成し、SampleZone を構築します (SoundFont 2.04 9.4)
+	// 範囲は共通部分をとり、その他のジェネレータはプリセット側の値を加算します
+	auto buildZone = [&](const Generators& iz, const Generators& pz) -> std::optional<SampleZone> {
+		auto sum = [&](Generator oper, int32_t def) { return value(iz, oper, def) + value(pz, oper, 0); };
+
+		SampleZone zone;
+		const auto [ikeyLo, ikeyHi] = range(iz, KeyRange);
+		const auto [pkeyLo, pkeyHi] = range(pz, KeyRange);
+		const auto [ivelLo, ivelHi] = range(iz, VelRange);
+		const auto [pvelLo, pvelHi] = range(pz, VelRange);
+		zone.keyLo = std::max(ikeyLo, pkeyLo);
+		zone.keyHi = std::min(ikeyHi, pkeyHi);
+		zone.velLo = std::max(ivelLo, pvelLo);
+		zone.velHi = std::min(ivelHi, pvelHi);
+		if(zone.keyLo > zone.keyHi || zone.velLo > zone.velHi) return {};
+
+		// サンプル (終端レコードは除く)
+		const size_t sampleId = *iz[SampleID];
+		if(sampleId + 1 >= shdr.size()) throw sound_font_exception("invalid sound font : broken sample index");
+		const auto sh = sampleHeader(sampleId);
+		if(sh.sampleType & 0x8000) return {}; // ROMサンプル
+		if(sh.sampleRate == 0) return {};
+
+		// サンプル範囲 : アドレスオフセットはインストゥルメント側でのみ有効
+		auto address = [&](uint32_t base, Generator fine, Generator coarse) {
+			return static_cast<int64_t>(base) + value(iz, fine, 0) + int64_t(32768) * value(iz, coarse, 0);
+		};
+		const int64_t start = address(sh.start, StartAddrsOffset, StartAddrsCoarseOffset);
+		const int64_t end = address(sh.end, EndAddrsOffset, EndAddrsCoarseOffset);
+		if(!(0 <= start && start < end && end <= static_cast<int64_t>(samples.size()))) return {};
+		const auto length = static_cast<size_t>(end - start);
+		zone.data = samples.subspan(static_cast<size_t>(start), length);
+
+		const int64_t loopStart = std::clamp(address(sh.startLoop, StartloopAddrsOffset, StartloopAddrsCoarseOffset), start, end);
+		const int64_t loopEnd = std::clamp(address(sh.endLoop, EndloopAddrsOffset, EndloopAddrsCoarseOffset), start, end);
+		zone.loopStart = static_cast<size_t>(loopStart - start);
+		zone.loopEnd = static_cast<size_t>(loopEnd - start);
+		switch(value(iz, SampleModes, 0) & 3) {
+		case 1:  zone.loopMode = dsp::SampleLoopMode::Continuous; break;
+		case 3:  zone.loopMode = dsp::SampleLoopMode::UntilRelease; break;
+		default: zone.loopMode = dsp::SampleLoopMode::None; break;
+		}
+		zone.sampleRate = sh.sampleRate;
+
+		// ステレオサンプル (右:2, 左:4) : 対となるサンプルの同じ範囲を参照し、モノラルへミックスダウンして再生する
+		// MEMO ボイスはモノラル出力のため、左右に振り分けるパンは適用しない
+		bool isStereo = false;
+		if((sh.sampleType & 0x06) && static_cast<size_t>(sh.sampleLink) + 1 < shdr.size()) {
+			const auto link = sampleHeader(sh.sampleLink);
+			const int64_t linkStart = static_cast<int64_t>(link.start) + (start - sh.start);
+			if(static_cast<int64_t>(link.end) - link.start == static_cast<int64_t>(sh.end) - sh.start
+				&& linkStart >= 0 && linkStart + static_cast<int64_t>(length) <= static_cast<int64_t>(samples.size()))
+			{
+				zone.linked = samples.subspan(static_cast<size_t>(linkStart), length);
+				isStereo = true;
+			}
+		}
+
+		// 音程
+		int32_t rootKey = value(iz, OverridingRootKey, -1);
+		if(rootKey < 0 || rootKey > 127) rootKey = sh.originalPitch <= 127 ? sh.originalPitch : 60;
+		const int32_t cents = sum(CoarseTune, 0) * 100 + sum(FineTune, 0) + sh.pitchCorrection;
+		zone.rootKey = static_cast<float>(rootKey) - static_cast<float>(cents) / 100.0f;
+		zone.scaleTuning = static_cast<float>(sum(ScaleTuning, 100)) / 100.0f;
+
+		// 音量・定位
+		zone.volume = centibelsToLevel(sum(InitialAttenuation, 0));
+		zone.pan = isStereo ? 0.5f : static_cast<float>(std::clamp(sum(Pan, 0), -500, 500) + 500) / 1000.0f;
+
+		// ボリュームエンベロープ
+		zone.attack = timecentsToSec(sum(AttackVolEnv, -12000));
+		zone.hold = timecentsToSec(sum(HoldVolEnv, -12000));
+		zone.decay = timecentsToSec(sum(DecayVolEnv, -12000));
+		zone.sustain = centibelsToLevel(sum(SustainVolEnv, 0));
+		zone.release = timecentsToSec(sum(ReleaseVolEnv, -12000));
+
+		return zone;
+	};
+
+	// プリセット (終端レコードは除く)
+	for(size_t p = 0; p + 1 < phdr.size(); ++p) {
+		Preset preset;
+		preset.name = phdr.name(p);
+		preset.program = phdr.read<uint16_t>(p, 20);
+		preset.bank = phdr.read<uint16_t>(p, 22);
+
+		for(const auto& pz : readZones(pbag, pgen, phdr.read<uint16_t>(p, 24), phdr.read<uint16_t>(p + 1, 24), Instrument)) {
+			const size_t i = *pz[Instrument];
+			if(i + 1 >= inst.size()) throw sound_font_exception("invalid sound font : broken instrument index");
+			for(const auto& iz : readZones(ibag, igen, inst.read<uint16_t>(i, 20), inst.read<uint16_t>(i + 1, 20), SampleID)) {
+				if(auto zone = buildZone(iz, pz)) {
+					preset.zones.push_back(*zone);
+				}
+			}
+		}
+		mPresets.push_back(std::move(preset));
+	}
+	std::ranges::stable_sort(mPresets, {}, [](const Preset& p) { return std::make_pair(p.bank, p.program); });
+}
+
+const SoundFont::Preset* SoundFont::findPreset(uint16_t bank, uint16_t program)const noexcept
+{
+	auto key = std::make_pair(bank, program);
+	auto found = std::ranges::lower_bound(mPresets, key, {}, [](const Preset& p) { return std::make_pair(p.bank, p.program); });
+	return (found != mPresets.end() && found->bank == bank && found->program == program) ? &*found : nullptr;
+}
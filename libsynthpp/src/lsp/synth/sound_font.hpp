@@ -0,0 +1,144 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/dsp/sample_player.hpp>
+#include <lsp/synth/sample_streamer.hpp>
+#include <lsp/util/mapped_file.hpp>
+
+namespace lsp::synth
+{
+
+// SoundFont の形式エラー
+class sound_font_exception
+	: public std::runtime_error
+{
+public:
+	using runtime_error::runtime_error;
+};
+
+// サンプル ゾーン
+// SoundFont のプリセット/インストゥルメント階層のジェネレータを合成し、1サンプル分の再生パラメータとして解決したものです。
+struct SampleZone
+{
+	// 発音対象の範囲 (両端を含む)
+	uint8_t keyLo = 0;
+	uint8_t keyHi = 127;
+	uint8_t velLo = 0;
+	uint8_t velHi = 127;
+
+	// サンプルデータ (マップ領域を直接参照する)
+	std::span<const int16_t> data;
+	std::span<const int16_t> linked;	// ステレオサンプルの対となるチャネル (モノラルの場合は空)
+	size_t loopStart = 0;				// data先頭からの位置
+	size_t loopEnd = 0;					// data先頭からの位置
+	dsp::SampleLoopMode loopMode = dsp::SampleLoopMode::None;
+	uint32_t sampleRate = 44100;		// Hz
+
+	// ストリーミング時のみ : 先頭部分の常駐コピー (data と同じ位置から始まる)
+	// 全体が常駐している場合は data, linked も常駐コピーを指す
+	std::span<const int16_t> residentData;
+	std::span<const int16_t> residentLinked;
+	// ストリーミング時のみ : UntilRelease のノートオフ後に再生する、ループ終端以降の先頭部分の常駐コピー (data の loopEnd の位置から始まる)
+	std::span<const int16_t> residentReleaseData;
+	std::span<const int16_t> residentReleaseLinked;
+
+	// 音程
+	float rootKey = 60.0f;		// 元のピッチで再生されるノート番号 (ファインチューン等の補正 適用済み)
+	float scaleTuning = 1.0f;	// ノート番号1つ当たりの音程変化 (半音単位)
+
+	// 音量・定位
+	float volume = 1.0f;		// 初期減衰 適用済みの音量
+	float pan = 0.5f;			// 0～1
+
+	// ボリュームエンベロープ
+	float attack = 0.001f;		// sec
+	float hold = 0.001f;		// sec
+	float decay = 0.001f;		// sec
+	float sustain = 1.0f;		// level
+	float release = 0.001f;		// sec
+
+	// ストリーミング再生が必要か否か (常駐していない部分があるか) を取得します
+	bool isStreamed()const noexcept { return !residentData.empty() && residentData.size() < data.size(); }
+
+	// 指定のノート番号・ベロシティが範囲内か否かを取得します
+	bool contains(uint8_t noteNo, uint8_t vel)const noexcept
+	{
+		return keyLo <= noteNo && noteNo <= keyHi && velLo <= vel && vel <= velHi;
+	}
+};
+
+// SoundFont 2 サンプルバンク
+// ファイル全体をメモリマップし、サンプルデータはコピーせずにマップ領域を直接参照します。
+// そのため大容量のバンクも即座に読み込め、同じファイルを開いた他のプロセスとページを共有できます。
+// プリセット/インストゥルメント階層のジェネレータは読み込み時に SampleZone へ解決します。
+//
+// ストリーミングモードでは各ゾーンの先頭部分(アタック部, UntilRelease の場合はループ終端以降の先頭部分も)のみをメモリへ常駐させ、残りはI/Oスレッドが再生に先行して読み込みます。
+// レンダースレッドはマップ領域を直接参照しないため、物理メモリに収まらない大容量のバンクでもページフォールトで停止しません。
+//
+// 未対応 : モジュレータ, モジュレーションエンベロープ, LFO, フィルタ, 24bitサンプル(sm24), ROMサンプル
+class SoundFont final
+	: non_copy
+{
+public:
+	// パーカッション用のバンク番号
+	static constexpr uint16_t PERCUSSION_BANK = 128;
+
+	// プリセット (バンク番号 + プログラム番号 毎の音色)
+	struct Preset
+	{
+		std::string name;
+		uint16_t bank = 0;
+		uint16_t program = 0;
+		std::vector<SampleZone> zones;
+
+		// 指定のノート番号・ベロシティに該当する最初のゾーンを検索します
+		const SampleZone* findZone(uint8_t noteNo, uint8_t vel)const noexcept
+		{
+			auto found = std::ranges::find_if(zones, [&](const SampleZone& z) { return z.contains(noteNo, vel); });
+			return found != zones.end() ? &*found : nullptr;
+		}
+	};
+
+	// ストリーミングモードの設定
+	struct StreamingOptions
+	{
+		size_t residentFrames = 32768;	// ゾーン毎に常駐させる先頭部分のフレーム数 (UntilRelease の場合はループ終端以降も同じ長さを常駐させる)
+		size_t streamCount = 256;		// 同時に再生できるストリーム数
+		size_t ringFrames = 65536;		// ストリーム毎の先読みフレーム数
+	};
+
+	// SoundFont を読み込みます
+	explicit SoundFont(const std::filesystem::path& path); // throws sound_font_exception
+	// SoundFont をストリーミングモードで読み込みます
+	SoundFont(const std::filesystem::path& path, const StreamingOptions& options); // throws sound_font_exception
+
+	// バンク名を取得します
+	const std::string& name()const noexcept { return mName; }
+
+	// 全てのプリセットを取得します (バンク番号, プログラム番号の順に整列済み)
+	std::span<const Preset> presets()const noexcept { return mPresets; }
+
+	// プリセットを検索します
+	const Preset* findPreset(uint16_t bank, uint16_t program)const noexcept;
+
+	// ストリーマを取得します (ストリーミングモード以外では nullptr)
+	SampleStreamer* streamer()const noexcept { return mStreamer.get(); }
+
+private:
+	void parse(); // throws sound_font_exception
+	void makeResident(size_t residentFrames);
+
+private:
+	MappedFile mFile;
+	std::string mName;
+	std::vector<Preset> mPresets;
+
+	// ストリーミングモード
+	std::vector<int16_t> mResident;
+	std::unique_ptr<SampleStreamer> mStreamer;
+};
+
+}
@@ -1,15 +1,20 @@
 ﻿#include <lsp/synth/synthesizer.hpp>
 #include <lsp/synth/instruments.hpp>
+#include <lsp/dsp/resampler.hpp>
 #include <lsp/midi/messages/basic_message.hpp>
 #include <lsp/midi/messages/sysex_message.hpp>
+#include <lsp/midi/sysex_pattern.hpp>
 
 using namespace lsp::synth;
 
-Synthesizer::Synthesizer(uint32_t sampleFreq, const InstrumentTable& instrumentTable, midi::SystemType defaultSystemType, std::optional<uint32_t> randomSeed)
+Synthesizer::Synthesizer(uint32_t sampleFreq, std::shared_ptr<const InstrumentTable> instrumentTable, midi::SystemType defaultSystemType, std::optional<uint32_t> randomSeed)
 	: mSampleFreq(sampleFreq)
-	, mInstrumentTable(instrumentTable)
+	, mPublishedInstrumentTable(instrumentTable)
+	, mInstrumentTable(std::move(instrumentTable))
+	, mMasterEffector(sampleFreq)
 	, mPlayingThreadAborted(false)
 {
+	lsp_require(mInstrumentTable != nullptr);
 	Instruments::prepareWaveTable();
 
 	mMidiChannels.reserve(MAX_CHANNELS);
@@ -18,9 +23,23 @@ Synthesizer::Synthesizer(uint32_t sampleFreq, const InstrumentTable& instrumentT
 		if(randomSeed) {
 			chSeed = *randomSeed + ch;
 		}
-		mMidiChannels.emplace_back(sampleFreq, ch, mInstrumentTable, chSeed);
+		mMidiChannels.emplace_back(sampleFreq, ch, *mInstrumentTable, chSeed);
 	}
 
+	// チャネルエフェクタ (リバーブ/コーラス) : 全チャネルで1インスタンスを共有する
+	const auto freq = static_cast<float>(sampleFreq);
+	mReverb.setParam(freq,
+		2.0f,	// decay(RT60) [sec]
+		0.3f,	// damping
+		0.020f	// pre delay [sec]
+	);
+	mChorus.setParam(freq,
+		0.010f,	// delay [sec]
+		0.0025f,// depth [sec]
+		0.45f,	// rate [Hz]
+		0.1f	// feedback
+	);
+
 	reset(defaultSystemType);
 
 	mPlayingThread = std::thread([this]{playingThreadMain();});
@@ -77,12 +96,26 @@ void Synthesizer::playingThreadMain()
 		// 指定時刻時点までに蓄積されたMIDIメッセージを解釈
 		size_t msg_count = 0;
 		while (!mMessageQueue.empty()) {
-			const auto& [msg_time, msg] = mMessageQueue.front();
+			const auto& [msg_time, packet, msg] = mMessageQueue.front();
 			if(msg_time >= prev_wake_up_time) break;
-			dispatchMessage(msg);
+			if(mMessageCoalescingEnabled) {
+				auto f = [this](size_t, const auto& msg) { dispatchMessage(msg); };
+				if(msg) {
+					mMessageCoalescer.push(0, msg, f);
+				} else {
+					mMessageCoalescer.push(0, packet, f);
+				}
+			} else {
+				if(msg) {
+					dispatchMessage(msg);
+				} else {
+					dispatchMessage(packet);
+				}
+			}
 			++msg_count;
 			mMessageQueue.pop_front();
 		}
+		mMessageCoalescer.flush([this](size_t, const auto& msg) { dispatchMessage(msg); });
 	
 		// 信号生成
 		auto beginRendering = clock::now();
@@ -91,6 +124,7 @@ void Synthesizer::playingThreadMain()
 		mStatistics.rendering_time = endRendering - beginRendering;
 		mStatistics.created_samples += sig.frames();
 		mStatistics.failed_samples += (need_samples - make_samples);
+		mStatistics.coalesced_messages = mMessageCoalescer.coalescedCount();
 
 		if(mRenderingCallback) mRenderingCallback(std::move(sig));
 		
@@ -113,43 +147,232 @@ void Synthesizer::reset(midi::SystemType type)
 }
 
 
+void Synthesizer::adoptInstrumentTable()
+{
+	// 通常は世代番号の比較のみ (参照カウントの操作を伴わない)
+	auto generation = mPublishedInstrumentGeneration.load(std::memory_order_acquire);
+	if(generation == mInstrumentGeneration) return;
+
+	// 差し替え前のテーブルは公開側の回収リストが保持しているため、ここで解放されることはない
+	mInstrumentTable = mPublishedInstrumentTable.load();
+	mInstrumentGeneration = generation;
+	for(auto& midich : mMidiChannels) {
+		midich.setInstrumentTable(*mInstrumentTable, generation);
+	}
+}
+void Synthesizer::reportReferencedInstrumentGeneration()
+{
+	// 通常は世代番号の比較のみ : 差し替え前の世代から生成されたボイスが残っている間のみ、発音中のボイスを走査する
+	if(mReportedInstrumentGeneration == mInstrumentGeneration) return;
+
+	uint64_t oldest = mInstrumentGeneration;
+	for(const auto& midich : mMidiChannels) {
+		oldest = std::min(oldest, midich.oldestInstrumentGeneration());
+	}
+	if(oldest != mReportedInstrumentGeneration) {
+		mReportedInstrumentGeneration = oldest;
+		mReferencedInstrumentGeneration.store(oldest, std::memory_order_release);
+	}
+}
+void Synthesizer::setInstrumentTable(std::shared_ptr<const InstrumentTable> instrumentTable)
+{
+	lsp_require(instrumentTable != nullptr);
+
+	std::lock_guard lock(mRetiredInstrumentTablesMutex); // 公開側同士の排他
+	auto generation = mPublishedInstrumentGeneration.load(std::memory_order_relaxed) + 1;
+	auto retired = mPublishedInstrumentTable.exchange(std::move(instrumentTable));
+	mPublishedInstrumentGeneration.store(generation, std::memory_order_release);
+	mRetiredInstrumentTables.emplace_back(generation, std::move(retired));
+	collectRetiredInstrumentTablesLocked();
+}
+void Synthesizer::collectRetiredInstrumentTables()
+{
+	std::lock_guard lock(mRetiredInstrumentTablesMutex);
+	collectRetiredInstrumentTablesLocked();
+}
+void Synthesizer::collectRetiredInstrumentTablesLocked()
+{
+	// レンダリングスレッドが参照している最も古い世代が新しい世代に達していれば、それ以前に差し替えたテーブルはもう参照されない
+	// (差し替え前のテーブルから生成されたボイスが発音中の間は、テーブルが所有する SoundFont 等を解放しない)
+	auto referenced = mReferencedInstrumentGeneration.load(std::memory_order_acquire);
+	std::erase_if(mRetiredInstrumentTables, [referenced](const auto& retired) { return retired.first <= referenced; });
+}
+
 lsp::Signal<float> Synthesizer::generate(size_t len)
 {
-	constexpr float MIXING_GAIN = 1.f / 16.f; // ほどよいミキシングゲイン (20-30和音クリップしないが小さすぎない程度の値)
-	const float masterGain = MIXING_GAIN * mMasterVolume;
+	constexpr float MIXING_GAIN = 1.f / 8.f; // ほどよいミキシングゲイン (ピークはマスタエフェクタのリミッタで抑えるため、やや大きめの値とする)
+	constexpr float REVERB_RETURN = 0.6f; // リバーブ リターンレベル
+	constexpr float CHORUS_RETURN = 0.7f; // コーラス リターンレベル
+
+	// インストゥルメント情報テーブルの差し替えはブロック境界でのみ反映する
+	adoptInstrumentTable();
 
 	auto sig = lsp::Signal<float>::allocate(&mMem, 2, len);
+	auto reverbBus = lsp::Signal<float>::allocate(&mMem, 2, len);
+	auto chorusBus = lsp::Signal<float>::allocate(&mMem, 2, len);
 
-	for (size_t i = 0; i < len; ++i) {
-		auto frame = sig.frame(i);
-		frame[0] = frame[1] = 0;
+	// MIDIメッセージ ソース : メッセージの位置まで信号を生成してから適用する (サンプル単位で正確なタイミング)
+	size_t rendered = 0;
+	if(mMessageSource) {
+		class Dispatcher final
+			: public midi::MessageSource::Receiver
+		{
+		public:
+			Dispatcher(Synthesizer& synth, Signal<float>& sig, Signal<float>& reverbBus, Signal<float>& chorusBus, size_t len, size_t& rendered)
+				: synth(synth), sig(sig), reverbBus(reverbBus), chorusBus(chorusBus), len(len), rendered(rendered) {}
+
+			void onMessage(size_t frameOffset, const std::shared_ptr<const midi::Message>& msg)override
+			{
+				if(synth.mMessageCoalescingEnabled) {
+					// 集約する場合はブロック分を溜めてから適用する
+					synth.mMessageCoalescer.push(frameOffset, msg, [this](size_t offset, const auto& m) { dispatch(offset, m); });
+				} else {
+					dispatch(frameOffset, msg);
+				}
+			}
+			void onPacket(size_t frameOffset, const midi::Ump& packet)override
+			{
+				if(synth.mMessageCoalescingEnabled) {
+					synth.mMessageCoalescer.push(frameOffset, packet, [this](size_t offset, const auto& m) { dispatch(offset, m); });
+				} else {
+					dispatch(frameOffset, packet);
+				}
+			}
+			void onSysEx(size_t frameOffset, std::span<const uint8_t> data)override
+			{
+				// SysEx は全チャネルの集約を打ち切るため、溜めたメッセージを先に適用する (data は呼び出し中のみ有効)
+				if(synth.mMessageCoalescingEnabled) {
+					synth.mMessageCoalescer.flush([this](size_t offset, const auto& m) { dispatch(offset, m); });
+				}
+				renderUntil(frameOffset);
+				synth.sysExMessage(data.data(), data.size());
+			}
+			void dispatch(size_t frameOffset, const std::shared_ptr<const midi::Message>& msg)
+			{
+				renderUntil(frameOffset);
+				synth.dispatchMessage(msg);
+			}
+			void dispatch(size_t frameOffset, const midi::Ump& packet)
+			{
+				renderUntil(frameOffset);
+				synth.dispatchMessage(packet);
+			}
+
+		private:
+			void renderUntil(size_t frameOffset)
+			{
+				const auto offset = std::min(frameOffset, len);
+				if(offset > rendered) {
+					synth.renderChannels(sig, reverbBus, chorusBus, rendered, offset);
+					rendered = offset;
+				}
+			}
+
+			Synthesizer& synth;
+			Signal<float>& sig;
+			Signal<float>& reverbBus;
+			Signal<float>& chorusBus;
+			const size_t len;
+			size_t& rendered;
+		};
+		Dispatcher dispatcher(*this, sig, reverbBus, chorusBus, len, rendered);
+		mMessageSource->advance(mSampleFreq, len, dispatcher);
+		mMessageCoalescer.flush([&dispatcher](size_t frameOffset, const auto& msg) { dispatcher.dispatch(frameOffset, msg); });
+	}
+	renderChannels(sig, reverbBus, chorusBus, rendered, len);
+	reportReferencedInstrumentGeneration();
+
+	// チャネルエフェクタ : バス単位でブロック処理し、リターンをドライ信号に加算する
+	// (バッファは入力と出力を兼ねる)
+	mChorus.process(chorusBus.data(), chorusBus.data(), len);
+	if(mConvolutionReverb) {
+		mConvolutionReverb->process(reverbBus.data(), reverbBus.data(), len);
+	} else {
+		mReverb.process(reverbBus.data(), reverbBus.data(), len);
+	}
+	{
+		const float masterGain = MIXING_GAIN * mMasterVolume;
+		auto dry = sig.data();
+		const auto reverbWet = reverbBus.data();
+		const auto chorusWet = chorusBus.data();
+		for(size_t i = 0; i < len * 2; ++i) {
+			// ミキシングゲイン + マスタボリューム適用
+			dry[i] = (dry[i] + reverbWet[i] * REVERB_RETURN + chorusWet[i] * CHORUS_RETURN) * masterGain;
+		}
+	}
+
+	// マスタエフェクタ適用
+	const auto effectorStatistics = mMasterEffector.process(sig);
+	mStatistics.compressor_gain_reduction_db = effectorStatistics.compressor_gain_reduction_db;
+	mStatistics.limiter_gain_reduction_db = effectorStatistics.limiter_gain_reduction_db;
+
+	return sig;
+}
+void Synthesizer::renderChannels(Signal<float>& sig, Signal<float>& reverbBus, Signal<float>& chorusBus, size_t begin, size_t end)
+{
+	// MEMO チャネル毎にブロック単位で生成し、ボイス毎の処理をまとめて行えるようにする
+	constexpr size_t BLOCK_FRAMES = MidiChannel::MAX_RENDER_FRAMES;
+	std::array<float, BLOCK_FRAMES> left;
+	std::array<float, BLOCK_FRAMES> right;
+
+	for (size_t blockBegin = begin; blockBegin < end; blockBegin += BLOCK_FRAMES) {
+		const size_t frames = std::min(BLOCK_FRAMES, end - blockBegin);
+
+		for (size_t i = blockBegin; i < blockBegin + frames; ++i) {
+			auto frame = sig.frame(i);
+			auto reverbFrame = reverbBus.frame(i);
+			auto chorusFrame = chorusBus.frame(i);
+			frame[0] = frame[1] = 0;
+			reverbFrame[0] = reverbFrame[1] = 0;
+			chorusFrame[0] = chorusFrame[1] = 0;
+		}
 
 		// チャネル毎の信号を生成する
 		for (size_t ch = 0; ch < MAX_CHANNELS; ++ch) {
 			auto& midich = mMidiChannels[ch];
-			auto v = midich.update();
+			midich.render(left.data(), right.data(), frames);
 
-			// NaN/Inf検出時は無音で継続 (RTスレッド上のため中断不可)
-			if(!std::isfinite(v.first) || !std::isfinite(v.second)) {
-				lsp_rt_fail(continue, "generate: NaN/Inf detected on ch={}", ch);
-			}
+			// センド : 各チャネルの出力をエフェクトバスへ加算する
+			const auto reverbSend = midich.reverbSend();
+			const auto chorusSend = midich.chorusSend();
+			for (size_t i = 0; i < frames; ++i) {
+				// NaN/Inf検出時は無音で継続 (RTスレッド上のため中断不可)
+				if(!std::isfinite(left[i]) || !std::isfinite(right[i])) {
+					lsp_rt_fail(continue, "generate: NaN/Inf detected on ch={}", ch);
+				}
 
-			frame[0] += v.first;
-			frame[1] += v.second;
+				auto frame = sig.frame(blockBegin + i);
+				auto reverbFrame = reverbBus.frame(blockBegin + i);
+				auto chorusFrame = chorusBus.frame(blockBegin + i);
+				frame[0] += left[i];
+				frame[1] += right[i];
+				reverbFrame[0] += left[i] * reverbSend;
+				reverbFrame[1] += right[i] * reverbSend;
+				chorusFrame[0] += left[i] * chorusSend;
+				chorusFrame[1] += right[i] * chorusSend;
+			}
 		}
-
-		// ミキシングゲイン + マスタボリューム適用
-		frame[0] *= masterGain;
-		frame[1] *= masterGain;
 	}
-	return sig;
 }
 
 // MIDIメッセージ受信コールバック
 void Synthesizer::onMidiMessageReceived(clock::time_point msg_time, const std::shared_ptr<const midi::Message>& msg)
+{
+	// 変換はロック外で行う
+	auto packet = midi::Ump::from(*msg);
+
+	std::lock_guard lock(mMutex);
+	if(packet) {
+		mMessageQueue.push_back({msg_time, *packet, nullptr});
+	} else {
+		mMessageQueue.push_back({msg_time, midi::Ump(), msg});
+	}
+}
+// Universal MIDI Packet 受信コールバック
+void Synthesizer::onUmpReceived(clock::time_point msg_time, const midi::Ump& packet)
 {
 	std::lock_guard lock(mMutex);
-	mMessageQueue.emplace_back(msg_time, msg);
+	mMessageQueue.push_back({msg_time, packet, nullptr});
 }
 // 音声が生成された際のコールバック関数を設定します
 void Synthesizer::setRenderingCallback(RenderingCallback cb)
@@ -157,6 +380,48 @@ void Synthesizer::setRenderingCallback(RenderingCallback cb)
 	std::lock_guard lock(mMutex);
 	mRenderingCallback = std::move(cb);
 }
+// MIDIメッセージ ソースを設定します
+void Synthesizer::setMessageSource(std::shared_ptr<midi::MessageSource> source)
+{
+	std::lock_guard lock(mMutex);
+	mMessageSource = std::move(source);
+}
+// ブロック内の連続値メッセージの集約を有効/無効にします
+void Synthesizer::setMessageCoalescing(bool enabled)
+{
+	std::lock_guard lock(mMutex);
+	mMessageCoalescingEnabled = enabled;
+}
+// リバーブのインパルス応答を設定します
+void Synthesizer::setReverbImpulseResponse(const SignalView<float>& ir, uint32_t irSampleFreq)
+{
+	lsp_require(ir.channels() == 1 || ir.channels() == 2);
+
+	// IRの変換と畳み込みエンジンの構築は重いため、ロック外で行う
+	std::unique_ptr<dsp::PartitionedConvolver<float>> convolver;
+	if(ir.frames() > 0) {
+		if(irSampleFreq == mSampleFreq) {
+			convolver = std::make_unique<dsp::PartitionedConvolver<float>>(ir);
+		} else {
+			// 末尾まで出力させるため、リサンプラの遅延分の無音を追加で与える
+			dsp::Resampler<float> resampler(irSampleFreq, mSampleFreq, ir.channels(), dsp::ResamplerQuality::High);
+			auto resampled = resampler.process(ir);
+			auto padding = Signal<float>::allocate(ir.channels(), resampler.latency());
+			auto rest = resampler.process(padding);
+
+			auto converted = Signal<float>::allocate(ir.channels(), resampled.frames() + rest.frames());
+			std::copy_n(resampled.data(), resampled.frames() * resampled.channels(), converted.data());
+			std::copy_n(rest.data(), rest.frames() * rest.channels(), converted.data() + resampled.frames() * resampled.channels());
+			convolver = std::make_unique<dsp::PartitionedConvolver<float>>(converted);
+		}
+	}
+
+	{
+		std::lock_guard lock(mMutex);
+		std::swap(mConvolutionReverb, convolver);
+	}
+	// 旧エンジンの破棄(ワーカースレッドのjoin)もロック外で行う
+}
 // 統計情報を取得します
 Synthesizer::Statistics Synthesizer::statistics()const
 {
@@ -168,6 +433,9 @@ Synthesizer::Digest Synthesizer::digest()const
 	Digest digest;
 	digest.systemType = mSystemType;
 	digest.masterVolume = mMasterVolume;
+	if(auto table = mPublishedInstrumentTable.load(); table->soundFont() && table->soundFont()->streamer()) {
+		digest.streamUnderruns = table->soundFont()->streamer()->underruns();
+	}
 
 	digest.channels.reserve(mMidiChannels.size());
 	for (auto& ch : mMidiChannels) {
@@ -178,105 +446,132 @@ Synthesizer::Digest Synthesizer::digest()const
 void Synthesizer::dispatchMessage(const std::shared_ptr<const midi::Message>& msg)
 {
 	using namespace midi::messages;
-	if (auto noteOn = std::dynamic_pointer_cast<const NoteOn>(msg)) {
-		auto& midich = mMidiChannels[noteOn->channel()];
-		midich.noteOn(noteOn->noteNo(), noteOn->velocity());
-	} else if (auto noteOff = std::dynamic_pointer_cast<const NoteOff>(msg)) {
-		// MEMO 一般に、MIDIではノートオフの代わりにvel=0のノートオンが使用されるため、呼ばれることは希である
-		auto& midich = mMidiChannels[noteOff->channel()];
-		midich.noteOff(noteOff->noteNo());
-	} else if (auto programChange = std::dynamic_pointer_cast<const ProgramChange>(msg)) {
-		auto& midich = mMidiChannels[programChange->channel()];
-		midich.programChange(programChange->progId());
-	} else if (auto controlChange = std::dynamic_pointer_cast<const ControlChange>(msg)) {
-		auto& midich = mMidiChannels[controlChange->channel()];
-		midich.controlChange(controlChange->ctrlNo(), controlChange->value());
-	} else if (auto pitchBend = std::dynamic_pointer_cast<const PitchBend>(msg)) {
-		auto& midich = mMidiChannels[pitchBend->channel()];
-		midich.pitchBend(pitchBend->pitch());
-	} else if (auto polyPressure = std::dynamic_pointer_cast<const PolyphonicKeyPressure>(msg)) {
-		auto& midich = mMidiChannels[polyPressure->channel()];
-		midich.polyphonicKeyPressure(polyPressure->noteNo(), polyPressure->value());
-	} else if (auto chanPressure = std::dynamic_pointer_cast<const ChannelPressure>(msg)) {
-		auto& midich = mMidiChannels[chanPressure->channel()];
-		midich.channelPressure(chanPressure->value());
+	if (auto packet = midi::Ump::from(*msg)) {
+		dispatchMessage(*packet);
 	} else if (auto sysEx = std::dynamic_pointer_cast<const SysExMessage>(msg)) {
 		sysExMessage(sysEx->data().data(), sysEx->data().size());
 	}
 }
+void Synthesizer::dispatchMessage(const midi::Ump& packet)
+{
+	using midi::Ump;
+	using Status = Ump::Status;
+
+	switch (packet.messageType()) {
+	case Ump::MessageType::Midi1ChannelVoice:
+		if (auto converted = packet.upConvert()) {
+			dispatchMessage(*converted);
+		}
+		return;
+	case Ump::MessageType::Midi2ChannelVoice:
+		break;
+	default:
+		return;
+	}
+
+	auto& midich = mMidiChannels[packet.channel()];
+	switch (packet.status()) {
+	case Status::NoteOn: {
+		std::optional<float> pitch;
+		if (packet.attributeType() == Ump::ATTRIBUTE_PITCH_7_9) {
+			pitch = packet.attributeData() / 512.0f;
+		}
+		midich.noteOnHighRes(packet.note(), packet.velocity(), pitch);
+		break;
+	}
+	case Status::NoteOff:
+		midich.noteOff(packet.note());
+		break;
+	case Status::ProgramChange:
+		if (packet.bankValid()) {
+			midich.controlChange(0, packet.bankMSB());
+			midich.controlChange(32, packet.bankLSB());
+		}
+		midich.programChange(packet.program());
+		break;
+	case Status::ControlChange:
+		midich.controlChangeHighRes(packet.index(), packet.data());
+		break;
+	case Status::PitchBend:
+		midich.pitchBendHighRes(packet.data());
+		break;
+	case Status::PolyPressure:
+		midich.polyphonicKeyPressureHighRes(packet.note(), packet.data());
+		break;
+	case Status::ChannelPressure:
+		midich.channelPressureHighRes(packet.data());
+		break;
+	case Status::PerNotePitchBend:
+		midich.perNotePitchBend(packet.note(), packet.data());
+		break;
+	case Status::PerNoteManagement:
+		if (packet.flags() & Ump::PER_NOTE_RESET) {
+			midich.resetPerNoteControllers(packet.note());
+		}
+		break;
+	case Status::RegisteredController:
+		midich.parameterChange(true, packet.bank(), packet.subIndex(), packet.data());
+		break;
+	case Status::AssignableController:
+		midich.parameterChange(false, packet.bank(), packet.subIndex(), packet.data());
+		break;
+	default:
+		// パーノートコントローラ, 相対値コントローラ は未対応
+		break;
+	}
+}
 // ---
 
 // システムエクスクルーシブ
 void Synthesizer::sysExMessage(const uint8_t* data, size_t len)
 {
-	size_t pos = 0;
-	auto peek = [&](size_t offset = 0) -> std::optional<uint8_t> {
-		if(pos + offset >= len) return {};
-		return data[pos + offset];
-		};
-	auto read = [&]() -> std::optional<uint8_t> {
-		if(pos >= len) return {};
-		return data[pos++];
-		};
-	auto match = [&](const std::vector<std::optional<uint8_t>>& pattern) -> bool {
-		for(size_t i = 0; i < pattern.size(); ++i) {
-			auto v = peek(i);
-			if(!v.has_value()) return false;
-			if(pattern[i].has_value() && pattern[i].value() != v.value()) return false;
-		}
-		return true;
-		};
+	// 参考 : https://www.g200kg.com/jp/docs/tech/universalsysex.html
+	using midi::SysExPattern;
+	constexpr auto ANY = SysExPattern::ANY;
 
-	auto makerId = read();
-	if(makerId == 0x7E) {
-		// 非リアルタイム ユニバーサルシステムエクスクルーシブ
-		// https://www.g200kg.com/jp/docs/tech/universalsysex.html
-
-		if(match({ 0x7F, 0x09, 0x01 })) {
-			// GM1 System On
-			reset(midi::SystemType::GM1());
-		} else if(match({ 0x7F, 0x09, 0x03 })) {
-			// GM2 System On
-			reset(midi::SystemType::GM2());
-		} else if(match({ 0x7F, 0x09, 0x02 })) {
-			// GM System Off → GS Reset
-			reset(midi::SystemType::GS());
-		}
-	} else if(makerId == 0x7F) {
-		// リアルタイム ユニバーサルシステムエクスクルーシブ
-		if(match({ {/*dev:any*/}, 0x04, 0x01, {/*ll*/}, {/*mm*/} })) {
-			// Master Volume : F0 7F xx 04 01 ll mm F7
-			auto ll = *peek(3); // volume LSB
-			auto mm = *peek(4); // volume MSB
-			mMasterVolume = static_cast<float>(mm * 128 + ll) / 16383.0f;
-		}
-	} else if(makerId == 0x41) {
-		// Roland
-		if(match({ {/*dev:any*/}, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41 })) {
-			// GS Reset
-			reset(midi::SystemType::GS());
-		} else if(match({ {/*dev:any*/}, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x00, 0x01 })) {
-			// System Mode Set 1 // ※32パートで1音源
-			reset(midi::SystemType::SystemModeSet1());
-		} else if(match({ {/*dev:any*/}, 0x42, 0x12, 0x00, 0x00, 0x7F, 0x01, 0x00 })) {
-			// System Mode Set 2 // ※16パートを2音源扱いにする。現在ほぼ使われないとのこと
-			reset(midi::SystemType::SystemModeSet2());
-		} else if(match({ {/*dev:any*/}, 0x42, 0x12, 0x40, {/*1x:part*/}, 0x15, {/*mn*/} }) && (*peek(4) & 0xF0) == 0x10) {
-			// ドラムパート指定
-			//   see https://ssw.co.jp/dtm/drums/drsetup.html
+	struct Handler
+	{
+		SysExPattern pattern;
+		void (*apply)(Synthesizer& synth, std::span<const uint8_t> data);
+	};
+	// パターンと処理の対応表 : メーカーID(先頭バイト)で絞り込み、先に一致したものを適用する
+	static constexpr Handler HANDLERS[] = {
+		// MEMO システムリセット(GM/GS/XG Reset等)は midi::SYSTEM_RESET_PATTERNS で定義する
+
+		// --- リアルタイム ユニバーサルシステムエクスクルーシブ ---
+		// Master Volume : F0 7F xx 04 01 ll mm F7
+		{ { 0x7F, ANY, 0x04, 0x01, ANY/*ll*/, ANY/*mm*/ }, [](Synthesizer& synth, std::span<const uint8_t> data) {
+			auto ll = data[4]; // volume LSB
+			auto mm = data[5]; // volume MSB
+			synth.mMasterVolume = static_cast<float>(mm * 128 + ll) / 16383.0f;
+		} },
+
+		// --- Roland ---
+		// ドラムパート指定 : F0 41 xx 42 12 40 1x 15 mn ...
+		//   see https://ssw.co.jp/dtm/drums/drsetup.html
+		{ { 0x41, ANY, 0x42, 0x12, 0x40, SysExPattern::upper(0x10)/*1x:part*/, 0x15, ANY/*mn*/ }, [](Synthesizer& synth, std::span<const uint8_t> data) {
 			// GS Part番号 → MIDIチャネルのマッピング
 			//   Part 1 (0x10) → ch10, Part 2 (0x11) → ch1, ... Part 10 (0x19) → ch9, Part 11 (0x1A) → ch11, ...
 			static constexpr uint8_t gsPartToChannel[16] = { 9, 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 11, 12, 13, 14, 15 };
-			auto partIndex = static_cast<uint8_t>(*peek(4) & 0x0F);
+			auto partIndex = static_cast<uint8_t>(data[5] & 0x0F);
 			auto ch = gsPartToChannel[partIndex];
-			auto mapNo = *peek(6);
-			mMidiChannels[ch].setDrumMode(mapNo != 0);
-		}
-	} else if(makerId == 0x43) {
-		// YAMAHA
-		if(match({ {/*dev:any*/}, 0x4C, 0x00, 0x00, 0x7E, 0x00 })) {
-			// XG Reset
-			reset(midi::SystemType::XG());
+			auto mapNo = data[7];
+			synth.mMidiChannels[ch].setDrumMode(mapNo != 0);
+		} },
+	};
+
+	const std::span<const uint8_t> sysex(data, len);
+	if (sysex.empty()) return;
+	if (auto type = midi::findSystemReset(sysex)) {
+		reset(*type);
+		return;
+	}
+	const auto makerId = sysex.front();
+	for (const auto& handler : HANDLERS) {
+		if (handler.pattern.front() != makerId) continue;
+		if (handler.pattern.match(sysex)) {
+			handler.apply(*this, sysex);
+			break;
 		}
 	}
 }
@@ -3,11 +3,18 @@
 #include <lsp/core/core.hpp>
 #include <lsp/synth/instrument_table.hpp>
 #include <lsp/synth/midi_channel.hpp>
+#include <lsp/synth/master_effector.hpp>
+#include <lsp/synth/message_coalescer.hpp>
+#include <lsp/dsp/reverb.hpp>
+#include <lsp/dsp/chorus.hpp>
+#include <lsp/dsp/convolver.hpp>
 
 #include <lsp/midi/message_receiver.hpp>
+#include <lsp/midi/message_source.hpp>
 
 #include <array>
 #include <optional>
+#include <mutex>
 #include <shared_mutex>
 
 namespace lsp::synth
@@ -22,6 +29,11 @@ public:
 	struct Statistics {
 		uint64_t created_samples = 0;
 		uint64_t failed_samples = 0;
+		uint64_t coalesced_messages = 0; // 集約により取り除いたMIDIメッセージ数
+
+		// マスタエフェクタのゲインリダクション量(dB) : 直近のレンダリング区間での最大値
+		float compressor_gain_reduction_db = 0;
+		float limiter_gain_reduction_db = 0;
 
 		clock::duration cycle_time;
 		clock::duration rendering_time;
@@ -36,22 +48,47 @@ public:
 	struct Digest {
 		midi::SystemType systemType;
 		float masterVolume = 1.0f;
+		uint64_t streamUnderruns = 0; // SoundFont ストリーミング再生で先読みが間に合わなかった回数
 
 		std::vector<MidiChannel::Digest> channels;
 	};
 
 public:
-	Synthesizer(uint32_t sampleFreq, const InstrumentTable& instrumentTable, midi::SystemType defaultSystemType = midi::SystemType::GS(), std::optional<uint32_t> randomSeed = std::nullopt);
+	Synthesizer(uint32_t sampleFreq, std::shared_ptr<const InstrumentTable> instrumentTable, midi::SystemType defaultSystemType = midi::SystemType::GS(), std::optional<uint32_t> randomSeed = std::nullopt);
 	~Synthesizer();
 
 	void dispose();
 
 	// MIDIメッセージを受信した際にコールバックされます。
+	// チャネルボイスメッセージは受信時に Universal MIDI Packet へ変換して蓄積されます。
 	virtual void onMidiMessageReceived(clock::time_point received_time, const std::shared_ptr<const midi::Message>& msg)override;
+	// Universal MIDI Packet を受信した際にコールバックされます。
+	virtual void onUmpReceived(clock::time_point received_time, const midi::Ump& packet)override;
 	
 	// 音声が生成された際のコールバック関数を設定します
 	void setRenderingCallback(RenderingCallback cb);
 
+	// MIDIメッセージ ソースを設定します (nullptr で解除)
+	// ソースのメッセージはレンダリングループからブロック毎に取得され、サンプル単位の位置で適用されます。
+	void setMessageSource(std::shared_ptr<midi::MessageSource> source);
+
+	// ブロック内の連続値メッセージの集約を有効/無効にします (既定 : 無効)
+	// 有効にすると、同一チャネル・同一コントローラのメッセージは最後の値のみが適用されます。 (see MessageCoalescer)
+	void setMessageCoalescing(bool enabled);
+
+	// リバーブのインパルス応答を設定します (1ch または 2ch)
+	// 設定した場合、リバーブはFDNの代わりにインパルス応答との畳み込みで処理されます。空の信号を渡すとFDNに戻ります。
+	// インパルス応答のサンプリング周波数が異なる場合は、シンセサイザのサンプリング周波数へ変換してから用います。
+	void setReverbImpulseResponse(const SignalView<float>& ir, uint32_t irSampleFreq);
+
+	// インストゥルメント情報テーブルを差し替えます (任意のスレッドから呼び出し可能)
+	// 新しいテーブルは次のレンダリングブロックから新規のノートに適用され、発音中のボイスは元のパラメータのまま鳴り続けます。
+	// 差し替え前のテーブルはレンダリングスレッド(そのテーブルから生成されたボイスを含む)が参照しなくなった後、collectRetiredInstrumentTables() または本関数の呼び出し時(または破棄時)に解放されます。
+	void setInstrumentTable(std::shared_ptr<const InstrumentTable> instrumentTable);
+	// 差し替え済みのインストゥルメント情報テーブルのうち、レンダリングスレッドが参照しなくなったものを解放します
+	// テーブルの解放はメモリマップの解除やI/Oスレッドの終了を伴うため、UIスレッド等の非リアルタイムスレッドから定期的に呼び出してください。
+	void collectRetiredInstrumentTables();
+
 	// 統計情報を取得します
 	Statistics statistics()const;
 	// 現在の内部状態のダイジェストを取得します
@@ -60,33 +97,72 @@ public:
 protected:
 	void playingThreadMain();
 	void dispatchMessage(const std::shared_ptr<const midi::Message>& msg);
+	void dispatchMessage(const midi::Ump& packet);
 	void reset(midi::SystemType type);
 
+	// 公開されたインストゥルメント情報テーブルが更新されていれば、レンダリングスレッド側へ取り込みます
+	void adoptInstrumentTable();
+	// レンダリングスレッドが参照している最も古い世代を公開側へ通知します
+	void reportReferencedInstrumentGeneration();
+	// 回収可能な差し替え済みテーブルを解放します (mRetiredInstrumentTablesMutex をロックした状態で呼び出すこと)
+	void collectRetiredInstrumentTablesLocked();
+
 	// システムエクスクルーシブ
 	void sysExMessage(const uint8_t* data, size_t len);
 
 	// MIDIメッセージを元に演奏した結果を返します
 	Signal<float> generate(size_t len);
 
+	// 各チャネルの信号を [begin, end) の区間に生成し、ドライ信号とエフェクトバスへ加算します
+	void renderChannels(Signal<float>& sig, Signal<float>& reverbBus, Signal<float>& chorusBus, size_t begin, size_t end);
+
 private:
 	mutable std::shared_mutex mMutex;
 	std::pmr::synchronized_pool_resource mMem;
-	std::deque<std::pair<clock::time_point, std::shared_ptr<const midi::Message>>> mMessageQueue;
+	struct QueuedMessage
+	{
+		clock::time_point time;
+		midi::Ump packet;
+		std::shared_ptr<const midi::Message> msg; // パケットへ変換できないメッセージのみ
+	};
+	std::deque<QueuedMessage> mMessageQueue;
 
 	Statistics mStatistics;
 	std::atomic<Statistics> mThreadSafeStatistics;
 
 	RenderingCallback mRenderingCallback;
+	std::shared_ptr<midi::MessageSource> mMessageSource;
+	MessageCoalescer mMessageCoalescer;
+	bool mMessageCoalescingEnabled = false;
 		
 	// all channel parameters
 	const uint32_t mSampleFreq;
-	const InstrumentTable& mInstrumentTable;
+	// インストゥルメント情報テーブル (RCU) :
+	//   公開側 : setInstrumentTable() が差し替え、世代番号を進める
+	//   参照側 : レンダリングスレッドが世代番号の変化を検出した場合のみ取り込み、参照中の最も古い世代(発音中のボイスを含む)を通知する
+	//   回収   : 差し替え済みのテーブルは、それより前の世代が参照されなくなった後に公開側(非リアルタイム)のスレッドで解放する
+	std::atomic<std::shared_ptr<const InstrumentTable>> mPublishedInstrumentTable;
+	std::atomic<uint64_t> mPublishedInstrumentGeneration = 0;
+	std::atomic<uint64_t> mReferencedInstrumentGeneration = 0;
+	std::shared_ptr<const InstrumentTable> mInstrumentTable; // レンダリングスレッドが参照中のテーブル
+	uint64_t mInstrumentGeneration = 0;
+	uint64_t mReportedInstrumentGeneration = 0; // レンダリングスレッドが最後に通知した世代
+	std::mutex mRetiredInstrumentTablesMutex;
+	std::vector<std::pair<uint64_t, std::shared_ptr<const InstrumentTable>>> mRetiredInstrumentTables; // (差し替えた世代, テーブル)
 	midi::SystemType mSystemType;
 	float mMasterVolume = 1.0f; // SysEx Master Volume (0.0~1.0)
 
 	// midi channel parameters
 	std::vector<MidiChannel> mMidiChannels;
 
+	// channel effector : 全チャネル共有のセンド/リターン バス
+	dsp::FdnReverb<float> mReverb;
+	dsp::Chorus<float> mChorus;
+	std::unique_ptr<dsp::PartitionedConvolver<float>> mConvolutionReverb; // 設定時はFDNの代わりに使用する
+
+	// master effector
+	MasterEffector mMasterEffector;
+
 	// 演奏スレッド
 	std::thread mPlayingThread;
 	std::atomic_bool mPlayingThreadAborted;
@@ -15,60 +15,11 @@ Voice::Voice(uint32_t sampleFreq, float noteNo, float pitchBend, float volume, b
 Voice::~Voice() = default;
 
 
-Voice::Digest Voice::digest()const noexcept
-{
-	Digest digest;
-
-	digest.freq = mCalculatedFreq;
-	digest.envelope = envelope();
-	digest.state = envelopeState();
-
-	return digest;
-}
 float Voice::noteNo()const noexcept
 {
 	return mNoteNo;
 }
 
-void Voice::noteOff()noexcept
-{
-	// HoldまたはSostenutoが有効な場合、実際のリリースを保留し、両方が解除されたタイミングでリリースする
-	if (mHold || mSostenuto) {
-		mPendingNoteOff = true;
-	} else {
-		mPendingNoteOff = false;
-		onNoteOff();
-	}
-}
-void Voice::noteCut()noexcept
-{
-	mPendingNoteOff = false;
-	onNoteCut();
-}
-void Voice::setHold(bool hold)noexcept
-{
-	mHold = hold;
-	// Hold解除時 : Sostenutoも無効であれば、保留中のnoteOffを実行する
-	if (mPendingNoteOff && !hold && !mSostenuto) {
-		noteOff();
-	}
-}
-void Voice::setSostenuto(bool sostenuto)noexcept
-{
-	mSostenuto = sostenuto;
-	// Sostenuto解除時 : Holdも無効であれば、保留中のnoteOffを実行する
-	if (mPendingNoteOff && !sostenuto && !mHold) {
-		noteOff();
-	}
-}
-bool Voice::isNoteOn()const noexcept
-{
-	// キーが押下中 = noteOffが保留されておらず、かつEGがリリース/止音状態でない
-	auto st = envelopeState();
-	return !mPendingNoteOff
-		&& st != EnvelopeState::Release
-		&& st != EnvelopeState::Free;
-}
 std::optional<float> Voice::pan()const noexcept
 {
 	return mPan;
@@ -82,6 +33,11 @@ void Voice::setPitchBend(float pitchBend)noexcept
 	mPitchBend = pitchBend;
 	updateFreq();
 }
+void Voice::setPerNotePitchBend(float pitchBend)noexcept
+{
+	mPerNotePitchBend = pitchBend;
+	updateFreq();
+}
 void Voice::setPolyPressure(float pressure)noexcept
 {
 	mPolyPressure = pressure;
@@ -108,32 +64,19 @@ void Voice::setBaseReleaseTime(float timeSec)noexcept
 {
 	mBaseReleaseTimeSec = timeSec;
 }
-void Voice::setReleaseTimeScale(float scale)noexcept
+uint64_t Voice::instrumentGeneration()const noexcept
 {
-	// デフォルト実装は何もしない (ドラムボイスではリリースタイムを使用しない)
+	return mInstrumentGeneration;
 }
-
-void Voice::setVibrato(float rate, float depth, float delaySec)noexcept
-{
-	mVibratoDepth = depth;
-	mVibratoLFO.setParam(static_cast<float>(mSampleFreq), rate, delaySec);
-}
-
-float Voice::applyVibrato()noexcept
+void Voice::setInstrumentGeneration(uint64_t generation)noexcept
 {
-	float lfo = mVibratoLFO.update();
-
-	if (mVibratoDepth <= 0.0f || lfo == 0.0f) {
-		return mCalculatedFreq;
-	}
-
-	return mCalculatedFreq * exp2f(lfo * mVibratoDepth / 12.0f);
+	mInstrumentGeneration = generation;
 }
 
 void Voice::updateFreq()noexcept
 {
 	// TODO いずれ平均律以外にも対応したい
-	mCalculatedFreq = 440 * exp2((mNoteNo + mNoteOffset + mPitchBend - 69.0f) / 12.0f);
+	mCalculatedFreq = 440 * exp2((mNoteNo + mNoteOffset + mPitchBend + mPerNotePitchBend - 69.0f) / 12.0f);
 }
 void Voice::setNoteOffset(float offset)noexcept
 {
@@ -143,4 +86,104 @@ void Voice::setNoteOffset(float offset)noexcept
 float Voice::soundingNoteNo()const noexcept
 {
 	return mNoteNo + mNoteOffset;
-}
\ No newline at end of file
+}
+
+
+StreamedSampleOscillator::StreamedSampleOscillator(uint32_t sampleFreq, const SoundFont& soundFont, const SampleZone& zone)
+	: mStreamer(*soundFont.streamer())
+	, mStream(nullptr)
+	, mResidentData(zone.residentData)
+	, mResidentLinked(zone.residentLinked)
+	, mResidentReleaseData(zone.residentReleaseData)
+	, mResidentReleaseLinked(zone.residentReleaseLinked)
+	, mLength(zone.data.size())
+	, mLoop(SampleLoop::of(zone))
+	, mLoopMode(zone.loopMode)
+	, mRootFreq(440.f * exp2f((zone.rootKey - 69.f) / 12.f))
+	, mRateRatio(static_cast<double>(zone.sampleRate) / sampleFreq)
+	, mFadeStep(1.0f / (0.01f * static_cast<float>(sampleFreq))) // 10ms
+{
+	// 常駐部分の直後から先読みを開始する (常駐部分のみで再生を終えられる場合は不要)
+	bool streamed = mLength > mResidentData.size();
+	if(mLoop.looping) {
+		streamed = mLoop.end > mResidentData.size();
+		if(mLoopMode == dsp::SampleLoopMode::UntilRelease) streamed = streamed || mLength > mLoop.end + mResidentReleaseData.size();
+	}
+	if(streamed) {
+		mStream = mStreamer.open(zone, mResidentData.size());
+	}
+}
+StreamedSampleOscillator::~StreamedSampleOscillator()
+{
+	mStreamer.close(mStream);
+}
+
+void StreamedSampleOscillator::noteOff()noexcept
+{
+	if(mReleased || mLoopMode != dsp::SampleLoopMode::UntilRelease) return;
+	mReleased = true;
+	// 先読み済みの現在の周回は再生し、その終端以降をループ終端からの続きとして読み込み直させる
+	if(mLoop.looping) mStreamer.release(mStream, mLoop.end + mLapOffset);
+}
+bool StreamedSampleOscillator::looping()const noexcept
+{
+	return mLoop.looping && !(mLoopMode == dsp::SampleLoopMode::UntilRelease && mReleased);
+}
+
+std::optional<float> StreamedSampleOscillator::peek(size_t index, uint64_t pos)const noexcept
+{
+	if(index >= mLength) return 0.0f;
+	if(index < mResidentData.size()) {
+		return dsp::SamplePlayer<float>::sampleAt(mResidentData, mResidentLinked, index);
+	}
+	if(index >= mLoop.end && index - mLoop.end < mResidentReleaseData.size()) {
+		return dsp::SamplePlayer<float>::sampleAt(mResidentReleaseData, mResidentReleaseLinked, index - mLoop.end);
+	}
+	if(!mStream) return {};
+	return mStream->peek(pos);
+}
+
+float StreamedSampleOscillator::update(float /*sampleFreq*/, float freq)
+{
+	// 再生速度 : ルートキーに対する周波数比 × サンプリング周波数の比
+	const double step = freq / mRootFreq * mRateRatio;
+	if(mFinished) return 0;
+
+	// MEMO 位置の進め方・補間は SamplePlayer::update と同一とし、ストリームはシーケンス位置で参照する
+	const size_t i0 = static_cast<size_t>(mPos);
+	size_t i1 = i0 + 1;
+	if(looping() && i1 >= mLoop.end) i1 = mLoop.start;
+	const uint64_t pos = i0 + mLapOffset;
+
+	const auto v0 = peek(i0, pos);
+	const auto v1 = peek(i1, pos + 1);
+	float v;
+	if(v0 && v1) {
+		v = *v0 + (*v1 - *v0) * static_cast<float>(mPos - static_cast<double>(i0));
+		mLastValue = v;
+		mPos += step;
+		if(looping() && mPos >= static_cast<double>(mLoop.end)) {
+			const double length = static_cast<double>(mLoop.end - mLoop.start);
+			const double wrapped = static_cast<double>(mLoop.start) + std::fmod(mPos - static_cast<double>(mLoop.start), length);
+			mLapOffset += static_cast<uint64_t>(std::llround((mPos - wrapped) / length)) * (mLoop.end - mLoop.start);
+			mPos = wrapped;
+		} else if(mPos >= static_cast<double>(mLength)) {
+			mFinished = true;
+		}
+		if(mStream) mStream->consume(static_cast<uint64_t>(mPos) + mLapOffset);
+	} else {
+		// アンダーラン : 再生位置を進めずに直前の値を保持する
+		if(!mUnderrun) {
+			mUnderrun = true;
+			mStreamer.notifyUnderrun();
+		}
+		v = mLastValue;
+	}
+	if(mUnderrun) {
+		// 一度アンダーランしたボイスは、以降読み込みが追いついてもフェードアウトして止音する
+		v *= mFadeGain;
+		mFadeGain -= mFadeStep;
+		if(mFadeGain <= 0) mFinished = true;
+	}
+	return v;
+}
@@ -6,6 +6,10 @@
 #include <lsp/dsp/biquadratic_filter.hpp>
 #include <lsp/dsp/wave_table_generator.hpp>
 #include <lsp/dsp/lfo.hpp>
+#include <lsp/dsp/sample_player.hpp>
+#include <lsp/synth/sound_font.hpp>
+
+#include <variant>
 
 namespace lsp::synth
 {
@@ -14,7 +18,9 @@ struct _voice_id_tag {};
 using VoiceId = issuable_id_base_t<_voice_id_tag>;
 
 
-// ボイス(あるチャネルの1音) - 基底クラス
+// ボイス(あるチャネルの1音) - 共通状態
+// 音高・音量・パン・ペダル状態・フィルタなど、ボイスの構成に依らない状態を保持します。
+// 発音処理は BasicVoice が構成要素(ポリシー)毎に実装するため、仮想関数は持ちません。
 class Voice
 	: non_copy_move
 {
@@ -32,35 +38,14 @@ public:
 	};
 
 public:
-	Voice(uint32_t sampleFreq, float noteNo, float pitchBend, float volume, bool hold);
-	virtual ~Voice();
-
-	virtual float update() = 0;
-
-	Digest digest()const noexcept;
-
 	float noteNo()const noexcept;
-	void noteOff()noexcept;
-	void noteCut()noexcept;
-
-	// ダンパーペダル(CC:64)によるホールド状態を設定します
-	// Hold中にnoteOffを受信した場合、リリースを保留しHold解除時にリリースします
-	void setHold(bool hold)noexcept;
-
-	// ソステヌート(CC:66)状態を設定します
-	// ソステヌートはHoldと異なり、ペダルを踏んだ瞬間に打鍵中のボイスのみを保持対象とします
-	// ソステヌート対象のボイスがnoteOffを受信した場合、リリースを保留しソステヌート解除時にリリースします
-	// ※ HoldとSostenutoは独立して動作し、いずれか一方でも有効であればリリースは保留されます
-	void setSostenuto(bool sostenuto)noexcept;
-
-	// キーが現在押下中(noteOnされてからnoteOffもリリースもされていない)かどうかを返します
-	// ソステヌートペダルON時の対象ボイス判定に使用します
-	bool isNoteOn()const noexcept;
 
 	std::optional<float> pan()const noexcept;
 	void setPan(float pan)noexcept;
 
 	void setPitchBend(float pitchBend)noexcept;
+	// パーノート ピッチベンド(半音)を設定します (MIDI 2.0)
+	void setPerNotePitchBend(float pitchBend)noexcept;
 	void setPolyPressure(float pressure)noexcept;
 
 	// レガート用 : エンベロープを再トリガせずにノート番号を変更します
@@ -75,36 +60,23 @@ public:
 	// フィルタ計算等、実際の発音周波数に基づく処理に使用します
 	float soundingNoteNo()const noexcept;
 
-	// EG の状態取得 (派生クラスで実装)
-	virtual float envelope()const noexcept = 0;
-	virtual EnvelopeState envelopeState()const noexcept = 0;
-	virtual bool isBusy()const noexcept = 0;
-
 	// ローパスフィルタのパラメータを設定します
 	// CC#74 (Brightness) でカットオフ周波数、CC#71 (Resonance) でQ値を制御します
 	void setFilter(float cutoffFreq, float Q)noexcept;
 
 	// ベースリリースタイム(楽器定義から決まる値)を設定します
 	void setBaseReleaseTime(float timeSec)noexcept;
-	// リリースタイムのスケーリング係数を更新し、EGに反映します
-	// CC:72やNRPN(1,102)の変更時に呼び出されます
-	virtual void setReleaseTimeScale(float scale)noexcept;
-
-	// ビブラート(CC#1 モジュレーション)パラメータを設定します
-	// rate: LFO周波数(Hz), depth: 変調深度(半音), delaySec: 開始までの遅延(秒)
-	void setVibrato(float rate, float depth, float delaySec)noexcept;
 
+	// 生成元のインストゥルメント情報テーブルの世代
+	// ボイスはテーブルが所有するデータ(SoundFont等)を参照するため、この世代のテーブルはボイスの破棄まで回収されません
+	uint64_t instrumentGeneration()const noexcept;
+	void setInstrumentGeneration(uint64_t generation)noexcept;
 
 protected:
-	void updateFreq()noexcept;
-
-	// ビブラートLFOを1サンプル進め、変調済み周波数を返します
-	// 派生クラスの update() 内で mCalculatedFreq の代わりに使用します
-	float applyVibrato()noexcept;
+	Voice(uint32_t sampleFreq, float noteNo, float pitchBend, float volume, bool hold);
+	~Voice();
 
-	// 派生クラスで実装するEG操作
-	virtual void onNoteOff()noexcept = 0;
-	virtual void onNoteCut()noexcept = 0;
+	void updateFreq()noexcept;
 
 protected:
 	const uint32_t mSampleFreq;
@@ -115,80 +87,168 @@ protected:
 	bool mHold = false;            // CC:64 ダンパーペダル(チャネル全体)
 	bool mSostenuto = false;       // CC:66 ソステヌート(ペダルON時に打鍵中だったボイスのみ)
 	float mPitchBend;
+	float mPerNotePitchBend = 0; // パーノート ピッチベンド(半音)
 	float mCalculatedFreq = 0;
 	float mVolume;
 	float mPolyPressure = 1.0f; // ポリフォニックキープレッシャー [0.0, 1.0]
 	std::optional<float> mPan; // ドラムなど、ボイス毎にパンが指定される場合のヒント
 	float mBaseReleaseTimeSec = 0; // 楽器定義から決まるベースリリースタイム(秒)
-
-	// ビブラート
-	LFO mVibratoLFO;                   // LFOインスタンス
-	float mVibratoDepth = 0.0f;        // 変調深度 (半音)
+	uint64_t mInstrumentGeneration = 0; // 生成元のインストゥルメント情報テーブルの世代
 };
 
 
-// 波形メモリ ボイス実装 (メロディパート用)
-class MelodyWaveTableVoice
-	: public Voice
+// ---------------------------------------------------------------------------
+// ボイスの構成要素 (ポリシー)
+//
+// オシレータ : float update(float sampleFreq, float freq), bool isFinished(), void noteOff()
+// モジュレータ : float apply(float freq) (1サンプル毎に呼び出す), void setVibrato(sampleFreq, rate, depth, delaySec)
+// エンベロープ : dsp::MelodyEnvelopeGenerator / dsp::DrumEnvelopeGenerator
+
+// オシレータ : 波形メモリ
+class WaveTableOscillator final
 {
 public:
 	using WaveTableGenerator = dsp::WaveTableGenerator<float>;
 
-public:
-	MelodyWaveTableVoice(uint32_t sampleFreq, WaveTableGenerator&& wg, float noteNo, float pitchBend, float volume, bool hold)
-		: Voice(sampleFreq, noteNo, pitchBend, volume, hold)
-		, mWG(std::move(wg))
+	explicit WaveTableOscillator(WaveTableGenerator&& wg)
+		: mWG(std::move(wg))
 	{}
 
-	virtual ~MelodyWaveTableVoice() {}
+	float update(float sampleFreq, float freq) { return mWG.update(sampleFreq, freq); }
+	static constexpr bool isFinished()noexcept { return false; }
+	static constexpr void noteOff()noexcept {}
 
-	virtual float update()override
+private:
+	WaveTableGenerator mWG;
+};
+
+// オシレータ : サンプル再生 (SoundFont)
+class SampleOscillator final
+{
+public:
+	using SamplePlayer = dsp::SamplePlayer<float>;
+
+	// MEMO サンプルデータは soundFont のマップ領域を参照する
+	//      soundFont の寿命は生成元のインストゥルメント情報テーブルの世代により管理する (Voice::instrumentGeneration)
+	//      (レンダリングスレッド上で SoundFont の解放が起こらないよう、ボイスは所有権を持たない)
+	SampleOscillator(uint32_t sampleFreq, const SoundFont& /*soundFont*/, const SampleZone& zone)
+		: mPlayer(zone.data, zone.linked, zone.loopStart, zone.loopEnd, zone.loopMode)
+		, mRootFreq(440.f * exp2f((zone.rootKey - 69.f) / 12.f))
+		, mRateRatio(static_cast<double>(zone.sampleRate) / sampleFreq)
+	{}
+
+	float update(float /*sampleFreq*/, float freq)
 	{
-		auto v = mWG.update(static_cast<float>(mSampleFreq), applyVibrato());
-		v = mFilter.update(v);
-		v *= mEG.update();
-		v *= mVolume;
-		v *= mPolyPressure;
-		return v;
+		// 再生速度 : ルートキーに対する周波数比 × サンプリング周波数の比
+		return mPlayer.update(freq / mRootFreq * mRateRatio);
 	}
+	bool isFinished()const noexcept { return mPlayer.isFinished(); }
+	void noteOff()noexcept { mPlayer.noteOff(); }
+
+private:
+	SamplePlayer mPlayer;
+	float mRootFreq;		// ルートキーの周波数 (Hz)
+	double mRateRatio;		// サンプルのサンプリング周波数 / 出力サンプリング周波数
+};
+
+// オシレータ : サンプル再生 (SoundFont ストリーミングモード)
+// 常駐している先頭部分を再生している間に、後続をI/Oスレッドがストリームへ先読みします。
+// 先読みが間に合わない場合はアンダーランとして記録し、直前の値を保持したまま短時間でフェードアウトして止音します。
+// 再生位置とループの扱いは SampleOscillator(SamplePlayer) と同一であり、先読みが間に合う限り同一の波形を生成します。
+class StreamedSampleOscillator final
+	: non_copy_move
+{
+public:
+	// MEMO soundFont の寿命は SampleOscillator と同様に、生成元のインストゥルメント情報テーブルの世代により管理する
+	StreamedSampleOscillator(uint32_t sampleFreq, const SoundFont& soundFont, const SampleZone& zone);
+	~StreamedSampleOscillator();
+
+	float update(float sampleFreq, float freq);
+	bool isFinished()const noexcept { return mFinished; }
+	// UntilRelease の場合、現在の周回を終えた後はループを抜けて末尾まで再生します
+	void noteOff()noexcept;
+
+private:
+	bool looping()const noexcept;
+	// 指定位置のサンプルを取得します (index : サンプルデータ内の位置, pos : シーケンス位置, 未読み込みの場合は std::nullopt)
+	std::optional<float> peek(size_t index, uint64_t pos)const noexcept;
+
+private:
+	SampleStreamer& mStreamer;
+	SampleStream* mStream;			// 空きストリームが無い場合は nullptr (常駐部分のみ再生する)
+	std::span<const int16_t> mResidentData;
+	std::span<const int16_t> mResidentLinked;
+	std::span<const int16_t> mResidentReleaseData;	// ループ終端以降の常駐部分 (UntilRelease のみ)
+	std::span<const int16_t> mResidentReleaseLinked;
+	size_t mLength;					// サンプルデータ全体のフレーム数
+	SampleLoop mLoop;
+	dsp::SampleLoopMode mLoopMode;
+	float mRootFreq;				// ルートキーの周波数 (Hz)
+	double mRateRatio;				// サンプルのサンプリング周波数 / 出力サンプリング周波数
+
+	double mPos = 0;				// サンプルデータ内の再生位置 (SamplePlayer と同様にループ区間内へ折り返す)
+	uint64_t mLapOffset = 0;		// 折り返したフレーム数の累計 (シーケンス位置 = 再生位置 + mLapOffset)
+	bool mReleased = false;
+	float mLastValue = 0;			// 直前に再生した値 (アンダーラン時に保持する)
+	bool mUnderrun = false;
+	float mFadeGain = 1.0f;			// アンダーラン時のフェードアウト量
+	float mFadeStep;
+	bool mFinished = false;
+};
 
-	virtual float envelope()const noexcept override { return mEG.envelope(); }
-	virtual EnvelopeState envelopeState()const noexcept override { return mEG.state(); }
-	virtual bool isBusy()const noexcept override { return mEG.isBusy(); }
-	virtual void setReleaseTimeScale(float scale)noexcept override
+// モジュレータ : ビブラート(CC#1 モジュレーション)
+class VibratoModulator final
+{
+public:
+	// rate: LFO周波数(Hz), depth: 変調深度(半音), delaySec: 開始までの遅延(秒)
+	void setVibrato(uint32_t sampleFreq, float rate, float depth, float delaySec)noexcept
 	{
-		mEG.setReleaseTime(static_cast<float>(mSampleFreq), std::max(0.001f, mBaseReleaseTimeSec * scale));
+		mDepth = depth;
+		mLFO.setParam(static_cast<float>(sampleFreq), rate, delaySec);
 	}
 
-	MelodyEG& envelopeGenerator() noexcept { return mEG; }
+	// LFOを1サンプル進め、変調済み周波数を返します
+	float apply(float freq)noexcept
+	{
+		float lfo = mLFO.update();
 
-protected:
-	virtual void onNoteOff()noexcept override { mEG.noteOff(); }
-	virtual void onNoteCut()noexcept override { mEG.reset(); }
+		if (mDepth <= 0.0f || lfo == 0.0f) {
+			return freq;
+		}
+
+		return freq * exp2f(lfo * mDepth / 12.0f);
+	}
 
 private:
-	WaveTableGenerator mWG;
-	MelodyEG mEG;
+	Voice::LFO mLFO;
+	float mDepth = 0.0f; // 変調深度 (半音)
 };
 
-// 波形メモリ ボイス実装 (ドラムパート用)
-class DrumWaveTableVoice
-	: public Voice
+// モジュレータ : 変調なし (ドラム用. 処理は全て除去される)
+class NoModulator final
 {
 public:
-	using WaveTableGenerator = dsp::WaveTableGenerator<float>;
+	static constexpr void setVibrato(uint32_t, float, float, float)noexcept {}
+	static constexpr float apply(float freq)noexcept { return freq; }
+};
 
+
+// ボイス実装 : オシレータ → ローパスフィルタ → エンベロープ → 音量 の固定パイプライン
+// 各構成要素はテンプレート引数で静的に決定されるため、サンプル毎の処理は仮想関数を介さずにインライン展開されます。
+template<class Oscillator, class Envelope, class Modulator>
+class BasicVoice final
+	: public Voice
+{
 public:
-	DrumWaveTableVoice(uint32_t sampleFreq, WaveTableGenerator&& wg, float noteNo, float pitchBend, float volume, bool hold)
+	template<class... OscillatorArgs>
+	BasicVoice(uint32_t sampleFreq, float noteNo, float pitchBend, float volume, bool hold, OscillatorArgs&&... args)
 		: Voice(sampleFreq, noteNo, pitchBend, volume, hold)
-		, mWG(std::move(wg))
+		, mOscillator(std::forward<OscillatorArgs>(args)...)
 	{}
 
-	virtual ~DrumWaveTableVoice() {}
-
-	virtual float update()override
+	float update()
 	{
-		auto v = mWG.update(static_cast<float>(mSampleFreq), mCalculatedFreq);
+		auto v = mOscillator.update(static_cast<float>(mSampleFreq), mModulator.apply(mCalculatedFreq));
 		v = mFilter.update(v);
 		v *= mEG.update();
 		v *= mVolume;
@@ -196,19 +256,153 @@ public:
 		return v;
 	}
 
-	virtual float envelope()const noexcept override { return mEG.envelope(); }
-	virtual EnvelopeState envelopeState()const noexcept override { return mEG.state(); }
-	virtual bool isBusy()const noexcept override { return mEG.isBusy(); }
+	// ブロック単位で生成します
+	// 発音を終えた時点で以降を無音とし、生成したサンプル数を返します
+	size_t render(float* out, size_t frames)
+	{
+		for(size_t i = 0; i < frames; ++i) {
+			out[i] = update();
+			if(!isBusy()) {
+				std::fill(out + i + 1, out + frames, 0.0f);
+				return i + 1;
+			}
+		}
+		return frames;
+	}
+
+	float envelope()const noexcept { return mEG.envelope(); }
+	EnvelopeState envelopeState()const noexcept { return mEG.state(); }
+	bool isBusy()const noexcept { return mEG.isBusy() && !mOscillator.isFinished(); }
 
-	DrumEG& envelopeGenerator() noexcept { return mEG; }
+	Digest digest()const noexcept
+	{
+		Digest digest;
+		digest.freq = mCalculatedFreq;
+		digest.envelope = envelope();
+		digest.state = envelopeState();
+		return digest;
+	}
 
-protected:
-	virtual void onNoteOff()noexcept override { mEG.noteOff(); }
-	virtual void onNoteCut()noexcept override { mEG.reset(); }
+	void noteOff()noexcept
+	{
+		// HoldまたはSostenutoが有効な場合、実際のリリースを保留し、両方が解除されたタイミングでリリースする
+		if (mHold || mSostenuto) {
+			mPendingNoteOff = true;
+		} else {
+			mPendingNoteOff = false;
+			mEG.noteOff();
+			mOscillator.noteOff();
+		}
+	}
+	void noteCut()noexcept
+	{
+		mPendingNoteOff = false;
+		mEG.reset();
+	}
+
+	// ダンパーペダル(CC:64)によるホールド状態を設定します
+	// Hold中にnoteOffを受信した場合、リリースを保留しHold解除時にリリースします
+	void setHold(bool hold)noexcept
+	{
+		mHold = hold;
+		// Hold解除時 : Sostenutoも無効であれば、保留中のnoteOffを実行する
+		if (mPendingNoteOff && !hold && !mSostenuto) {
+			noteOff();
+		}
+	}
+
+	// ソステヌート(CC:66)状態を設定します
+	// ソステヌートはHoldと異なり、ペダルを踏んだ瞬間に打鍵中のボイスのみを保持対象とします
+	// ソステヌート対象のボイスがnoteOffを受信した場合、リリースを保留しソステヌート解除時にリリースします
+	// ※ HoldとSostenutoは独立して動作し、いずれか一方でも有効であればリリースは保留されます
+	void setSostenuto(bool sostenuto)noexcept
+	{
+		mSostenuto = sostenuto;
+		// Sostenuto解除時 : Holdも無効であれば、保留中のnoteOffを実行する
+		if (mPendingNoteOff && !sostenuto && !mHold) {
+			noteOff();
+		}
+	}
+
+	// キーが現在押下中(noteOnされてからnoteOffもリリースもされていない)かどうかを返します
+	// ソステヌートペダルON時の対象ボイス判定に使用します
+	bool isNoteOn()const noexcept
+	{
+		// キーが押下中 = noteOffが保留されておらず、かつEGがリリース/止音状態でない
+		auto st = envelopeState();
+		return !mPendingNoteOff
+			&& st != EnvelopeState::Release
+			&& st != EnvelopeState::Free;
+	}
+
+	// リリースタイムのスケーリング係数を更新し、EGに反映します
+	// CC:72やNRPN(1,102)の変更時に呼び出されます (リリースを持たないEGでは何もしない)
+	void setReleaseTimeScale(float scale)noexcept
+	{
+		if constexpr (requires { mEG.setReleaseTime(0.0f, 0.0f); }) {
+			mEG.setReleaseTime(static_cast<float>(mSampleFreq), std::max(0.001f, mBaseReleaseTimeSec * scale));
+		}
+	}
+
+	// ビブラート(CC#1 モジュレーション)パラメータを設定します
+	// rate: LFO周波数(Hz), depth: 変調深度(半音), delaySec: 開始までの遅延(秒)
+	void setVibrato(float rate, float depth, float delaySec)noexcept
+	{
+		mModulator.setVibrato(mSampleFreq, rate, depth, delaySec);
+	}
+
+	Envelope& envelopeGenerator() noexcept { return mEG; }
 
 private:
-	WaveTableGenerator mWG;
-	DrumEG mEG;
+	Oscillator mOscillator;
+	Modulator mModulator;
+	Envelope mEG;
+};
+
+// 波形メモリ ボイス実装 (メロディパート用)
+using MelodyWaveTableVoice = BasicVoice<WaveTableOscillator, Voice::MelodyEG, VibratoModulator>;
+// 波形メモリ ボイス実装 (メロディパートのドラム風楽器用)
+using DrumLikeWaveTableVoice = BasicVoice<WaveTableOscillator, Voice::DrumEG, VibratoModulator>;
+// 波形メモリ ボイス実装 (ドラムパート用)
+using DrumWaveTableVoice = BasicVoice<WaveTableOscillator, Voice::DrumEG, NoModulator>;
+// サンプル再生 ボイス実装 (SoundFont)
+using SampleVoice = BasicVoice<SampleOscillator, Voice::MelodyEG, VibratoModulator>;
+// サンプル再生 ボイス実装 (SoundFont ストリーミングモード)
+using StreamedSampleVoice = BasicVoice<StreamedSampleOscillator, Voice::MelodyEG, VibratoModulator>;
+
+
+// 発音中のボイス
+// ボイスを具象型のまま保持し、ブロック単位の生成やEGに関わる操作は具象型へ静的に振り分けます。
+class AnyVoice final
+	: non_copy_move
+{
+public:
+	template<class V, class... Args>
+	explicit AnyVoice(std::in_place_type_t<V> type, Args&&... args)
+		: mVoice(type, std::forward<Args>(args)...)
+	{}
+
+	// 共通状態
+	Voice& base()noexcept { return std::visit([](Voice& v) -> Voice& { return v; }, mVoice); }
+	const Voice& base()const noexcept { return std::visit([](const Voice& v) -> const Voice& { return v; }, mVoice); }
+
+	template<class V>
+	V& get()noexcept { return std::get<V>(mVoice); }
+
+	size_t render(float* out, size_t frames) { return std::visit([&](auto& v) { return v.render(out, frames); }, mVoice); }
+	bool isBusy()const noexcept { return std::visit([](const auto& v) { return v.isBusy(); }, mVoice); }
+	Voice::Digest digest()const noexcept { return std::visit([](const auto& v) { return v.digest(); }, mVoice); }
+
+	void noteOff()noexcept { std::visit([](auto& v) { v.noteOff(); }, mVoice); }
+	void noteCut()noexcept { std::visit([](auto& v) { v.noteCut(); }, mVoice); }
+	void setHold(bool hold)noexcept { std::visit([&](auto& v) { v.setHold(hold); }, mVoice); }
+	void setSostenuto(bool sostenuto)noexcept { std::visit([&](auto& v) { v.setSostenuto(sostenuto); }, mVoice); }
+	bool isNoteOn()const noexcept { return std::visit([](const auto& v) { return v.isNoteOn(); }, mVoice); }
+	void setReleaseTimeScale(float scale)noexcept { std::visit([&](auto& v) { v.setReleaseTimeScale(scale); }, mVoice); }
+	void setVibrato(float rate, float depth, float delaySec)noexcept { std::visit([&](auto& v) { v.setVibrato(rate, depth, delaySec); }, mVoice); }
+
+private:
+	std::variant<MelodyWaveTableVoice, DrumLikeWaveTableVoice, DrumWaveTableVoice, SampleVoice, StreamedSampleVoice> mVoice;
 };
 
 }
\ No newline at end of file
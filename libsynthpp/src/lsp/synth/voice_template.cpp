@@ -0,0 +1,66 @@
+﻿#include <lsp/synth/voice_template.hpp>
+
+using namespace lsp::synth;
+
+MelodyVoiceTemplate MelodyVoiceTemplate::compile(const MelodyParam& mp)
+{
+	MelodyVoiceTemplate t;
+
+	// 音色の反映
+	if(mp.isDrumLike && mp.waveForm == MelodyWaveForm::Square) {
+		// ドラム系 (波形指定なし) : ノイズジェネレータを使用
+		t.waveTable = Instruments::createDrumNoiseGenerator();
+	} else {
+		switch(mp.waveForm) {
+		case MelodyWaveForm::Sine:
+			t.waveTable = Instruments::createSineGenerator();
+			break;
+		case MelodyWaveForm::Triangle:
+			t.waveTable = Instruments::createTriangleGenerator();
+			break;
+		case MelodyWaveForm::Sawtooth:
+			t.waveTable = Instruments::createSawtoothGenerator();
+			break;
+		case MelodyWaveForm::Noise:
+			t.waveTable = Instruments::createDrumNoiseGenerator();
+			break;
+		case MelodyWaveForm::Square:
+		default:
+			t.waveTable = Instruments::createSquareGenerator();
+			break;
+		}
+	}
+
+	// TODO sustain_levelで除算しているのは旧LibSynth++からの移植コード。 補正が不要になったら削除すること
+	float s = mp.sustain;
+	t.volume = mp.volume / ((s > 0.8f && s != 0.f) ? s : 0.8f);
+
+	// 波形のRMSに基づく知覚音量正規化 (正弦波基準)
+	t.volume *= t.waveTable.perceptualNormalization();
+
+	t.attack = mp.attack;
+	t.hold = mp.hold;
+	t.decay = mp.decay;
+	t.sustain = mp.sustain;
+	t.fade = mp.fade;
+	t.release = mp.release;
+	t.baseReleaseTime = std::max(0.001f, mp.release);
+
+	// 楽器毎の調整
+	t.noteOffset = mp.noteOffset;
+	t.isDrumLike = mp.isDrumLike;
+
+	return t;
+}
+
+DrumVoiceTemplate DrumVoiceTemplate::compile(const DrumParam& dp)
+{
+	DrumVoiceTemplate t;
+	t.pitch = static_cast<float>(static_cast<uint8_t>(dp.pitch));
+	t.volume = dp.volume;
+	t.attack = dp.attack;
+	t.hold = dp.hold;
+	t.decay = dp.decay;
+	t.pan = dp.pan;
+	return t;
+}
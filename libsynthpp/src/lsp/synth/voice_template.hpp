@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <lsp/core/core.hpp>
+#include <lsp/synth/instrument_table.hpp>
+#include <lsp/synth/instruments.hpp>
+
+namespace lsp::synth
+{
+
+// メロディ音色のボイステンプレート
+// 音色パラメータのうちノートオン毎に変化しない値 (波形, 音量補正, EG形状) を予め算出したものです。
+// プログラム/バンク変更時に生成し、ノートオン時はここからボイスを生成します。
+struct MelodyVoiceTemplate
+{
+	Instruments::WaveTableGenerator waveTable;	// 波形 (知覚音量正規化係数 算出済み)
+	float volume = 1.0f;		// 音量 (サスティンレベル補正, 知覚音量正規化 適用済み)
+	float attack = 0.0f;		// sec (CC/NRPNスケーリング適用前)
+	float hold = 0.0f;			// sec
+	float decay = 0.0f;			// sec (CC/NRPNスケーリング適用前)
+	float sustain = 0.0f;		// level
+	float fade = 0.0f;			// Linear : level/sec, Exp : dBFS/sec
+	float release = 0.0f;		// sec (CC/NRPNスケーリング適用前)
+	float baseReleaseTime = 0.001f; // sec (下限補正済み, リリースタイム動的変更時の基準値)
+	float noteOffset = 0.0f;	// ノートオフセット(半音単位)
+	bool isDrumLike = false;	// ドラム風楽器か
+
+	static MelodyVoiceTemplate compile(const MelodyParam& param);
+};
+
+// ドラム音色のボイステンプレート (ノート番号毎)
+// 波形は全ノート共通のノイズテーブルを使用するため保持しません。
+struct DrumVoiceTemplate
+{
+	float pitch = 69.0f;	// 発音に用いるノート番号
+	float volume = 1.0f;	// 音量調整
+	float attack = 0.0f;	// sec (CCスケーリング適用前)
+	float hold = 0.0f;		// sec
+	float decay = 0.3f;		// sec (CCスケーリング適用前)
+	float pan = 0.5f;		// 0～1 (NRPNによる上書き前)
+
+	static DrumVoiceTemplate compile(const DrumParam& param);
+};
+
+}
@@ -36,6 +36,17 @@ public:
         _flag = false;
     }
 
+    // イベントがシグナル状態になるか、指定時間が経過するまで待機します
+    template<class Rep, class Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& rel_time)
+    {
+        if(_semaphore.try_acquire_for(rel_time)) {
+            _flag = false;
+            return true;
+        }
+        return false;
+    }
+
     // イベントがシグナル状態になるか、stop_tokenが停止状態を示すまで待機します
     template<class Rep, class Period>
     bool try_wait(const std::stop_token& token, const std::chrono::duration<Rep, Period>& rel_time)
@@ -0,0 +1,87 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+#include <bit>
+#include <cstring>
+
+namespace lsp
+{
+
+// ファイル形式のチェックサム : XXH64
+// 8バイト単位で処理しつつ、各レーンの乗算・ローテートと最後の攪拌により全てのビットの差異を全体へ拡散させます。
+//   参考 : https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+inline uint64_t xxh64(std::span<const std::byte> data, uint64_t seed = 0)noexcept
+{
+	constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+	constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+	constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+	auto read64 = [&](size_t pos) {
+		uint64_t value;
+		std::memcpy(&value, data.data() + pos, sizeof(value));
+		return value;
+	};
+	auto read32 = [&](size_t pos) {
+		uint32_t value;
+		std::memcpy(&value, data.data() + pos, sizeof(value));
+		return value;
+	};
+	auto round = [](uint64_t acc, uint64_t input) {
+		return std::rotl(acc + input * P2, 31) * P1;
+	};
+	auto merge = [&](uint64_t acc, uint64_t lane) {
+		return (acc ^ round(0, lane)) * P1 + P4;
+	};
+
+	const size_t size = data.size();
+	size_t pos = 0;
+	uint64_t hash;
+	if (size >= 32) {
+		uint64_t v1 = seed + P1 + P2;
+		uint64_t v2 = seed + P2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - P1;
+		for (; pos + 32 <= size; pos += 32) {
+			v1 = round(v1, read64(pos));
+			v2 = round(v2, read64(pos + 8));
+			v3 = round(v3, read64(pos + 16));
+			v4 = round(v4, read64(pos + 24));
+		}
+		hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+		hash = merge(hash, v1);
+		hash = merge(hash, v2);
+		hash = merge(hash, v3);
+		hash = merge(hash, v4);
+	} else {
+		hash = seed + P5;
+	}
+	hash += size;
+
+	// 端数
+	for (; pos + 8 <= size; pos += 8) {
+		hash = std::rotl(hash ^ round(0, read64(pos)), 27) * P1 + P4;
+	}
+	if (pos + 4 <= size) {
+		hash = std::rotl(hash ^ (read32(pos) * P1), 23) * P2 + P3;
+		pos += 4;
+	}
+	for (; pos < size; ++pos) {
+		hash = std::rotl(hash ^ (static_cast<uint8_t>(data[pos]) * P5), 11) * P1;
+	}
+
+	// 攪拌
+	hash ^= hash >> 33;
+	hash *= P2;
+	hash ^= hash >> 29;
+	hash *= P3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+}
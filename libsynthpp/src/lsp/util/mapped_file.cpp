@@ -0,0 +1,130 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#include <lsp/util/mapped_file.hpp>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace lsp;
+
+MappedFile::MappedFile(const std::filesystem::path& path, AccessPattern pattern)
+{
+#if defined(WIN32)
+	auto fail = [this](const char* what) {
+		auto ec = std::error_code(static_cast<int>(::GetLastError()), std::system_category());
+		close();
+		throw std::system_error(ec, what);
+	};
+
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	switch(pattern) {
+	case AccessPattern::Sequential:	flags = FILE_FLAG_SEQUENTIAL_SCAN;	break;
+	case AccessPattern::Random:		flags = FILE_FLAG_RANDOM_ACCESS;	break;
+	default:	break;
+	}
+	mFile = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if(mFile == INVALID_HANDLE_VALUE) fail("CreateFileW");
+
+	LARGE_INTEGER size;
+	if(!::GetFileSizeEx(mFile, &size)) fail("GetFileSizeEx");
+	if(size.QuadPart == 0) {
+		// 空のファイルはマップできない
+		close();
+		return;
+	}
+	if(static_cast<uint64_t>(size.QuadPart) > std::numeric_limits<size_t>::max()) {
+		close();
+		throw std::system_error(std::make_error_code(std::errc::file_too_large), "MappedFile");
+	}
+
+	mMapping = ::CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!mMapping) fail("CreateFileMappingW");
+
+	auto view = ::MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if(!view) fail("MapViewOfFile");
+
+	mData = static_cast<const std::byte*>(view);
+	mSize = static_cast<size_t>(size.QuadPart);
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) throw std::system_error(errno, std::system_category(), "open");
+
+	struct stat st;
+	if(::fstat(fd, &st) != 0) {
+		const int err = errno;
+		::close(fd);
+		throw std::system_error(err, std::system_category(), "fstat");
+	}
+	if(st.st_size == 0) {
+		// 空のファイルはマップできない
+		::close(fd);
+		return;
+	}
+
+	auto view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	const int err = errno;
+	::close(fd); // マップ後はファイルディスクリプタを保持する必要がない
+	if(view == MAP_FAILED) throw std::system_error(err, std::system_category(), "mmap");
+
+	// アクセスパターンをカーネルへ通知する
+	switch(pattern) {
+	case AccessPattern::Sequential:	::madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);	break;
+	case AccessPattern::Random:		::madvise(view, static_cast<size_t>(st.st_size), MADV_RANDOM);		break;
+	default:	break;
+	}
+
+	mData = static_cast<const std::byte*>(view);
+	mSize = static_cast<size_t>(st.st_size);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& d) noexcept
+	: mData(std::exchange(d.mData, nullptr))
+	, mSize(std::exchange(d.mSize, 0))
+#ifdef WIN32
+	, mFile(std::exchange(d.mFile, INVALID_HANDLE_VALUE))
+	, mMapping(std::exchange(d.mMapping, nullptr))
+#endif
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& d) noexcept
+{
+	if(this != &d) {
+		close();
+		mData = std::exchange(d.mData, nullptr);
+		mSize = std::exchange(d.mSize, 0);
+#ifdef WIN32
+		mFile = std::exchange(d.mFile, INVALID_HANDLE_VALUE);
+		mMapping = std::exchange(d.mMapping, nullptr);
+#endif
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+void MappedFile::close()noexcept
+{
+#if defined(WIN32)
+	if(mData) ::UnmapViewOfFile(mData);
+	if(mMapping) ::CloseHandle(mMapping);
+	if(mFile != INVALID_HANDLE_VALUE) ::CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile = INVALID_HANDLE_VALUE;
+#else
+	if(mData) ::munmap(const_cast<std::byte*>(mData), mSize);
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
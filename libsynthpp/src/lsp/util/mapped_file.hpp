@@ -0,0 +1,53 @@
+﻿// SPDX-FileCopyrightText: 2018 my04337
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <lsp/core/core.hpp>
+
+namespace lsp
+{
+
+// 読み取り専用のメモリマップトファイル
+// ファイル全体をアドレス空間へマップし、コピーを伴わずに std::span として参照できるようにします。
+// マップ領域はインスタンスの破棄時に解放されるため、data() で得た領域をインスタンスより長く保持してはなりません。
+class MappedFile final
+	: non_copy
+{
+public:
+	// アクセスパターン (OSへの先読みのヒント)
+	enum class AccessPattern
+	{
+		Normal,		// 既定 : 通常の先読み
+		Sequential,	// 先頭から順に一度だけ読み進める (SMF, コンパイル済み形式の読み込み等)
+		Random,		// 任意の位置を読む (先読みを行わない)
+	};
+
+	MappedFile() noexcept = default;
+	explicit MappedFile(const std::filesystem::path& path, AccessPattern pattern = AccessPattern::Normal); // throws std::system_error
+	MappedFile(MappedFile&& d) noexcept;
+	MappedFile& operator=(MappedFile&& d) noexcept;
+	~MappedFile();
+
+	// マップ領域を取得します
+	std::span<const std::byte> data()const noexcept { return { mData, mSize }; }
+
+	// マップ領域のバイト数を取得します
+	size_t size()const noexcept { return mSize; }
+
+	// ファイルがマップされているか否かを取得します (空のファイルはマップされません)
+	bool valid()const noexcept { return mData != nullptr; }
+
+private:
+	void close()noexcept;
+
+private:
+	const std::byte* mData = nullptr;
+	size_t mSize = 0;
+#ifdef WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#endif
+};
+
+}
@@ -84,16 +84,22 @@ static std::wstring freq2scale(float freq) {
 	}
 }
 MainWindow::MainWindow()
-	: mInstrumentTable(InstrumentLoader::loadFromDirectory(std::filesystem::current_path() / L"assets/instruments"))
-	, mSequencer(mSynthesizer)
-	, mSynthesizer(SAMPLE_FREQ, mInstrumentTable)
+	: mSynthesizer(SAMPLE_FREQ, std::make_shared<const synth::InstrumentTable>(synth::InstrumentLoader::loadFromDirectory(std::filesystem::current_path() / L"assets/instruments")))
 	, mOutput()
 	, mLissajousWidget(SAMPLE_FREQ, static_cast<uint32_t>(SAMPLE_FREQ * 250e-4f))
 	, mOscilloScopeWidget(SAMPLE_FREQ, static_cast<uint32_t>(SAMPLE_FREQ * 250e-4f))
 	, mSpectrumAnalyzerWidget(SAMPLE_FREQ, 4096)
 {
+	// シンセサイザは固定の周波数でレンダリングし、出力デバイスの周波数へは変換して配送する
+	if(mOutput.valid() && mOutput.getDeviceSampleFreq() != SAMPLE_FREQ) {
+		mOutputResampler.emplace(SAMPLE_FREQ, mOutput.getDeviceSampleFreq(), 2, lsp::dsp::ResamplerQuality::High);
+	}
 	mSynthesizer.setRenderingCallback([this](Signal<float>&& sig){onRenderedSignal(std::move(sig));});
 
+	mSequencer = std::make_shared<midi::smf::RenderSequencer>();
+	mSynthesizer.setMessageSource(mSequencer);
+	mSynthesizer.setMessageCoalescing(true);
+
 }
 
 MainWindow::~MainWindow()
@@ -112,7 +118,7 @@ void MainWindow::dispose()
 	auto isOutputStopped = mOutput.stop();
 
 	// シーケンサ停止
-	mSequencer.stop();
+	mSequencer->stop();
 
 	// トーンジェネレータ停止
 	mSynthesizer.dispose();
@@ -275,6 +281,16 @@ bool MainWindow::onKeyDown(uint16_t key, bool shift, bool ctrl, bool alt)
 		// 出力音量を下げる ※TOCTOUは無視可能。この操作がメインスレッド以外から行われることはない。
 		mPostAmpVolume.store(mPostAmpVolume.load() / 1.5f);
 		return true;
+	} else if(key == VK_LEFT || key == VK_RIGHT) {
+		// 再生位置を移動する (Shift : 30秒単位, それ以外 : 5秒単位)
+		if(!mSequencer->isPlaying()) return false;
+		const auto step = std::chrono::microseconds(std::chrono::seconds(shift ? 30 : 5));
+		mSequencer->seek(mSequencer->position() + (key == VK_LEFT ? -step : step));
+		return true;
+	} else if(key == VK_F5) {
+		// インストゥルメント定義を再読み込みする (演奏は継続)
+		reloadInstruments();
+		return true;
 	}
 	return false;
 }
@@ -295,15 +311,15 @@ void MainWindow::onDpiChanged(float scale)
 	UpdateWindow(mWindowHandle);
 }
 void MainWindow::loadMidi(const std::filesystem::path& midi_path) {
-	mSequencer.stop();
-	mSequencer.reset(midi::SystemType::GM1());
+	mSequencer->stop();
+	mSequencer->reset(midi::SystemType::GM1());
 
 #ifdef NDEBUG
 	try {
 #endif
 		auto parsed = midi::smf::Parser::parse(midi_path);
-		mSequencer.load(std::move(parsed.second));
-		mSequencer.start();
+		mSequencer->load(std::move(parsed.second));
+		mSequencer->start();
 #ifdef NDEBUG
 	} catch (const midi::smf::decoding_exception& e) {
 		// ロード失敗
@@ -321,6 +337,27 @@ void MainWindow::loadMidi(const std::filesystem::path& midi_path) {
 #endif
 }
 
+void MainWindow::reloadInstruments()
+{
+	const auto dir = std::filesystem::current_path() / L"assets/instruments";
+	try {
+		// 読み込みはUIスレッドで行い、シンセサイザへは完成したテーブルのみを渡す
+		mSynthesizer.setInstrumentTable(std::make_shared<const synth::InstrumentTable>(synth::InstrumentLoader::loadFromDirectory(dir)));
+	} catch (const std::exception& e) {
+		// ロード失敗 : 現在のテーブルのまま演奏を継続する
+		std::string_view detail = e.what();
+		std::wstring detailW(detail.begin(), detail.end());
+		mShowingDialog = true;
+		auto fin_act_dialogFinish = finally([this] { mShowingDialog = false; });
+		MessageBox(
+			mWindowHandle,
+			std::format(L"インストゥルメント定義を読み込めません : {}\n\n{}", dir.wstring(), detailW).c_str(),
+			L"ファイルエラー",
+			MB_OK | MB_ICONWARNING | MB_SETFOREGROUND
+		);
+	}
+}
+
 struct MainWindow::DrawingContext
 {
 	// FPS計算,表示用
@@ -388,6 +425,9 @@ void MainWindow::onDraw()
 		context.drawing_time_index = 0;
 	}
 	++context.frames;
+
+	// 差し替え済みのインストゥルメント情報テーブルを回収する (解放は重い処理を伴うため、演奏スレッドではなくUIスレッドで行う)
+	mSynthesizer.collectRetiredInstrumentTables();
 }
 void MainWindow::onDraw(ID2D1RenderTarget& renderer)
 {
@@ -441,12 +481,17 @@ void MainWindow::onDraw(ID2D1RenderTarget& renderer)
 		drawText(150, 0, std::format(L"生成時間 : {}[msec]  failed : {}[msec]  buffered : {:04}[msec]",
 			tgStatistics.created_samples * 1000ull / SAMPLE_FREQ,
 			tgStatistics.failed_samples * 1000ull / SAMPLE_FREQ,
-			mOutput.getBufferedFrameCount() * 1000 / SAMPLE_FREQ
+			mOutput.getBufferedFrameCount() * 1000 / (mOutput.valid() ? mOutput.getDeviceSampleFreq() : SAMPLE_FREQ)
 		));
 		drawText(150, 15, std::format(L"演奏負荷 : {:03}[%]", (int)(100 * tgStatistics.rendering_load_average())));
 		drawText(150, 30, std::format(L"PostAmp : {:.3f}", mPostAmpVolume.load()));
+		drawText(280, 30, std::format(L"Comp : -{:04.1f}[dB]  Limit : -{:04.1f}[dB]",
+			tgStatistics.compressor_gain_reduction_db,
+			tgStatistics.limiter_gain_reduction_db
+		));
 		drawText(280, 15, std::format(L"同時発音数 : {:03}", polyCount));
 		drawText(420, 15, std::format(L"MIDIリセット : {}", systemType));
+		drawText(560, 15, std::format(L"集約 : {}", tgStatistics.coalesced_messages));
 	}
 
 	// チャネル情報
@@ -617,7 +662,11 @@ void MainWindow::onRenderedSignal(Signal<float>&& sig)
 	}
 
 	// 各出力先に配送
-	mOutput.write(sig);
+	if(mOutputResampler && mOutputResampler->channels() == sig.channels()) {
+		mOutput.write(mOutputResampler->process(sig));
+	} else {
+		mOutput.write(sig);
+	}
 	mOscilloScopeWidget.write(sig);
 	mSpectrumAnalyzerWidget.write(sig);
 	mLissajousWidget.write(sig);
@@ -5,10 +5,11 @@
 #include <luath/widget/spectrum_analyzer.hpp>
 #include <luath/widget/lissajous.hpp>
 #include <luath/drawing/font_loader.hpp>
-#include <luath/io/instrument_loader.hpp>
+#include <lsp/synth/instrument_loader.hpp>
 #include <lsp/synth/synthesizer.hpp>
-#include <lsp/midi/smf/sequencer.hpp>
+#include <lsp/midi/smf/render_sequencer.hpp>
 #include <lsp/audio/wasapi_output.hpp>
+#include <lsp/dsp/resampler.hpp>
 
 namespace luath::window
 {
@@ -29,6 +30,7 @@ public:
 
 protected:
 	void loadMidi(const std::filesystem::path& path);
+	void reloadInstruments();
 	void onRenderedSignal(lsp::Signal<float>&& sig);
 	void onDraw();
 	void onDraw(ID2D1RenderTarget& renderer);
@@ -48,6 +50,8 @@ private:
 
 	// 再生用ストリーム
 	lsp::audio::WasapiOutput mOutput;
+	// サンプリング周波数変換 (出力デバイスの周波数がシンセサイザと異なる場合のみ有効)
+	std::optional<lsp::dsp::Resampler<float>> mOutputResampler;
 
 	// 再生パラメータ
 	std::atomic<float> mPostAmpVolume = 1.0f;
@@ -55,12 +59,9 @@ private:
 	// ダイアログ表示中フラグ (MessageBox表示中はD2D描画を抑制する)
 	bool mShowingDialog = false;
 
-	// インストゥルメント情報
-	lsp::synth::InstrumentTable mInstrumentTable;
-
-	// シーケンサ,シンセサイザ
+	// シーケンサ,シンセサイザ : シーケンサはシンセサイザのレンダリングループから駆動される
 	synth::Synthesizer mSynthesizer;
-	midi::smf::Sequencer mSequencer;
+	std::shared_ptr<midi::smf::RenderSequencer> mSequencer;
 
 	// 各種ウィジット
 	widget::OscilloScope mOscilloScopeWidget;
@@ -0,0 +1,35 @@
+﻿#include <lsp/core/core.hpp>
+#include <lsp/midi/smf/compiled_sequence.hpp>
+
+using namespace lsp;
+
+// SMF → コンパイル済みシーケンス 変換ツール
+//   使い方 : smfc <input.mid>...
+//   各入力ファイルと同じ場所へ、拡張子を .lsq としたコンパイル済みシーケンスを出力します
+int main(int argc, char* argv[])
+{
+	// ログ出力機構 セットアップ
+	StdOutLogger logger(false);
+	Log::addLogger(&logger);
+	auto fin_act_logger = finally([&] { lsp::Log::removeLogger(&logger); });
+
+	if(argc < 2) {
+		Log::e("usage : smfc <input.mid>...");
+		return 2;
+	}
+
+	int result = 0;
+	for(int i = 1; i < argc; ++i) {
+		const std::filesystem::path input = argv[i];
+		auto output = input;
+		output.replace_extension(".lsq");
+		try {
+			midi::smf::CompiledSequence::compile(input, output);
+			Log::i("{} -> {}", input.string(), output.string());
+		} catch(const std::exception& e) {
+			Log::e("{} : {}", input.string(), e.what());
+			result = 1;
+		}
+	}
+	return result;
+}